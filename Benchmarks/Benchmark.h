@@ -0,0 +1,89 @@
+/*
+    ==============================================================================
+
+    Copyright 2019 - Paul Ferrand (paulfd@outlook.fr)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    ==============================================================================
+*/
+
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <vector>
+
+struct BenchmarkResult
+{
+    std::string name;
+    int iterations { 0 };
+    double minimum { 0.0 }; // milliseconds
+    double median { 0.0 };
+    double mean { 0.0 };
+};
+
+/**
+ * Runs a function a number of times and keeps the timing statistics.
+ * The first run is a warmup run and is not measured. The setup function
+ * runs before every run and is not measured either.
+ */
+template<class F, class S>
+BenchmarkResult runBenchmark(std::string name, int iterations, F&& function, S&& setup)
+{
+    using Clock = std::chrono::high_resolution_clock;
+    setup();
+    function();
+
+    std::vector<double> timings;
+    timings.reserve(iterations);
+    for (int i = 0; i < iterations; ++i)
+    {
+        setup();
+        const auto start = Clock::now();
+        function();
+        const auto end = Clock::now();
+        timings.push_back(std::chrono::duration<double, std::milli>(end - start).count());
+    }
+
+    std::sort(timings.begin(), timings.end());
+    BenchmarkResult result { std::move(name), iterations };
+    if (timings.empty())
+        return result;
+
+    result.minimum = timings.front();
+    result.median = timings[timings.size() / 2];
+    for (auto timing: timings)
+        result.mean += timing;
+    result.mean /= timings.size();
+    return result;
+}
+
+template<class F>
+BenchmarkResult runBenchmark(std::string name, int iterations, F&& function)
+{
+    return runBenchmark(std::move(name), iterations, std::forward<F>(function), []() {});
+}
+
+// Synthetic instruments, written to the temporary directory
+std::string syntheticInstrument(int numRegions);
+std::filesystem::path writeInstrument(const std::string& name, const std::string& contents);
+
+void runParsingBenchmarks(std::vector<BenchmarkResult>& results);
+void runInterpolationBenchmarks(std::vector<BenchmarkResult>& results);
+void runDispatchBenchmarks(std::vector<BenchmarkResult>& results);
+void runRenderBenchmarks(std::vector<BenchmarkResult>& results);
+void runEnvelopeBenchmarks(std::vector<BenchmarkResult>& results);
+void runOscillatorBenchmarks(std::vector<BenchmarkResult>& results);
@@ -0,0 +1,81 @@
+/*
+    ==============================================================================
+
+    Copyright 2019 - Paul Ferrand (paulfd@outlook.fr)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    ==============================================================================
+*/
+
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "Benchmark.h"
+#include "../Source/SfzSynth.h"
+#include <sstream>
+
+namespace
+{
+constexpr int blockSize { 256 };
+
+// Each note has as many round-robin layers as needed to reach the number of regions,
+// so that every note-on starts exactly one voice after going through all its candidates
+std::string dispatchInstrument(int numRegions)
+{
+    std::ostringstream sfz;
+    const auto numLayers = (numRegions + 127) / 128;
+    for (int regionIdx = 0; regionIdx < numRegions; ++regionIdx)
+    {
+        const auto layer = regionIdx / 128;
+        sfz << "<region> sample=*sine key=" << regionIdx % 128
+            << " lorand=" << static_cast<float>(layer) / numLayers
+            << " hirand=" << static_cast<float>(layer + 1) / numLayers << "\n";
+    }
+    return sfz.str();
+}
+
+void releaseAllVoices(SfzSynth& synth, AudioBuffer<float>& buffer)
+{
+    while (synth.getNumActiveVoices() > 0)
+        synth.renderNextBlock(buffer, 0, blockSize);
+}
+}
+
+void runDispatchBenchmarks(std::vector<BenchmarkResult>& results)
+{
+    for (auto numRegions: { 1000, 10000 })
+    {
+        const auto suffix = std::to_string(numRegions) + " regions)";
+        const auto file = writeInstrument("dispatch_" + std::to_string(numRegions), dispatchInstrument(numRegions));
+        SfzSynth synth;
+        synth.initalizeVoices(256);
+        synth.setSynchronousLoading(true);
+        synth.loadSfzFile(file);
+        synth.prepareToPlay(config::defaultSampleRate, blockSize);
+        AudioBuffer<float> buffer { config::numChannels, blockSize };
+
+        results.push_back(runBenchmark("registerNoteOn/Off (128 notes, " + suffix, 50, [&]() {
+            for (int noteNumber = 0; noteNumber < 128; ++noteNumber)
+                synth.registerNoteOn(1, noteNumber, 100, 0);
+            for (int noteNumber = 0; noteNumber < 128; ++noteNumber)
+                synth.registerNoteOff(1, noteNumber, 0, 0);
+        }, [&]() { releaseAllVoices(synth, buffer); }));
+
+        results.push_back(runBenchmark("registerCC (128 values, " + suffix, 50, [&]() {
+            for (int ccValue = 0; ccValue < 128; ++ccValue)
+                synth.registerCC(1, 1, static_cast<uint8_t>(ccValue), 0);
+        }));
+        std::filesystem::remove(file);
+    }
+}
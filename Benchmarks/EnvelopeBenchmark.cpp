@@ -0,0 +1,76 @@
+/*
+    ==============================================================================
+
+    Copyright 2019 - Paul Ferrand (paulfd@outlook.fr)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    ==============================================================================
+*/
+
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "Benchmark.h"
+#include "../Source/SfzBlockEnvelope.h"
+#include "../Source/SfzEnvelope.h"
+#include <vector>
+
+namespace
+{
+constexpr int blockSize { 1024 };
+constexpr int numBlocks { 1000 };
+constexpr int numEvents { 16 };
+}
+
+void runEnvelopeBenchmarks(std::vector<BenchmarkResult>& results)
+{
+    std::vector<float> output (blockSize);
+    SfzBlockEnvelope<float> envelope { numEvents, 0.0f };
+
+    results.push_back(runBenchmark("Block envelope, no events (1000 blocks)", 20, [&]() {
+        for (int blockIdx = 0; blockIdx < numBlocks; ++blockIdx)
+            envelope.getEnvelope(output.data(), blockSize);
+    }));
+
+    // The events are cleared by every getEnvelope call
+    results.push_back(runBenchmark("Block envelope, " + std::to_string(numEvents) + " events (1000 blocks)", 20, [&]() {
+        for (int blockIdx = 0; blockIdx < numBlocks; ++blockIdx)
+        {
+            for (int eventIdx = 0; eventIdx < numEvents; ++eventIdx)
+                envelope.addEvent((eventIdx + 1) * blockSize / (numEvents + 1), static_cast<float>(eventIdx % 2));
+            envelope.getEnvelope(output.data(), blockSize);
+        }
+    }));
+
+    // Amplitude EG in its decay, per sample and per block
+    SfzEnvelopeGeneratorDescription description;
+    description.decay = 10.0f;
+    description.sustain = 50.0f;
+    CCValueArray ccValues;
+    ccValues.fill(0);
+    SfzEnvelopeGeneratorValue eg;
+
+    results.push_back(runBenchmark("Amplitude EG, per sample (1000 blocks)", 20, [&]() {
+        eg.prepare(description, ccValues, 127);
+        for (int blockIdx = 0; blockIdx < numBlocks; ++blockIdx)
+            for (auto& value : output)
+                value = eg.getNextValue();
+    }));
+
+    results.push_back(runBenchmark("Amplitude EG, per block (1000 blocks)", 20, [&]() {
+        eg.prepare(description, ccValues, 127);
+        for (int blockIdx = 0; blockIdx < numBlocks; ++blockIdx)
+            eg.getBlock(output.data(), blockSize);
+    }));
+}
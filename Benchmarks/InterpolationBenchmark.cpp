@@ -0,0 +1,133 @@
+/*
+    ==============================================================================
+
+    Copyright 2019 - Paul Ferrand (paulfd@outlook.fr)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    ==============================================================================
+*/
+
+
+#include "Benchmark.h"
+#include "../Source/SfzInterpolation.h"
+#include "../Source/SfzSimdDispatch.h"
+#include <cmath>
+#include <vector>
+
+namespace
+{
+constexpr int numChannels { 2 };
+constexpr int blockSize { 1024 };
+constexpr int numBlocks { 1000 };
+constexpr float step { 1.0594631f }; // One semitone up
+
+struct InterpolationFixture
+{
+    InterpolationFixture()
+    {
+        for (auto& channel: source)
+        {
+            channel.resize(blockSize * numBlocks * 2 + 2);
+            for (size_t i = 0; i < channel.size(); ++i)
+                channel[i] = std::sin(0.01f * static_cast<float>(i));
+        }
+        for (auto& channel: output)
+            channel.resize(blockSize);
+        for (auto& channel: nextBlock)
+            channel.resize(blockSize);
+        for (auto& channel: weightBlock)
+            channel.resize(blockSize);
+    }
+
+    std::vector<float> source[numChannels];
+    std::vector<float> output[numChannels];
+    std::vector<float> nextBlock[numChannels];
+    std::vector<float> weightBlock[numChannels];
+};
+
+// The structure of the voice rendering before the kernels: per-sample stores into
+// three temporary blocks, followed by three passes to interpolate
+void perSampleInterpolation(InterpolationFixture& fixture)
+{
+    int position { 0 };
+    float fraction { 0.0f };
+    for (int blockIdx = 0; blockIdx < numBlocks; ++blockIdx)
+    {
+        for (int frame = 0; frame < blockSize; ++frame)
+        {
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                fixture.output[channel][frame] = fixture.source[channel][position];
+                fixture.nextBlock[channel][frame] = fixture.source[channel][position + 1];
+                fixture.weightBlock[channel][frame] = fraction;
+            }
+            fraction += step;
+            const auto wholeFrames = static_cast<int>(fraction);
+            position += wholeFrames;
+            fraction -= wholeFrames;
+        }
+
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            for (int frame = 0; frame < blockSize; ++frame)
+                fixture.nextBlock[channel][frame] *= fixture.weightBlock[channel][frame];
+            for (int frame = 0; frame < blockSize; ++frame)
+                fixture.weightBlock[channel][frame] = 1.0f - fixture.weightBlock[channel][frame];
+            for (int frame = 0; frame < blockSize; ++frame)
+                fixture.output[channel][frame] = fixture.output[channel][frame] * fixture.weightBlock[channel][frame] + fixture.nextBlock[channel][frame];
+        }
+    }
+}
+
+void kernelInterpolation(InterpolationFixture& fixture, float kernelStep)
+{
+    int position { 0 };
+    float fraction { 0.0f };
+    const float* source[numChannels] { fixture.source[0].data(), fixture.source[1].data() };
+    float* output[numChannels] { fixture.output[0].data(), fixture.output[1].data() };
+    for (int blockIdx = 0; blockIdx < numBlocks; ++blockIdx)
+    {
+        SfzInterpolation::linear(source, output, numChannels, position, fraction, kernelStep, blockSize);
+        SfzInterpolation::advance(position, fraction, kernelStep, blockSize);
+    }
+}
+
+void unityCopy(InterpolationFixture& fixture)
+{
+    const float* source[numChannels] { fixture.source[0].data(), fixture.source[1].data() };
+    float* output[numChannels] { fixture.output[0].data(), fixture.output[1].data() };
+    for (int blockIdx = 0; blockIdx < numBlocks; ++blockIdx)
+        SfzInterpolation::copy(source, output, numChannels, blockIdx * blockSize, blockSize);
+}
+}
+
+void runInterpolationBenchmarks(std::vector<BenchmarkResult>& results)
+{
+    InterpolationFixture fixture;
+    results.push_back(runBenchmark("Interpolation (per sample, 1000 blocks)", 20, [&]() { perSampleInterpolation(fixture); }));
+    results.push_back(runBenchmark("Interpolation (kernel, 1000 blocks)", 20, [&]() { kernelInterpolation(fixture, step); }));
+    results.push_back(runBenchmark("Interpolation (kernel at unit speed, 1000 blocks)", 20, [&]() { kernelInterpolation(fixture, 1.0f); }));
+    results.push_back(runBenchmark("Interpolation (unit speed copy, 1000 blocks)", 20, [&]() { unityCopy(fixture); }));
+
+    // The same kernel on every instruction set this CPU supports
+    for (auto level: { SfzSimdLevel::sse2, SfzSimdLevel::avx2, SfzSimdLevel::avx512, SfzSimdLevel::neon })
+    {
+        if (!SfzSimd::setLevel(level))
+            continue;
+        const auto name = std::string("Interpolation (kernel, ") + SfzSimd::getLevelName(level) + ", 1000 blocks)";
+        results.push_back(runBenchmark(name, 20, [&]() { kernelInterpolation(fixture, step); }));
+    }
+    SfzSimd::setLevel(SfzSimd::detectLevel());
+}
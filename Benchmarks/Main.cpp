@@ -0,0 +1,98 @@
+/*
+    ==============================================================================
+
+    Copyright 2019 - Paul Ferrand (paulfd@outlook.fr)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    ==============================================================================
+*/
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "Benchmark.h"
+#include <cstdio>
+#include <fstream>
+#include <string_view>
+
+namespace
+{
+std::string escapeJson(const std::string& text)
+{
+    std::string escaped;
+    for (auto c: text)
+    {
+        if (c == '"' || c == '\\')
+            escaped += '\\';
+        escaped += c;
+    }
+    return escaped;
+}
+
+void writeJson(const std::vector<BenchmarkResult>& results, std::ostream& output)
+{
+    output << "{\n  \"benchmarks\": [\n";
+    for (size_t resultIdx = 0; resultIdx < results.size(); ++resultIdx)
+    {
+        const auto& result = results[resultIdx];
+        output << "    { \"name\": \"" << escapeJson(result.name) << "\""
+               << ", \"iterations\": " << result.iterations
+               << ", \"min_ms\": " << result.minimum
+               << ", \"median_ms\": " << result.median
+               << ", \"mean_ms\": " << result.mean << " }"
+               << (resultIdx + 1 < results.size() ? ",\n" : "\n");
+    }
+    output << "  ]\n}\n";
+}
+}
+
+// Usage: sfizz_Bench [--json <results.json>]
+int main(int argc, char* argv[])
+{
+    const char* jsonFile { nullptr };
+    if (argc == 3 && std::string_view(argv[1]) == "--json")
+        jsonFile = argv[2];
+    else if (argc != 1)
+    {
+        std::printf("Usage: %s [--json <results.json>]\n", argv[0]);
+        return 1;
+    }
+
+    // The random opcodes and region selection should not change between runs
+    Random::getSystemRandom().setSeed(0);
+
+    std::vector<BenchmarkResult> results;
+    runParsingBenchmarks(results);
+    runDispatchBenchmarks(results);
+    runInterpolationBenchmarks(results);
+    runRenderBenchmarks(results);
+    runEnvelopeBenchmarks(results);
+    runOscillatorBenchmarks(results);
+
+    std::printf("%-56s %10s %12s %12s %12s\n", "Benchmark", "Iterations", "Min (ms)", "Median (ms)", "Mean (ms)");
+    for (const auto& result: results)
+        std::printf("%-56s %10d %12.3f %12.3f %12.3f\n", result.name.c_str(), result.iterations, result.minimum, result.median, result.mean);
+
+    if (jsonFile != nullptr)
+    {
+        std::ofstream output { jsonFile };
+        writeJson(results, output);
+        if (!output)
+        {
+            std::fprintf(stderr, "Could not write the results to %s\n", jsonFile);
+            return 1;
+        }
+    }
+
+    return 0;
+}
@@ -0,0 +1,64 @@
+/*
+    ==============================================================================
+
+    Copyright 2019 - Paul Ferrand (paulfd@outlook.fr)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    ==============================================================================
+*/
+
+
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "Benchmark.h"
+#include "../Source/SfzOscillator.h"
+#include <cmath>
+#include <vector>
+
+namespace
+{
+constexpr int blockSize { 1024 };
+constexpr int numBlocks { 1000 };
+constexpr double sampleRate { 48000.0 };
+constexpr double frequency { 440.0 };
+}
+
+void runOscillatorBenchmarks(std::vector<BenchmarkResult>& results)
+{
+    std::vector<float> output (blockSize);
+
+    // The generator rendering before the oscillators: one std::sin per sample
+    results.push_back(runBenchmark("Sine generator, std::sin per sample (1000 blocks)", 20, [&]() {
+        const auto angularFrequency = MathConstants<float>::twoPi * static_cast<float>(frequency);
+        int position { 0 };
+        for (int blockIdx = 0; blockIdx < numBlocks; ++blockIdx)
+            for (auto& value : output)
+                value = static_cast<float>(std::sin(angularFrequency * position++ / sampleRate));
+    }));
+
+    SfzOscillator oscillator;
+    const std::pair<SfzWaveform, std::string> waveforms[] {
+        { SfzWaveform::sine, "sine" }, { SfzWaveform::saw, "saw" }, { SfzWaveform::square, "square" },
+        { SfzWaveform::triangle, "triangle" }, { SfzWaveform::noise, "noise" }
+    };
+    for (const auto& waveform: waveforms)
+    {
+        results.push_back(runBenchmark("Oscillator, " + waveform.second + " (1000 blocks)", 20, [&]() {
+            oscillator.prepare(waveform.first, frequency, sampleRate);
+            for (int blockIdx = 0; blockIdx < numBlocks; ++blockIdx)
+                oscillator.render(output.data(), blockSize);
+        }));
+    }
+}
@@ -0,0 +1,115 @@
+/*
+    ==============================================================================
+
+    Copyright 2019 - Paul Ferrand (paulfd@outlook.fr)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    ==============================================================================
+*/
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "Benchmark.h"
+#include "../Source/SfzSynth.h"
+#include "../Source/SfzTokenizer.h"
+#include <filesystem>
+#include <fstream>
+#include <regex>
+#include <sstream>
+
+// Generators only, so that the benchmark measures the parsing and not the disk
+std::string syntheticInstrument(int numRegions)
+{
+    std::ostringstream sfz;
+    sfz << "<control> set_cc1=64 label_cc1=Modulation\n";
+    sfz << "<global> ampeg_release=0.5 amp_veltrack=80\n";
+    for (int regionIdx = 0; regionIdx < numRegions; ++regionIdx)
+    {
+        if (regionIdx % 16 == 0)
+            sfz << "<group> group=" << regionIdx / 16 << " lovel=" << regionIdx % 127 << " seq_length=4 ampeg_attack=0.001\n";
+
+        const auto key = regionIdx % 128;
+        sfz << "<region> sample=*sine key=" << key << " pitch_keycenter=" << key
+            << " seq_position=" << regionIdx % 4 + 1 << " volume=-3.5 pan=12 tune=-4"
+            << " amp_velcurve_64=0.4 on_locc64=64 on_hicc64=127 // generated region\n";
+    }
+    return sfz.str();
+}
+
+std::filesystem::path writeInstrument(const std::string& name, const std::string& contents)
+{
+    const auto path = std::filesystem::temp_directory_path() / ("sfizz_bench_" + name + ".sfz");
+    std::ofstream file { path };
+    file << contents;
+    return path;
+}
+
+namespace
+{
+// The joined and comment-free string the loader builds before tokenizing
+std::string joinedInstrument(int numRegions)
+{
+    auto instrument = syntheticInstrument(numRegions);
+    std::string joined;
+    std::istringstream stream { instrument };
+    for (std::string line; std::getline(stream, line);)
+    {
+        if (auto position = line.find("//"); position != line.npos)
+            line.resize(position);
+        joined += line;
+        joined += ' ';
+    }
+    return joined;
+}
+}
+
+void runParsingBenchmarks(std::vector<BenchmarkResult>& results)
+{
+    for (auto numRegions: { 1000, 20000 })
+    {
+        const auto suffix = " (" + std::to_string(numRegions) + " regions)";
+        const auto joined = joinedInstrument(numRegions);
+
+        results.push_back(runBenchmark("Tokenizer" + suffix, 10, [&]() {
+            SfzTokenizer tokenizer { joined };
+            int numTokens { 0 };
+            for (auto token = tokenizer.next(); token.type != SfzTokenType::end; token = tokenizer.next())
+                numTokens++;
+            return numTokens;
+        }));
+
+        results.push_back(runBenchmark("Regexes" + suffix, 3, [&]() {
+            int numTokens { 0 };
+            const auto regexEnd = std::sregex_iterator();
+            for (auto header = std::sregex_iterator(joined.begin(), joined.end(), SfzRegexes::headers); header != regexEnd; ++header)
+            {
+                const auto members = header->str(2);
+                for (auto member = std::sregex_iterator(members.begin(), members.end(), SfzRegexes::members); member != regexEnd; ++member)
+                    numTokens++;
+            }
+            return numTokens;
+        }));
+    }
+
+    for (auto numRegions: { 100, 1000, 10000, 100000 })
+    {
+        const auto file = writeInstrument("parsing_" + std::to_string(numRegions), syntheticInstrument(numRegions));
+        SfzSynth synth;
+        const auto iterations = numRegions >= 100000 ? 2 : numRegions >= 10000 ? 5 : 20;
+        results.push_back(runBenchmark("loadSfzFile (" + std::to_string(numRegions) + " regions)", iterations, [&]() {
+            synth.loadSfzFile(file);
+        }));
+        std::filesystem::remove(file);
+    }
+}
@@ -0,0 +1,133 @@
+/*
+    ==============================================================================
+
+    Copyright 2019 - Paul Ferrand (paulfd@outlook.fr)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    ==============================================================================
+*/
+
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "Benchmark.h"
+#include "../Source/SfzSynth.h"
+#include <cmath>
+
+namespace
+{
+constexpr int blockSize { 512 };
+constexpr int numBlocks { 100 };
+constexpr int shortSampleLength { 16384 }; // Fits in the preloaded data
+// A second longer than the biggest cacheable sample once stored as 16 bit stereo, so it is streamed
+constexpr int longSampleLength { static_cast<int>(config::maxCachedSampleSize / (config::numChannels * sizeof(int16_t))) + 48000 };
+
+bool writeSine(const File& file, int numFrames)
+{
+    file.deleteFile();
+    auto stream = std::make_unique<FileOutputStream>(file);
+    WavAudioFormat format;
+    std::unique_ptr<AudioFormatWriter> writer { format.createWriterFor(stream.get(), config::defaultSampleRate, config::numChannels, 16, {}, 0) };
+    if (writer == nullptr)
+        return false;
+    stream.release();
+
+    AudioBuffer<float> buffer { config::numChannels, config::streamChunkSize };
+    for (int frameIdx = 0; frameIdx < numFrames; frameIdx += buffer.getNumSamples())
+    {
+        const auto numChunkFrames = jmin(buffer.getNumSamples(), numFrames - frameIdx);
+        for (int channelIdx = 0; channelIdx < config::numChannels; ++channelIdx)
+            for (int chunkIdx = 0; chunkIdx < numChunkFrames; ++chunkIdx)
+                buffer.setSample(channelIdx, chunkIdx, 0.5f * std::sin(0.0575f * static_cast<float>(frameIdx + chunkIdx)));
+        writer->writeFromAudioSampleBuffer(buffer, 0, numChunkFrames);
+    }
+    return true;
+}
+}
+
+// One voice rendering a note through each path of SfzVoice::fillBlock, at the sample pitch
+// (one source frame per output frame) and transposed (fractional steps)
+void runRenderBenchmarks(std::vector<BenchmarkResult>& results)
+{
+    const auto directory = File(std::filesystem::temp_directory_path().string());
+    const auto shortSample = directory.getChildFile("sfizz_bench_short.wav");
+    const auto longSample = directory.getChildFile("sfizz_bench_long.wav");
+    if (!writeSine(shortSample, shortSampleLength) || !writeSine(longSample, longSampleLength))
+        return;
+
+    const std::vector<std::pair<std::string, std::string>> instruments {
+        { "generator", "<region> sample=*sine" },
+        { "preloaded", "<region> sample=" + shortSample.getFileName().toStdString() + " loop_mode=loop_continuous loop_start=0 loop_end=" + std::to_string(shortSampleLength - 1) },
+        { "streamed", "<region> sample=" + longSample.getFileName().toStdString() },
+    };
+
+    for (const auto& [path, contents]: instruments)
+    {
+        const auto file = writeInstrument("render_" + path, contents);
+        SfzSynth synth;
+        // Otherwise the streamed results would depend on when the loading threads wake up
+        synth.setSynchronousLoading(true);
+        synth.loadSfzFile(file);
+        synth.prepareToPlay(config::defaultSampleRate, blockSize);
+        AudioBuffer<float> buffer { config::numChannels, blockSize };
+
+        for (auto [pitch, noteNumber]: { std::make_pair("at pitch", 60), std::make_pair("transposed", 67) })
+        {
+            auto name = "Render " + path + " voice, " + pitch + " (" + std::to_string(numBlocks) + " blocks)";
+            results.push_back(runBenchmark(std::move(name), 20, [&]() {
+                for (int blockIdx = 0; blockIdx < numBlocks; ++blockIdx)
+                {
+                    buffer.clear();
+                    synth.renderNextBlock(buffer, 0, blockSize);
+                }
+            }, [&, noteNumber = noteNumber]() {
+                synth.registerNoteOff(1, noteNumber, 0, 0);
+                while (synth.getNumActiveVoices() > 0)
+                    synth.renderNextBlock(buffer, 0, blockSize);
+                synth.registerNoteOn(1, noteNumber, 100, 0);
+            }));
+        }
+        std::filesystem::remove(file);
+    }
+
+    // The oversampled render modes, on the transposed preloaded voice
+    const auto oversampledFile = writeInstrument("render_oversampled", instruments[1].second);
+    for (auto factor: { 2, 4 })
+    {
+        SfzSynth synth;
+        synth.setSynchronousLoading(true);
+        synth.setOversamplingFactor(factor);
+        synth.loadSfzFile(oversampledFile);
+        synth.prepareToPlay(config::defaultSampleRate, blockSize);
+        AudioBuffer<float> buffer { config::numChannels, blockSize };
+
+        auto name = "Render preloaded voice, transposed, " + std::to_string(factor) + "x oversampling (" + std::to_string(numBlocks) + " blocks)";
+        results.push_back(runBenchmark(std::move(name), 20, [&]() {
+            for (int blockIdx = 0; blockIdx < numBlocks; ++blockIdx)
+            {
+                buffer.clear();
+                synth.renderNextBlock(buffer, 0, blockSize);
+            }
+        }, [&]() {
+            synth.registerNoteOff(1, 67, 0, 0);
+            while (synth.getNumActiveVoices() > 0)
+                synth.renderNextBlock(buffer, 0, blockSize);
+            synth.registerNoteOn(1, 67, 100, 0);
+        }));
+    }
+    std::filesystem::remove(oversampledFile);
+
+    shortSample.deleteFile();
+    longSample.deleteFile();
+}
@@ -0,0 +1,223 @@
+/*
+    ==============================================================================
+
+    Copyright 2019 - Paul Ferrand (paulfd@outlook.fr)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    ==============================================================================
+*/
+
+
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "../Source/SfzSynth.h"
+#include <chrono>
+#include <cstdio>
+#include <filesystem>
+#include <string>
+
+// Offline renderer: plays a MIDI file through an sfz instrument into a wav file, as fast as possible.
+// Voices stream their samples synchronously so that two renders of the same files are identical.
+
+namespace
+{
+    struct RenderOptions
+    {
+        std::string sfzFile;
+        std::string midiFile;
+        std::string wavFile;
+        double sampleRate { config::defaultSampleRate };
+        int blockSize { config::defaultSamplesPerBlock };
+        int polyphony { config::numVoices };
+        int renderThreads { 0 };
+        int oversampling { 1 };
+        int64 seed { 0 };
+        double maxTail { 10.0 }; // Seconds rendered after the last MIDI event, at most
+    };
+
+    void printUsage()
+    {
+        std::printf("Usage: sfizz_render --sfz <file.sfz> --midi <file.mid> --wav <output.wav> [options]\n"
+                    "Options:\n"
+                    "  --samplerate <Hz>      Output sample rate (default %.0f)\n"
+                    "  --blocksize <frames>   Rendering block size (default %d)\n"
+                    "  --polyphony <voices>   Maximum polyphony (default %d)\n"
+                    "  --threads <count>      Render worker threads (default 0)\n"
+                    "  --oversampling <1|2|4> Render the voices at a multiple of the output rate (default 1)\n"
+                    "  --seed <value>         Seed for the random opcodes (default 0)\n"
+                    "  --tail <seconds>       Maximum release tail after the last event (default 10)\n",
+                    config::defaultSampleRate, config::defaultSamplesPerBlock, config::numVoices);
+    }
+
+    std::optional<RenderOptions> parseArguments(int argc, char* argv[])
+    {
+        RenderOptions options;
+        for (int argIdx = 1; argIdx + 1 < argc; argIdx += 2)
+        {
+            const std::string_view option { argv[argIdx] };
+            const String value { argv[argIdx + 1] };
+            if (option == "--sfz")
+                options.sfzFile = value.toStdString();
+            else if (option == "--midi")
+                options.midiFile = value.toStdString();
+            else if (option == "--wav")
+                options.wavFile = value.toStdString();
+            else if (option == "--samplerate")
+                options.sampleRate = value.getDoubleValue();
+            else if (option == "--blocksize")
+                options.blockSize = value.getIntValue();
+            else if (option == "--polyphony")
+                options.polyphony = value.getIntValue();
+            else if (option == "--threads")
+                options.renderThreads = value.getIntValue();
+            else if (option == "--oversampling")
+                options.oversampling = value.getIntValue();
+            else if (option == "--seed")
+                options.seed = value.getLargeIntValue();
+            else if (option == "--tail")
+                options.maxTail = value.getDoubleValue();
+            else
+            {
+                std::fprintf(stderr, "Unknown option %s\n", argv[argIdx]);
+                return {};
+            }
+        }
+
+        if ((argc - 1) % 2 != 0 || options.sfzFile.empty() || options.midiFile.empty() || options.wavFile.empty())
+            return {};
+
+        if (options.sampleRate <= 0 || options.blockSize <= 0 || options.polyphony <= 0 || options.renderThreads < 0
+            || !SfzOversampling::isValidFactor(options.oversampling))
+            return {};
+
+        return options;
+    }
+
+    // All the tracks merged, with timestamps in seconds
+    std::optional<MidiMessageSequence> readMidiFile(const File& file)
+    {
+        FileInputStream stream { file };
+        MidiFile midiFile;
+        if (stream.failedToOpen() || !midiFile.readFrom(stream))
+            return {};
+
+        midiFile.convertTimestampTicksToSeconds();
+        MidiMessageSequence sequence;
+        for (int trackIdx = 0; trackIdx < midiFile.getNumTracks(); ++trackIdx)
+            sequence.addSequence(*midiFile.getTrack(trackIdx), 0.0);
+        sequence.updateMatchedPairs();
+        return sequence;
+    }
+
+    void dispatchMidiMessage(SfzSynth& synth, const MidiMessage& msg, int timestamp)
+    {
+        if (msg.isController())
+            synth.registerCC(msg.getChannel(), msg.getControllerNumber(), static_cast<uint8_t>(msg.getControllerValue()), timestamp);
+        if (msg.isNoteOn())
+            synth.registerNoteOn(msg.getChannel(), msg.getNoteNumber(), msg.getVelocity(), timestamp);
+        if (msg.isNoteOff())
+            synth.registerNoteOff(msg.getChannel(), msg.getNoteNumber(), msg.getVelocity(), timestamp);
+        if (msg.isChannelPressure())
+            synth.registerAftertouch(msg.getChannel(), static_cast<uint8_t>(msg.getAfterTouchValue()), timestamp);
+        if (msg.isPitchWheel())
+            synth.registerPitchWheel(msg.getChannel(), msg.getPitchWheelValue(), timestamp);
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    const auto options = parseArguments(argc, argv);
+    if (!options)
+    {
+        printUsage();
+        return 1;
+    }
+
+    const auto midiSequence = readMidiFile(File::getCurrentWorkingDirectory().getChildFile(options->midiFile));
+    if (!midiSequence)
+    {
+        std::fprintf(stderr, "Could not read the MIDI file %s\n", options->midiFile.c_str());
+        return 1;
+    }
+
+    Random::getSystemRandom().setSeed(options->seed);
+    SfzSynth synth;
+    synth.setSynchronousLoading(true);
+    synth.initalizeVoices(options->polyphony);
+    synth.setNumRenderThreads(options->renderThreads);
+    synth.setOversamplingFactor(options->oversampling);
+    if (!synth.loadSfzFile(std::filesystem::absolute(options->sfzFile)))
+    {
+        std::fprintf(stderr, "Could not load the sfz file %s\n", options->sfzFile.c_str());
+        return 1;
+    }
+    synth.prepareToPlay(options->sampleRate, options->blockSize);
+
+    const auto outputFile = File::getCurrentWorkingDirectory().getChildFile(options->wavFile);
+    outputFile.deleteFile();
+    auto outputStream = std::make_unique<FileOutputStream>(outputFile);
+    if (outputStream->failedToOpen())
+    {
+        std::fprintf(stderr, "Could not open the output file %s\n", options->wavFile.c_str());
+        return 1;
+    }
+
+    WavAudioFormat wavFormat;
+    std::unique_ptr<AudioFormatWriter> writer { wavFormat.createWriterFor(outputStream.get(), options->sampleRate, config::numChannels, 24, {}, 0) };
+    if (writer == nullptr)
+    {
+        std::fprintf(stderr, "Could not create a wav writer for %s\n", options->wavFile.c_str());
+        return 1;
+    }
+    // The writer owns the stream now
+    outputStream.release();
+
+    auto toSamples = [&](double seconds) { return static_cast<int64>(seconds * options->sampleRate); };
+    const auto numEvents = midiSequence->getNumEvents();
+    const auto lastEventSample = numEvents > 0 ? toSamples(midiSequence->getEndTime()) : 0;
+    const auto maxLength = lastEventSample + toSamples(options->maxTail);
+
+    AudioBuffer<float> buffer { config::numChannels, options->blockSize };
+    int eventIdx { 0 };
+    int64 blockStart { 0 };
+    const auto renderStart = std::chrono::steady_clock::now();
+    while (blockStart < maxLength)
+    {
+        const auto blockEnd = blockStart + options->blockSize;
+        for (; eventIdx < numEvents; ++eventIdx)
+        {
+            const auto* event = midiSequence->getEventPointer(eventIdx);
+            const auto eventSample = toSamples(event->message.getTimeStamp());
+            if (eventSample >= blockEnd)
+                break;
+
+            dispatchMidiMessage(synth, event->message, static_cast<int>(eventSample - blockStart));
+        }
+
+        buffer.clear();
+        synth.renderNextBlock(buffer, 0, options->blockSize);
+        writer->writeFromAudioSampleBuffer(buffer, 0, options->blockSize);
+        blockStart = blockEnd;
+
+        if (eventIdx == numEvents && synth.getNumActiveVoices() == 0)
+            break;
+    }
+    writer.reset();
+
+    const std::chrono::duration<double> renderTime { std::chrono::steady_clock::now() - renderStart };
+    const auto renderedSeconds = static_cast<double>(blockStart) / options->sampleRate;
+    std::printf("Rendered %.2f s of audio in %.3f s (%.1fx realtime)\n", renderedSeconds, renderTime.count(),
+                renderTime.count() > 0 ? renderedSeconds / renderTime.count() : 0.0);
+    return 0;
+}
@@ -25,9 +25,9 @@
 
 
 //==============================================================================
-SfzpluginAudioProcessorEditor::SfzpluginAudioProcessorEditor (SfzpluginAudioProcessor& p, MidiKeyboardState& keyboardState, const SfzSynth& synth)
+SfzpluginAudioProcessorEditor::SfzpluginAudioProcessorEditor (SfzpluginAudioProcessor& p, MidiKeyboardState& keyboardState)
     : AudioProcessorEditor (&p), processor (p),
-        keyboardComponent(keyboardState, MidiKeyboardComponent::Orientation::horizontalKeyboard), synth(synth), sfzChooser(SfzFileChooser(p))
+        keyboardComponent(keyboardState, MidiKeyboardComponent::Orientation::horizontalKeyboard), sfzChooser(SfzFileChooser(p))
 {
     setSize(600, 300);
     addAndMakeVisible(openButton);
@@ -39,11 +39,13 @@ SfzpluginAudioProcessorEditor::SfzpluginAudioProcessorEditor (SfzpluginAudioProc
     numVoices.setText("Active voices: 0", dontSendNotification);
     addAndMakeVisible(keyboardComponent);
     addChildComponent(sfzChooser);
+    processor.getInstrumentLoader().addChangeListener(this);
     startTimer(100);
 }
 
 SfzpluginAudioProcessorEditor::~SfzpluginAudioProcessorEditor()
 {
+    processor.getInstrumentLoader().removeChangeListener(this);
     stopTimer();
 }
 
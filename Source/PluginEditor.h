@@ -92,10 +92,10 @@ private:
 //==============================================================================
 /**
 */
-class SfzpluginAudioProcessorEditor  : public AudioProcessorEditor, public Timer
+class SfzpluginAudioProcessorEditor  : public AudioProcessorEditor, public Timer, public ChangeListener
 {
 public:
-    SfzpluginAudioProcessorEditor (SfzpluginAudioProcessor&, MidiKeyboardState&, const SfzSynth&);
+    SfzpluginAudioProcessorEditor (SfzpluginAudioProcessor&, MidiKeyboardState&);
     ~SfzpluginAudioProcessorEditor();
 
     //==============================================================================
@@ -109,37 +109,42 @@ public:
         numVoices.setText(s, dontSendNotification);
     }
 
+    // A new instrument finished loading
+    void changeListenerCallback(ChangeBroadcaster*) override { updateInstrumentDescription(); }
+
 private:
     // This reference is provided as a quick way for your editor to
     // access the processor object that created it.
     SfzpluginAudioProcessor& processor;
     MidiKeyboardComponent keyboardComponent;
-    const SfzSynth& synth;
     TextButton openButton;
     Label numVoices;
     SfzFileChooser sfzChooser;
     TextEditor textBox;
     SimpleVisibilityWatcher<SfzFileChooser> watcher { sfzChooser, [this](){ 
         if (!sfzChooser.isVisible())
-        {
-            String text;
-            text << "Masters: " << processor.getNumMasters() << newLine;
-            text << "Groups: " << processor.getNumGroups() << newLine;
-            text << "Regions: " << processor.getNumRegions() << newLine;
-            text << "Unknown opcodes: " << processor.getUnknownOpcodes().joinIntoString(", ") << newLine;
-            text << "Included Files: " << newLine;
-            for (const auto& included: synth.getIncludedFiles())
-                text << "- " << included << newLine;  
-            text << "Defines: " << newLine;
-            for (const auto& define: synth.getDefines())
-                text << "- " << define.first << ": " << define.second << newLine;  
-            auto labels = processor.getCCLabels();
-            text << "CC Labels: " << newLine;
-            for (auto& label: labels)
-                text << "- " << label << newLine;
-            textBox.setText(text);
-        }
+            updateInstrumentDescription();
     }};
 
+    void updateInstrumentDescription()
+    {
+        String text;
+        text << "Masters: " << processor.getNumMasters() << newLine;
+        text << "Groups: " << processor.getNumGroups() << newLine;
+        text << "Regions: " << processor.getNumRegions() << newLine;
+        text << "Unknown opcodes: " << processor.getUnknownOpcodes().joinIntoString(", ") << newLine;
+        text << "Included Files: " << newLine;
+        for (const auto& included: processor.getIncludedFiles())
+            text << "- " << included << newLine;  
+        text << "Defines: " << newLine;
+        for (const auto& define: processor.getDefines())
+            text << "- " << define.first << ": " << define.second << newLine;  
+        auto labels = processor.getCCLabels();
+        text << "CC Labels: " << newLine;
+        for (auto& label: labels)
+            text << "- " << label << newLine;
+        textBox.setText(text);
+    }
+
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR (SfzpluginAudioProcessorEditor)
 };
@@ -104,7 +104,7 @@ void SfzpluginAudioProcessor::prepareToPlay (double newSampleRate, int newSample
     // Use this method as the place to do any pre-playback
     // initialisation that you need..
     this->sampleRate = newSampleRate;
-    sfzSynth.prepareToPlay(newSampleRate, newSamplesPerBlock);
+    instrumentLoader.prepareToPlay(newSampleRate, newSamplesPerBlock);
 }
 
 void SfzpluginAudioProcessor::releaseResources()
@@ -151,6 +151,8 @@ void SfzpluginAudioProcessor::processBlock (AudioBuffer<float>& buffer, MidiBuff
     for (auto i = totalNumInputChannels; i < totalNumOutputChannels; ++i)
         buffer.clear (i, 0, numSamples);
 
+    instrumentLoader.beginBlock();
+    auto& sfzSynth = instrumentLoader.getActiveSynth();
     MidiBuffer::Iterator it { midiMessages };
 	MidiMessage msg;
 	int timestamp;
@@ -170,6 +172,10 @@ void SfzpluginAudioProcessor::processBlock (AudioBuffer<float>& buffer, MidiBuff
 	}
 
     sfzSynth.renderNextBlock(buffer, 0, numSamples);
+    // The previous instrument plays its release tails on top
+    if (auto* fadingSynth = instrumentLoader.getFadingSynth())
+        fadingSynth->renderNextBlock(buffer, 0, numSamples);
+    instrumentLoader.endBlock();
     
     for (int channel = 0; channel < totalNumInputChannels; ++channel)
     {
@@ -186,7 +192,7 @@ bool SfzpluginAudioProcessor::hasEditor() const
 
 AudioProcessorEditor* SfzpluginAudioProcessor::createEditor()
 {
-    return new SfzpluginAudioProcessorEditor (*this, this->keyboardState, this->sfzSynth);
+    return new SfzpluginAudioProcessorEditor (*this, this->keyboardState);
 }
 
 //==============================================================================
@@ -23,6 +23,7 @@
 
 #include "../JuceLibraryCode/JuceHeader.h"
 #include "SfzSynth.h"
+#include "SfzInstrumentLoader.h"
 
 //==============================================================================
 /**
@@ -68,32 +69,36 @@ public:
     void setStateInformation (const void* data, int sizeInBytes) override;
     //==============================================================================
 
-    void loadSfz(const File& sfzFile)
-    {
-        sfzSynth.clear();
-        sfzSynth.loadSfzFile(sfzFile.getFullPathName().toStdString());
-    }
+    // Loads in the background; the current instrument keeps playing until the new one is ready
+    void loadSfz(const File& sfzFile) { instrumentLoader.load(sfzFile); }
+    SfzInstrumentLoader& getInstrumentLoader() { return instrumentLoader; }
 
     StringArray getRegionList() const
     {
-        StringArray returnedList;
-        for (int regionIdx = 0; regionIdx < sfzSynth.getNumRegions(); regionIdx++)
-        {
-            returnedList.add(sfzSynth.getRegionView(regionIdx)->stringDescription());
-        }         
-        
-        return returnedList;
+        return instrumentLoader.withLatestSynth([](const SfzSynth& synth) {
+            StringArray returnedList;
+            for (int regionIdx = 0; regionIdx < synth.getNumRegions(); regionIdx++)
+            {
+                returnedList.add(synth.getRegionView(regionIdx)->stringDescription());
+            }         
+            
+            return returnedList;
+        });
     }
 
-    int getNumRegions() const { return sfzSynth.getNumRegions(); }
-    int getNumGroups() const { return sfzSynth.getNumGroups(); }
-    int getNumMasters() const { return sfzSynth.getNumMasters(); }
-    inline int getNumActiveVoices() { return sfzSynth.getNumActiveVoices(); }
-    StringArray getUnknownOpcodes() const { return sfzSynth.getUnknownOpcodes(); }
-    StringArray getCCLabels() const { return sfzSynth.getCCLabels(); }
+    int getNumRegions() const { return instrumentLoader.withLatestSynth([](const SfzSynth& synth) { return synth.getNumRegions(); }); }
+    int getNumGroups() const { return instrumentLoader.withLatestSynth([](const SfzSynth& synth) { return synth.getNumGroups(); }); }
+    int getNumMasters() const { return instrumentLoader.withLatestSynth([](const SfzSynth& synth) { return synth.getNumMasters(); }); }
+    inline int getNumActiveVoices() { return instrumentLoader.withLatestSynth([](const SfzSynth& synth) { return synth.getNumActiveVoicesInLastBlock(); }); }
+    StringArray getUnknownOpcodes() const { return instrumentLoader.withLatestSynth([](const SfzSynth& synth) { return synth.getUnknownOpcodes(); }); }
+    StringArray getCCLabels() const { return instrumentLoader.withLatestSynth([](const SfzSynth& synth) { return synth.getCCLabels(); }); }
+    std::vector<std::string> getIncludedFiles() const { return instrumentLoader.withLatestSynth([](const SfzSynth& synth) { return synth.getIncludedFiles(); }); }
+    std::map<std::string, std::string> getDefines() const { return instrumentLoader.withLatestSynth([](const SfzSynth& synth) { return synth.getDefines(); }); }
     
 private:
-    SfzSynth sfzSynth;
+    SfzInstrumentLoader instrumentLoader { [](SfzSynth& synth) {
+        synth.setInstrumentCacheDirectory(File::getSpecialLocation(File::userApplicationDataDirectory).getChildFile("sfizz").getChildFile("Cache"));
+    }};
     double sampleRate { 48000 };
     MidiKeyboardState keyboardState;
     AudioFormatManager formatManager;
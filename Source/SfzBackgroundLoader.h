@@ -0,0 +1,147 @@
+/*
+    ==============================================================================
+
+    Copyright 2019 - Paul Ferrand (paulfd@outlook.fr)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    ==============================================================================
+*/
+
+
+#pragma once
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "SfzGlobals.h"
+#include "SfzLockFreeQueue.h"
+#include "SfzSemaphore.h"
+#include <atomic>
+#include <memory>
+#include <vector>
+
+/**
+ * Work that the audio thread hands to the background loader, such as streaming the next
+ * part of a sample or freeing a finished voice.
+ */
+class SfzBackgroundJob
+{
+public:
+    virtual ~SfzBackgroundJob() = default;
+protected:
+    virtual void runBackgroundJob() = 0;
+private:
+    friend class SfzBackgroundLoader;
+    // Requests not yet handled; the job is in the queue or running while this is positive
+    std::atomic<int> pendingRequests { 0 };
+};
+
+/**
+ * Threads running background jobs requested from the audio thread.
+ *
+ * Requesting a job only touches atomics and a lock-free queue, so it never blocks on a
+ * loader or allocates. A job is queued once however many times it is requested, and runs
+ * again if it was requested while running, so no request is lost and a job never runs on
+ * two threads at once. Each queued job posts to a semaphore the loader threads sleep on,
+ * which does not lock on the audio thread either, so idle loaders never wake up.
+ */
+class SfzBackgroundLoader
+{
+public:
+    SfzBackgroundLoader(int numThreads, size_t maximumJobs = config::maxBackgroundJobs)
+    : queue(maximumJobs)
+    {
+        for (int threadIdx = 0; threadIdx < numThreads; ++threadIdx)
+            threads.push_back(std::make_unique<LoaderThread>(*this));
+
+        for (auto& thread: threads)
+            thread->startThread();
+    }
+
+    ~SfzBackgroundLoader()
+    {
+        for (auto& thread: threads)
+            thread->signalThreadShouldExit();
+        for (size_t threadIdx = 0; threadIdx < threads.size(); ++threadIdx)
+            jobsQueued.post();
+        for (auto& thread: threads)
+            thread->stopThread(-1);
+    }
+
+    // Real-time safe. Only fails if more jobs than the queue capacity are pending at once.
+    bool request(SfzBackgroundJob& job) noexcept
+    {
+        if (job.pendingRequests.fetch_add(1) > 0)
+            return true;
+
+        if (queue.tryPush(&job))
+        {
+            jobsQueued.post();
+            return true;
+        }
+
+        jassertfalse;
+        job.pendingRequests.store(0);
+        return false;
+    }
+
+    bool isPending(const SfzBackgroundJob& job) const noexcept { return job.pendingRequests.load() > 0; }
+
+    // Blocks until the job is neither queued nor running, e.g. before destroying it
+    void waitForJob(const SfzBackgroundJob& job) const
+    {
+        while (isPending(job))
+            Thread::sleep(1);
+    }
+
+    size_t getMaximumJobs() const noexcept { return queue.getCapacity(); }
+private:
+    class LoaderThread: public Thread
+    {
+    public:
+        LoaderThread(SfzBackgroundLoader& loader)
+        : Thread("Sfz background loader"), loader(loader) { }
+
+        void run() override
+        {
+            while (!threadShouldExit())
+            {
+                // One post per queued job, plus one per thread when stopping. Every wake up drains the
+                // queue, since a job does not show up while an earlier push is still in progress.
+                loader.jobsQueued.wait();
+                SfzBackgroundJob* job { nullptr };
+                while (!threadShouldExit() && loader.queue.tryPop(job))
+                    runJob(*job);
+            }
+        }
+    private:
+        // Runs again as long as requests came in while running
+        static void runJob(SfzBackgroundJob& job)
+        {
+            auto handledRequests = job.pendingRequests.load();
+            for (;;)
+            {
+                job.runBackgroundJob();
+                const auto remainingRequests = job.pendingRequests.fetch_sub(handledRequests) - handledRequests;
+                if (remainingRequests == 0)
+                    break;
+                handledRequests = remainingRequests;
+            }
+        }
+
+        SfzBackgroundLoader& loader;
+    };
+
+    SfzLockFreeQueue<SfzBackgroundJob*> queue;
+    SfzSemaphore jobsQueued;
+    std::vector<std::unique_ptr<LoaderThread>> threads;
+};
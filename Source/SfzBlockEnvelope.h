@@ -17,8 +17,8 @@ public:
 
     void reserve(int maximum)
     {
-        events.reserve(maximumEvents);
         maximumEvents = maximum;
+        events.reserve(maximumEvents);
     }
 
     void addEvent(int timestamp, InputType value)
@@ -35,16 +35,24 @@ public:
         }
     }
 
+    // Fills every channel of the block with the same envelope
     void getEnvelope(dsp::AudioBlock<float> output)
+    {
+        const auto numSamples = static_cast<int>(output.getNumSamples());
+        getEnvelope(output.getChannelPointer(0), numSamples);
+        for (size_t channelIndex = 1; channelIndex < output.getNumChannels(); ++channelIndex)
+            FloatVectorOperations::copy(output.getChannelPointer(channelIndex), output.getChannelPointer(0), numSamples);
+    }
+
+    void getEnvelope(OutputType* output, int numSamples)
     {
         if (events.empty())
         {
-            output.fill(currentValue);
+            std::fill(output, output + numSamples, currentValue);
             return;
         }
 
         std::sort(events.begin(), events.end(), EventComparator());
-        const auto numSamples = output.getNumSamples();
         int eventIndex { 0 };
         int sampleIndex { 0 };
         int numSteps { 0 };
@@ -60,9 +68,9 @@ public:
                     eventIndex++;
                 }
                 
-                if (eventIndex == events.size())
+                if (eventIndex == static_cast<int>(events.size()))
                 {
-                    output.getSubBlock(sampleIndex, numSamples - sampleIndex).fill(currentValue);
+                    std::fill(output + sampleIndex, output + numSamples, currentValue);
                     clearEvents();
                     return;
                 }
@@ -73,8 +81,7 @@ public:
                 }
             }
 
-            for (auto channelIndex = 0; channelIndex < config::numChannels; ++channelIndex)
-                output.setSample(channelIndex, sampleIndex, currentValue);
+            output[sampleIndex] = currentValue;
             numSteps--;
             sampleIndex++;
             currentValue += step;
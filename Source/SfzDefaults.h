@@ -28,6 +28,7 @@ enum class SfzLoopMode { no_loop, one_shot, loop_continuous, loop_sustain };
 enum class SfzOffMode { fast, normal };
 enum class SfzVelocityOverride { current, previous };
 enum class SfzCrossfadeCurve { gain, power };
+enum class SfzStealingPolicy { oldest, quietest, sameNoteFirst, releaseFirst };
 
 namespace SfzDefault
 {
@@ -49,6 +50,7 @@ namespace SfzDefault
     inline constexpr uint32_t group { 0 };
     inline constexpr Range<uint32_t> groupRange { 0, std::numeric_limits<uint32_t>::max() };
     inline constexpr SfzOffMode offMode { SfzOffMode::fast };
+    inline constexpr Range<uint32_t> polyphonyRange { 1, 65535 };
 
     // Region logic: key mapping
     inline constexpr Range<uint8_t> keyRange { 0, 127 };
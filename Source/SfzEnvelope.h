@@ -23,6 +23,9 @@
 #include "../JuceLibraryCode/JuceHeader.h"
 #include "SfzGlobals.h"
 #include "SfzDefaults.h"
+#include <algorithm>
+#include <cmath>
+#include <limits>
 #include <optional>
 
 inline float ccSwitchedValue(const CCValueArray& ccValues, const std::optional<CCValuePair>& ccSwitch, float value) noexcept
@@ -89,116 +92,232 @@ struct SfzEnvelopeGeneratorDescription
     }
 };
 
+/**
+ * @brief Amplitude envelope generator, rendered segment by segment.
+ *
+ * The envelope goes through delay, attack, hold, decay and sustain until it is released.
+ * The attack is a linear ramp from 0 to 1, while the decay and release are exponential ramps
+ * towards config::virtuallyZero. Each segment is computed in closed form over the samples of
+ * a block instead of stepping through the states for every sample.
+ */
 class SfzEnvelopeGeneratorValue
 {
 public:
-    SfzEnvelopeGeneratorValue() noexcept
-    {
-        attackEnvelopeValue.reset(1);
-        attackEnvelopeValue.setCurrentAndTargetValue(0.0f);
-        attackEnvelopeValue.setTargetValue(1.0f);
-
-        decayEnvelopeValue.reset(1);
-        decayEnvelopeValue.setCurrentAndTargetValue(1.0f);
-        decayEnvelopeValue.setTargetValue(config::virtuallyZero);
+    enum class EGState { delay, attack, hold, decay, sustain, release, done };
 
-        releaseEnvelopeValue.reset(1);
-        releaseEnvelopeValue.setCurrentAndTargetValue(1.0f);
-        releaseEnvelopeValue.setTargetValue(config::virtuallyZero);
-    }
-    
     void setSampleRate(double rate) noexcept { sampleRate = rate; }
 
     void prepare(const SfzEnvelopeGeneratorDescription& egDescription, const CCValueArray& ccValues, uint8_t velocity, uint32_t additionalDelay = 0) noexcept
     {
-        auto secondsToSamples = [this](auto timeInSeconds) { 
-            return static_cast<int>(timeInSeconds * sampleRate);
-        };
-        state = EGState::attack;
-        remainingSamplesBeforeRelease = 0;
-        remainingDelaySamples = additionalDelay + secondsToSamples(egDescription.getDelay(ccValues, velocity));
-        remainingHoldSamples = secondsToSamples(egDescription.getHold(ccValues, velocity));
+        delaySamples = static_cast<int>(additionalDelay) + secondsToSamples(egDescription.getDelay(ccValues, velocity));
+        attackSamples = secondsToSamples(egDescription.getAttack(ccValues, velocity));
+        holdSamples = secondsToSamples(egDescription.getHold(ccValues, velocity));
+        decaySamples = secondsToSamples(egDescription.getDecay(ccValues, velocity));
+        setReleaseSamples(secondsToSamples(egDescription.getRelease(ccValues, velocity)));
+
+        attackStep = attackSamples > 0 ? 1.0f / static_cast<float>(attackSamples) : 1.0f;
+        decayRatio = exponentialRatio(decaySamples);
+        // The decay ends at virtuallyZero, not exactly at 0
         sustainGain = normalizePercents(egDescription.getSustain(ccValues, velocity));
+        sustainLevel = config::virtuallyZero * (1 - sustainGain) + sustainGain;
+
+        state = EGState::delay;
+        samplesInState = 0;
+        currentLevel = 0.0f;
+        decayValue = 1.0f;
+        releaseValue = 1.0f;
+        samplesBeforeRelease.reset();
+    }
 
-        attackEnvelopeValue.reset(secondsToSamples(egDescription.getAttack(ccValues, velocity)));
-        attackEnvelopeValue.setCurrentAndTargetValue(0.0f);
-        attackEnvelopeValue.setTargetValue(1.0f);
+    /**
+     * @brief Release the envelope after a delay in samples, counted from the start of the next block.
+     * A fast release replaces the release time by config::fastReleaseDuration if it is shorter.
+     */
+    void release(uint32_t delay = 0, bool fastRelease = false) noexcept
+    {
+        if (state == EGState::release || state == EGState::done)
+            return;
 
-        releaseEnvelopeValue.reset(secondsToSamples(egDescription.getRelease(ccValues, velocity)));
-        releaseEnvelopeValue.setCurrentAndTargetValue(1.0f);
-        releaseEnvelopeValue.setTargetValue(config::virtuallyZero);
+        if (fastRelease)
+            setReleaseSamples(jmin(releaseSamples, secondsToSamples(config::fastReleaseDuration)));
 
-        decayEnvelopeValue.reset(secondsToSamples(egDescription.getDecay(ccValues, velocity)));
-        decayEnvelopeValue.setCurrentAndTargetValue(1.0f);
-        decayEnvelopeValue.setTargetValue(config::virtuallyZero);
+        samplesBeforeRelease = static_cast<int>(delay);
     }
 
-    enum class EGState { attack, release };
+    /**
+     * @brief Returns false once the release segment has ended.
+     */
+    bool isSmoothing() const noexcept { return state != EGState::done; }
+    EGState getState() const noexcept { return state; }
+    float getCurrentValue() const noexcept { return currentLevel; }
 
-    bool isSmoothing() noexcept
+    float getNextValue() noexcept
     {
-        return releaseEnvelopeValue.isSmoothing();
+        float value;
+        getBlock(&value, 1);
+        return value;
     }
 
-    float getNextValue() noexcept
+    void getBlock(float* output, int numSamples) noexcept
     {
-        float envelopeGain { config::virtuallyZero };
+        int index { 0 };
+        while (index < numSamples)
+        {
+            if (samplesBeforeRelease && *samplesBeforeRelease == 0)
+                startRelease();
+
+            auto segmentEnd = numSamples;
+            if (samplesBeforeRelease)
+                segmentEnd = jmin(segmentEnd, index + *samplesBeforeRelease);
+
+            const auto rendered = renderSegment(output + index, segmentEnd - index);
+            index += rendered;
+            if (samplesBeforeRelease)
+                *samplesBeforeRelease -= rendered;
+        }
+    }
+
+private:
+    int secondsToSamples(float timeInSeconds) const noexcept
+    {
+        return jmax(0, static_cast<int>(std::lround(timeInSeconds * sampleRate)));
+    }
+
+    void setReleaseSamples(int numSamples) noexcept
+    {
+        releaseSamples = numSamples;
+        releaseRatio = exponentialRatio(numSamples);
+    }
 
-        if (state == EGState::attack)
+    // The ratio that takes 1 to virtuallyZero in numSamples multiplications
+    static float exponentialRatio(int numSamples) noexcept
+    {
+        if (numSamples <= 0)
+            return config::virtuallyZero;
+        return static_cast<float>(std::exp(std::log(config::virtuallyZero) / numSamples));
+    }
+
+    // output[i] = start * ratio^(i + 1), with the powers of the ratio computed 4 lanes at a time
+    static void exponentialRamp(float* output, int numSamples, float start, float ratio) noexcept
+    {
+        const auto ratio2 = ratio * ratio;
+        const auto ratio4 = ratio2 * ratio2;
+        const float powers[4] { ratio, ratio2, ratio2 * ratio, ratio4 };
+        int index { 0 };
+        for (; index + 4 <= numSamples; index += 4)
+        {
+            for (int lane = 0; lane < 4; ++lane)
+                output[index + lane] = start * powers[lane];
+            start *= ratio4;
+        }
+        for (; index < numSamples; ++index)
         {
-            if (remainingDelaySamples > 0)
-            {
-                // We're at 0 already
-                remainingDelaySamples--;
-            }
-            
-            if (remainingDelaySamples == 0 && attackEnvelopeValue.isSmoothing())
-            {
-                envelopeGain = attackEnvelopeValue.getNextValue();
-            }
-
-            if (remainingDelaySamples == 0 && !attackEnvelopeValue.isSmoothing() && remainingHoldSamples > 0)
-            {
-                envelopeGain = 1.0f;
-                remainingHoldSamples--;
-            }
-
-            if (remainingDelaySamples == 0 && !attackEnvelopeValue.isSmoothing() && remainingHoldSamples == 0)
-            {
-                envelopeGain = decayEnvelopeValue.getNextValue() * (1 - sustainGain) + sustainGain;
-            }                
+            start *= ratio;
+            output[index] = start;
         }
+    }
 
-        if (state == EGState::release)
+    int getSegmentLength() const noexcept
+    {
+        switch (state)
         {
-            envelopeGain = decayEnvelopeValue.getNextValue() * (1 - sustainGain) + sustainGain;
-            envelopeGain *= attackEnvelopeValue.getCurrentValue();
-            if (remainingSamplesBeforeRelease > 0)
-                remainingSamplesBeforeRelease--;
-            else
-                envelopeGain *= releaseEnvelopeValue.getNextValue();
+        case EGState::delay: return delaySamples;
+        case EGState::attack: return attackSamples;
+        case EGState::hold: return holdSamples;
+        case EGState::decay: return decaySamples;
+        case EGState::release: return releaseSamples;
+        case EGState::sustain: // fallthrough
+        case EGState::done: // fallthrough
+        default: return std::numeric_limits<int>::max();
         }
+    }
 
-        return envelopeGain;
+    void nextState() noexcept
+    {
+        switch (state)
+        {
+        case EGState::delay: state = EGState::attack; break;
+        case EGState::attack: state = EGState::hold; break;
+        case EGState::hold: state = EGState::decay; decayValue = 1.0f; break;
+        case EGState::decay: state = EGState::sustain; break;
+        case EGState::release: state = EGState::done; break;
+        case EGState::sustain: // fallthrough
+        case EGState::done: break;
+        }
+        samplesInState = 0;
     }
 
-    void release(uint32_t delay = 0, bool fastRelease = false) noexcept
+    void startRelease() noexcept
     {
-        if (fastRelease)
-            releaseEnvelopeValue.reset(static_cast<int>(config::fastReleaseDuration * sampleRate));
-        
-        remainingSamplesBeforeRelease = delay;
+        samplesBeforeRelease.reset();
         state = EGState::release;
+        samplesInState = 0;
+        releaseValue = currentLevel;
+        if (releaseSamples == 0)
+            state = EGState::done;
     }
 
-private:
-    uint32_t remainingDelaySamples { 0 };
-    EGState state { EGState::attack };
-    SmoothedValue<float, ValueSmoothingTypes::Linear> attackEnvelopeValue;
-    uint32_t remainingHoldSamples { 0 };
-    SmoothedValue<float, ValueSmoothingTypes::Multiplicative> decayEnvelopeValue;
-    float sustainGain { 1.0 };
-    uint32_t remainingSamplesBeforeRelease { 0 };
-    SmoothedValue<float, ValueSmoothingTypes::Multiplicative> releaseEnvelopeValue;
+    // Renders at most maxSamples of the current segment, and returns the number of rendered samples.
+    // This can be 0 when the segment is empty, in which case the state moves on to the next one.
+    int renderSegment(float* output, int maxSamples) noexcept
+    {
+        const auto numSamples = jmin(maxSamples, getSegmentLength() - samplesInState);
+        switch (state)
+        {
+        case EGState::delay:
+        case EGState::done:
+            std::fill(output, output + numSamples, 0.0f);
+            break;
+        case EGState::attack:
+            for (int index = 0; index < numSamples; ++index)
+                output[index] = static_cast<float>(samplesInState + index + 1) * attackStep;
+            break;
+        case EGState::hold:
+            std::fill(output, output + numSamples, 1.0f);
+            break;
+        case EGState::decay:
+            exponentialRamp(output, numSamples, decayValue, decayRatio);
+            if (numSamples > 0)
+                decayValue = output[numSamples - 1];
+            for (int index = 0; index < numSamples; ++index)
+                output[index] = output[index] * (1 - sustainGain) + sustainGain;
+            break;
+        case EGState::sustain:
+            std::fill(output, output + numSamples, sustainLevel);
+            break;
+        case EGState::release:
+            exponentialRamp(output, numSamples, releaseValue, releaseRatio);
+            if (numSamples > 0)
+                releaseValue = output[numSamples - 1];
+            break;
+        }
+
+        // The sustain and done segments have no end
+        if (state != EGState::sustain && state != EGState::done)
+            samplesInState += numSamples;
+        if (numSamples > 0)
+            currentLevel = output[numSamples - 1];
+        if (samplesInState >= getSegmentLength())
+            nextState();
+        return numSamples;
+    }
+
+    EGState state { EGState::delay };
+    int samplesInState { 0 };
+    std::optional<int> samplesBeforeRelease;
+    float currentLevel { 0.0f };
+
+    int delaySamples { 0 };
+    int attackSamples { 0 };
+    int holdSamples { 0 };
+    int decaySamples { 0 };
+    int releaseSamples { 0 };
+    float attackStep { 1.0f };
+    float decayRatio { config::virtuallyZero };
+    float decayValue { 1.0f };
+    float sustainGain { 1.0f };
+    float sustainLevel { 1.0f };
+    float releaseRatio { config::virtuallyZero };
+    float releaseValue { 1.0f };
     double sampleRate { config::defaultSampleRate };
-};
\ No newline at end of file
+};
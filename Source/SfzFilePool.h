@@ -23,12 +23,49 @@
 #include "../JuceLibraryCode/JuceHeader.h"
 #include "JuceHelpers.h"
 #include "SfzGlobals.h"
+#include "SfzSampleCache.h"
+#include "SfzGarbageCollector.h"
+#include "SfzSampleBuffer.h"
+#include <cstring>
+#include <iterator>
 #include <memory>
 #include <map>
+#include <optional>
+#include <type_traits>
+#include <vector>
+
+struct SfzSampleMetadata
+{
+    double sampleRate { config::defaultSampleRate };
+    int64 lengthInSamples { 0 };
+    int numChannels { 1 };
+    SfzSampleFormat format { SfzSampleFormat::float32 }; // How the frames are kept in memory
+    std::optional<Range<uint32_t>> loopRange {}; // From the Loop0Start and Loop0End metadata
+};
+
+// The resident frames of a sample file, from start to start + data->getNumSamples()
+struct SfzPreloadWindow
+{
+    int64 start { 0 };
+    std::shared_ptr<SfzSampleBuffer> data {};
+
+    int64 getEnd() const noexcept { return data != nullptr ? start + data->getNumSamples() : start; }
+    Range<int64> getRange() const noexcept { return { start, getEnd() }; }
+};
+
+// The file size and modification time tell whether the metadata is still valid for the file on disk
+struct SfzSampleIndexEntry
+{
+    SfzSampleMetadata metadata;
+    int64 modificationTime { 0 };
+    int64 fileSize { 0 };
+};
 
 class SfzFilePool
 {
 public:
+    static_assert(config::numChannels <= SfzSampleBuffer::maxChannels, "The sample buffers hold the channels the voices play");
+
     SfzFilePool(const File& rootDirectory)
     : rootDirectory(rootDirectory)
     {
@@ -41,11 +78,17 @@ public:
             this->rootDirectory = directory;
     }
     
-    void preload(const String& sampleName, int offset = 0, int numSamples = config::preloadSize)
+    // Preloads the frames a region can start playing from: from its first possible offset up to
+    // numSamples after its last possible offset. Only the frames that are not resident yet are read,
+    // and when the sample length is known nothing is opened if they are all resident already.
+    void preload(const String& sampleName, int64 firstOffset = 0, int64 lastOffset = 0, int numSamples = config::preloadSize, std::optional<int64> knownLength = {})
     {        
         if (sampleName.startsWith("*"))
             return;
 
+        if (knownLength && getMissingRanges(sampleName, getPreloadRange(firstOffset, lastOffset, numSamples, *knownLength)).empty())
+            return;
+
         auto reader = createReaderFor(sampleName);
         if (reader == nullptr)
         {
@@ -53,25 +96,195 @@ public:
             return;
         }
 
-        const int actualNumSamples = [offset, numSamples, &reader](){
-            if (numSamples > 0) 
-                return (int) jmin( (int64)numSamples + offset, reader->lengthInSamples);
-            else
-                return static_cast<int>(reader->lengthInSamples);
-        }();
+        const auto preloadRange = getPreloadRange(firstOffset, lastOffset, numSamples, reader->lengthInSamples);
+        for (auto& missingRange: getMissingRanges(sampleName, preloadRange))
+            addPreloadedData(sampleName, missingRange.getStart(), readPreloadedData(*reader, missingRange));
+    }
+
+    // A non-positive number of samples preloads everything from the first offset
+    static Range<int64> getPreloadRange(int64 firstOffset, int64 lastOffset, int numSamples, int64 sampleLength)
+    {
+        const auto start = jlimit<int64>(0, sampleLength, firstOffset);
+        if (numSamples <= 0)
+            return { start, sampleLength };
+
+        return { start, jlimit<int64>(start, sampleLength, jmax(firstOffset, lastOffset) + numSamples) };
+    }
+
+    // Does not touch the pool, so it can run on any thread with its own reader
+    static std::shared_ptr<SfzSampleBuffer> readPreloadedData(AudioFormatReader& reader, Range<int64> range)
+    {
+        return readSamples(reader, range.getStart(), static_cast<int>(range.getLength()));
+    }
+
+    // Integer files are kept as integers, which divides their memory use by 2 or by 4/3; wider
+    // than 24 bits they lose their lowest bits, which are below the noise floor of the float voices
+    static SfzSampleFormat getStorageFormat(const AudioFormatReader& reader)
+    {
+        if (reader.usesFloatingPointData)
+            return SfzSampleFormat::float32;
+
+        return reader.bitsPerSample > 16 ? SfzSampleFormat::int24 : SfzSampleFormat::int16;
+    }
+
+    // Reads the frames in the storage format and the channel count of the file, up to 2 channels
+    static std::shared_ptr<SfzSampleBuffer> readSamples(AudioFormatReader& reader, int64 startSample, int numSamples)
+    {
+        const auto format = getStorageFormat(reader);
+        auto data = std::make_shared<SfzSampleBuffer>(format, static_cast<int>(reader.numChannels), numSamples);
+        const auto numChannels = data->getNumChannels();
+
+        // The reader gives left-justified 32 bit integers for integer formats, and the bits of floats otherwise
+        HeapBlock<int> chunk (static_cast<size_t>(numChannels) * config::streamChunkSize);
+        int* chunkChannels[SfzSampleBuffer::maxChannels] {};
+        for (int chanIdx = 0; chanIdx < numChannels; ++chanIdx)
+            chunkChannels[chanIdx] = chunk.get() + chanIdx * config::streamChunkSize;
+
+        for (int position = 0; position < numSamples; position += config::streamChunkSize)
+        {
+            const auto numFrames = jmin(config::streamChunkSize, numSamples - position);
+            reader.read(chunkChannels, numChannels, startSample + position, numFrames, false);
+            SfzSampleBuffer::withSampleType(format, [&](auto sampleType) {
+                using T = decltype(sampleType);
+                for (int chanIdx = 0; chanIdx < numChannels; ++chanIdx)
+                {
+                    auto* output = data->getWritePointer<T>(chanIdx) + position;
+                    for (int frameIdx = 0; frameIdx < numFrames; ++frameIdx)
+                        output[frameIdx] = fromReaderSample<T>(chunkChannels[chanIdx][frameIdx]);
+                }
+            });
+        }
+        return data;
+    }
+
+    template<class T>
+    static T fromReaderSample(int sample) noexcept
+    {
+        if constexpr (std::is_same<T, int16_t>::value)
+            return static_cast<int16_t>(sample >> 16);
+        else if constexpr (std::is_same<T, SfzInt24>::value)
+            return SfzInt24::fromInt(sample >> 8);
+        else
+        {
+            float floatSample;
+            std::memcpy(&floatSample, &sample, sizeof(float));
+            return floatSample;
+        }
+    }
+
+    // The parts of the range that are not preloaded yet, in order
+    std::vector<Range<int64>> getMissingRanges(const String& sampleName, Range<int64> range) const
+    {
+        std::vector<Range<int64>> missingRanges;
+        auto position = range.getStart();
+        const auto windows = preloadedData.find(sampleName);
+        if (windows != end(preloadedData))
+        {
+            for (auto& window: windows->second)
+            {
+                if (window.getEnd() <= position)
+                    continue;
+                if (window.start >= range.getEnd())
+                    break;
+                if (window.start > position)
+                    missingRanges.emplace_back(position, window.start);
+                position = window.getEnd();
+            }
+        }
+
+        if (position < range.getEnd())
+            missingRanges.emplace_back(position, range.getEnd());
+        return missingRanges;
+    }
+
+    // Windows that overlap or touch the new data are merged with it by copying the resident
+    // frames, so the file is never read again to extend a window.
+    void addPreloadedData(const String& sampleName, int64 start, std::shared_ptr<SfzSampleBuffer> data)
+    {
+        if (data == nullptr || data->getNumSamples() == 0)
+            return;
+
+        auto& windows = preloadedData[sampleName];
+        SfzPreloadWindow addedWindow { start, std::move(data) };
+        auto mergedRange = addedWindow.getRange();
+
+        auto firstMerged = windows.begin();
+        while (firstMerged != windows.end() && firstMerged->getEnd() < mergedRange.getStart())
+            ++firstMerged;
+
+        auto lastMerged = firstMerged;
+        while (lastMerged != windows.end() && lastMerged->start <= mergedRange.getEnd())
+        {
+            mergedRange = mergedRange.getUnionWith(lastMerged->getRange());
+            ++lastMerged;
+        }
+
+        if (firstMerged == lastMerged)
+        {
+            windows.insert(firstMerged, std::move(addedWindow));
+            return;
+        }
+
+        if (std::next(firstMerged) == lastMerged && firstMerged->getRange().contains(addedWindow.getRange()))
+            return;
+
+        // All the windows of a file have the same format and channel count
+        const auto& format = *addedWindow.data;
+        SfzPreloadWindow mergedWindow { mergedRange.getStart(), std::make_shared<SfzSampleBuffer>(format.getFormat(), format.getNumChannels(), static_cast<int>(mergedRange.getLength())) };
+        auto copyWindow = [&mergedWindow](const SfzPreloadWindow& window) {
+            mergedWindow.data->copyFrom(static_cast<int>(window.start - mergedWindow.start), *window.data);
+        };
 
-        const auto alreadyPreloaded = preloadedData.find(sampleName);
-        if (alreadyPreloaded == end(preloadedData) || alreadyPreloaded->second->getNumSamples() < actualNumSamples)
+        copyWindow(addedWindow);
+        for (auto window = firstMerged; window != lastMerged; ++window)
+            copyWindow(*window);
+
+        const auto insertPosition = windows.erase(firstMerged, lastMerged);
+        windows.insert(insertPosition, std::move(mergedWindow));
+    }
+
+    // The window holding the frame at this position, or an empty window if it is not resident
+    SfzPreloadWindow getPreloadedData(const String& sampleName, int64 position = 0) const
+    {
+        const auto windows = preloadedData.find(sampleName);
+        if (windows == end(preloadedData))
+            return {};
+
+        for (auto& window: windows->second)
+        {
+            if (window.getRange().contains(position))
+                return window;
+        }
+        return {};
+    }
+
+    std::vector<Range<int64>> getResidentRanges(const String& sampleName) const
+    {
+        std::vector<Range<int64>> residentRanges;
+        const auto windows = preloadedData.find(sampleName);
+        if (windows != end(preloadedData))
         {
-            preloadedData[sampleName] = std::make_shared<AudioBuffer<float>>(config::numChannels, actualNumSamples);
-            preloadedData[sampleName]->clear();
-            reader->read(preloadedData[sampleName].get(), 0, actualNumSamples, 0, true, true);
+            for (auto& window: windows->second)
+                residentRanges.push_back(window.getRange());
         }
+        return residentRanges;
+    }
+
+    size_t getPreloadedMemory() const
+    {
+        size_t memory { 0 };
+        for (auto& [sampleName, windows]: preloadedData)
+            for (auto& window: windows)
+                memory += window.data->getSizeInBytes();
+        return memory;
     }
 
+    File getRootDirectory() const { return rootDirectory; }
+    File getSampleFile(const String& sampleName) const { return rootDirectory.getChildFile(sampleName); }
+
     std::unique_ptr<AudioFormatReader> createReaderFor(const String& sampleName)
     {
-        File sampleFile { rootDirectory.getChildFile(sampleName) };
+        File sampleFile { getSampleFile(sampleName) };
         if (!sampleFile.existsAsFile())
         {
             DBG("Can't find file " << sampleName );
@@ -80,22 +293,122 @@ public:
         return std::unique_ptr<AudioFormatReader>(audioFormatManager.createReaderFor(sampleFile));
     }
 
-    void clear()
+    // Only opens the file if the sample is not in the metadata index
+    std::optional<SfzSampleMetadata> getMetadata(const String& sampleName)
     {
-        preloadedData.clear();
+        if (auto metadata = getIndexedMetadata(sampleName))
+            return metadata;
+
+        auto reader = createReaderFor(sampleName);
+        if (reader == nullptr)
+            return {};
+
+        const auto metadata = readMetadata(*reader);
+        addToIndex(sampleName, metadata);
+        countMetadataRead();
+        return metadata;
     }
 
-    std::shared_ptr<AudioBuffer<float>> getPreloadedData(const String& sampleName)
+    std::optional<SfzSampleMetadata> getIndexedMetadata(const String& sampleName) const
     {
-        auto data = preloadedData.find(sampleName);
-        if (data != end(preloadedData))
-            return data->second;
-        
+        const auto sampleFile = getSampleFile(sampleName);
+        const auto entry = metadataIndex.find(sampleFile.getFullPathName());
+        if (entry == end(metadataIndex))
+            return {};
+
+        // The file changed on disk since it was indexed
+        if (entry->second.modificationTime != sampleFile.getLastModificationTime().toMilliseconds()
+            || entry->second.fileSize != sampleFile.getSize())
+            return {};
+
+        return entry->second.metadata;
+    }
+
+    void addToIndex(const String& sampleName, const SfzSampleMetadata& metadata)
+    {
+        const auto sampleFile = getSampleFile(sampleName);
+        addToIndex(sampleFile.getFullPathName(), { metadata, sampleFile.getLastModificationTime().toMilliseconds(), sampleFile.getSize() });
+    }
+
+    void addToIndex(const String& fullPath, const SfzSampleIndexEntry& entry)
+    {
+        const auto existing = metadataIndex.find(fullPath);
+        if (existing != end(metadataIndex) && existing->second.modificationTime == entry.modificationTime
+            && existing->second.fileSize == entry.fileSize)
+            return;
+
+        metadataIndex[fullPath] = entry;
+        indexModified = true;
+    }
+
+    const std::map<String, SfzSampleIndexEntry>& getMetadataIndex() const { return metadataIndex; }
+    bool isIndexModified() const { return indexModified; }
+    void setIndexSaved() { indexModified = false; }
+
+    // Counts the sample headers parsed to get metadata, which the index is there to avoid
+    void countMetadataRead() { numMetadataReads++; }
+    int getNumMetadataReads() const { return numMetadataReads; }
+
+    static SfzSampleMetadata readMetadata(const AudioFormatReader& reader)
+    {
+        SfzSampleMetadata metadata;
+        metadata.sampleRate = reader.sampleRate;
+        metadata.lengthInSamples = reader.lengthInSamples;
+        metadata.numChannels = static_cast<int>(reader.numChannels);
+        metadata.format = getStorageFormat(reader);
+        if (reader.metadataValues.containsKey("Loop0Start") && reader.metadataValues.containsKey("Loop0End"))
+        {
+            metadata.loopRange = Range<uint32_t>(
+                static_cast<uint32_t>(reader.metadataValues["Loop0Start"].getLargeIntValue()),
+                static_cast<uint32_t>(reader.metadataValues["Loop0End"].getLargeIntValue())
+            );
+        }
+        return metadata;
+    }
+
+    // Returns the whole decoded sample if the shared cache holds it. Otherwise the cache decodes it
+    // in the background, once for all the voices asking, and they stream the sample meanwhile.
+    // Returns nothing if the sample is too big to be cached and should always be streamed.
+    SfzSampleCache::DecodedSample getDecodedSample(const String& sampleName, const SfzSampleMetadata& metadata)
+    {
+        if (SfzSampleBuffer::getSizeInBytes(metadata.format, metadata.numChannels, metadata.lengthInSamples) > config::maxCachedSampleSize)
+            return {};
+
+        const auto sampleFile = getSampleFile(sampleName);
+        const auto key = sampleFile.getFullPathName();
+        const auto modificationTime = sampleFile.getLastModificationTime().toMilliseconds();
+        if (auto cachedSample = sampleCache->get(key, modificationTime))
+            return cachedSample;
+
+        // The decode may run after this pool is gone, so it only holds on to the file
+        sampleCache->requestDecode(key, modificationTime, [sampleFile]() -> SfzSampleCache::DecodedSample {
+            AudioFormatManager formatManager;
+            formatManager.registerBasicFormats();
+            std::unique_ptr<AudioFormatReader> reader { formatManager.createReaderFor(sampleFile) };
+            if (reader == nullptr)
+                return {};
+
+            return readSamples(*reader, 0, static_cast<int>(reader->lengthInSamples));
+        });
         return {};
     }
 
+    SfzSampleCache& getSampleCache() { return *sampleCache; }
+    SfzGarbageCollector& getGarbageCollector() { return *garbageCollector; }
+
+    // The metadata index is kept: its entries are checked against the files on disk when used
+    void clear()
+    {
+        preloadedData.clear();
+    }
+
 private:
     File rootDirectory;
     AudioFormatManager audioFormatManager;
-    std::map<String, std::shared_ptr<AudioBuffer<float>>> preloadedData;
+    std::map<String, std::vector<SfzPreloadWindow>> preloadedData; // Sorted, disjoint and not contiguous
+    std::map<String, SfzSampleIndexEntry> metadataIndex; // Keyed by full path
+    bool indexModified { false };
+    int numMetadataReads { 0 };
+    SharedResourcePointer<SfzSampleCache> sampleCache;
+    SharedResourcePointer<SfzGarbageCollector> garbageCollector;
 };
\ No newline at end of file
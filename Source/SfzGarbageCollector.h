@@ -0,0 +1,109 @@
+/*
+    ==============================================================================
+
+    Copyright 2019 - Paul Ferrand (paulfd@outlook.fr)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    ==============================================================================
+*/
+
+
+#pragma once
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "SfzGlobals.h"
+#include "SfzLockFreeQueue.h"
+#include "SfzSampleBuffer.h"
+#include <atomic>
+#include <memory>
+
+/**
+ * Process-wide collector for the sample buffers the voices let go of, shared through a
+ * SharedResourcePointer.
+ *
+ * Dropping a shared buffer can free megabytes of memory if it was the last reference.
+ * Voices hand their buffers over instead: the hand-over only moves the pointer into a
+ * lock-free queue, and a low-priority thread drops them later. If the queue is full the
+ * buffer is dropped in place, which the counters show.
+ */
+class SfzGarbageCollector: private Thread
+{
+public:
+    using Buffer = std::shared_ptr<const SfzSampleBuffer>;
+
+    SfzGarbageCollector()
+    : Thread("Sfz garbage collector")
+    {
+        startThread(2);
+    }
+
+    ~SfzGarbageCollector()
+    {
+        stopThread(-1);
+        collectGarbage();
+    }
+
+    // Real-time safe unless the queue is full; the buffer is always reset
+    void collect(Buffer& buffer) noexcept
+    {
+        if (buffer == nullptr)
+            return;
+
+        numPending++;
+        if (queue.tryPush(std::move(buffer)))
+            return;
+
+        numPending--;
+        numDroppedInPlace++;
+        buffer.reset();
+    }
+
+    // Drops the buffers handed over so far; this is what the collector thread runs
+    void collectGarbage() noexcept
+    {
+        Buffer buffer;
+        while (queue.tryPop(buffer))
+        {
+            // Other owners (the file pool, the sample cache, other voices) keep the buffer alive
+            if (buffer.use_count() == 1)
+            {
+                reclaimedBytes += buffer->getSizeInBytes();
+                numReclaimedBuffers++;
+            }
+            buffer.reset();
+            numPending--;
+        }
+    }
+
+    // Bytes freed on the collector thread instead of the thread that let go of them
+    size_t getReclaimedBytes() const noexcept { return reclaimedBytes.load(); }
+    int64 getNumReclaimedBuffers() const noexcept { return numReclaimedBuffers.load(); }
+    int64 getNumDroppedInPlace() const noexcept { return numDroppedInPlace.load(); }
+    int getNumPending() const noexcept { return numPending.load(); }
+private:
+    void run() override
+    {
+        while (!threadShouldExit())
+        {
+            collectGarbage();
+            wait(config::garbageCollectionInterval);
+        }
+    }
+
+    SfzLockFreeQueue<Buffer> queue { config::garbageQueueSize };
+    std::atomic<size_t> reclaimedBytes { 0 };
+    std::atomic<int64> numReclaimedBuffers { 0 };
+    std::atomic<int64> numDroppedInPlace { 0 };
+    std::atomic<int> numPending { 0 };
+};
@@ -35,10 +35,22 @@ namespace config
     inline constexpr double defaultSampleRate { 48000 };
     inline constexpr int defaultSamplesPerBlock { 1024 };
     inline constexpr int preloadSize { 32768 };
+    inline constexpr int streamBufferSize { 65536 }; // Frames per voice, has to be a power of 2
+    inline constexpr int streamChunkSize { 16384 };
+    inline constexpr size_t sampleCacheBudget { 256 * 1024 * 1024 };
+    inline constexpr size_t maxCachedSampleSize { 16 * 1024 * 1024 }; // Bigger samples are always streamed
     inline constexpr int numChannels { 2 };
     inline constexpr int numVoices { 64 };
+    inline constexpr int voiceHeadroom { 16 }; // Extra voices to fade out the stolen ones
     inline constexpr int maxGroups { 32 };
     inline constexpr int numLoadingThreads { 4 };
+    inline constexpr size_t maxBackgroundJobs { 1024 }; // Voices that can wait for the background loader at once
+    inline constexpr size_t garbageQueueSize { 4096 };
+    inline constexpr int garbageCollectionInterval { 50 }; // Milliseconds
+    inline constexpr int instrumentLoaderInterval { 50 }; // Milliseconds
+    inline constexpr int parallelRenderThreshold { 16 }; // Fewer active voices are rendered on the audio thread only
+    inline constexpr int renderSpinCount { 4096 }; // Polls before a render worker parks
+    inline constexpr int voicesPerBatch { 4 }; // Oversampled voices decimated together, at least
     inline constexpr int midiFeedbackCapacity { numVoices };
     inline constexpr int centPerSemitone { 100 };
     inline constexpr int loopCrossfadeLength { 64 };
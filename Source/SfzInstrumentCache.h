@@ -0,0 +1,290 @@
+/*
+    ==============================================================================
+
+    Copyright 2019 - Paul Ferrand (paulfd@outlook.fr)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    ==============================================================================
+*/
+
+#pragma once
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "SfzGlobals.h"
+#include "SfzOpcode.h"
+#include "SfzFilePool.h"
+#include <cstring>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+/**
+ * Binary writer for the instrument cache. Values are stored in native byte order
+ * since the cache never leaves the machine that wrote it.
+ */
+class SfzCacheWriter
+{
+public:
+    template<class T>
+    void write(T value)
+    {
+        static_assert(std::is_trivially_copyable<T>::value);
+        stream.write(&value, sizeof(T));
+    }
+
+    void writeString(std::string_view s)
+    {
+        write(static_cast<uint32_t>(s.size()));
+        stream.write(s.data(), s.size());
+    }
+
+    void writeJuceString(const String& s) { writeString(s.toStdString()); }
+
+    // The parameter is appended back to the opcode so that the SfzOpcode is rebuilt identically
+    void writeOpcode(const SfzOpcode& opcode)
+    {
+        std::string opcodeText { opcode.opcode };
+        if (opcode.parameter)
+            opcodeText += std::to_string(*opcode.parameter);
+        writeString(opcodeText);
+        writeString(opcode.value);
+    }
+
+    void writeMetadata(const std::optional<SfzSampleMetadata>& metadata)
+    {
+        write<uint8_t>(metadata ? 1 : 0);
+        if (!metadata)
+            return;
+
+        write(metadata->sampleRate);
+        write<int64_t>(metadata->lengthInSamples);
+        write<int32_t>(metadata->numChannels);
+        write<uint8_t>(static_cast<uint8_t>(metadata->format));
+        write<uint8_t>(metadata->loopRange ? 1 : 0);
+        if (metadata->loopRange)
+        {
+            write(metadata->loopRange->getStart());
+            write(metadata->loopRange->getEnd());
+        }
+    }
+
+    void writeDependency(const File& file)
+    {
+        writeJuceString(file.getFullPathName());
+        write<int64_t>(file.getLastModificationTime().toMilliseconds());
+        write<int64_t>(file.getSize());
+    }
+
+    void writeBlock(const SfzCacheWriter& other)
+    {
+        stream.write(other.getData(), other.getSize());
+    }
+
+    const void* getData() const { return stream.getData(); }
+    size_t getSize() const { return stream.getDataSize(); }
+private:
+    MemoryOutputStream stream;
+};
+
+/**
+ * Reader over a memory-mapped cache file. Strings are returned as views in the
+ * mapped data, so the mapping has to outlive them. Any out-of-bounds read flags
+ * the reader as failed and returns default values from then on.
+ */
+class SfzCacheReader
+{
+public:
+    SfzCacheReader(const void* data, size_t size)
+    : data(static_cast<const char*>(data)), size(data != nullptr ? size : 0) { }
+
+    template<class T>
+    T read()
+    {
+        static_assert(std::is_trivially_copyable<T>::value);
+        T value {};
+        if (failed || position + sizeof(T) > size)
+        {
+            failed = true;
+            return value;
+        }
+
+        std::memcpy(&value, data + position, sizeof(T));
+        position += sizeof(T);
+        return value;
+    }
+
+    std::string_view readString()
+    {
+        const auto length = read<uint32_t>();
+        if (failed || position + length > size)
+        {
+            failed = true;
+            return {};
+        }
+
+        std::string_view returnedView { data + position, length };
+        position += length;
+        return returnedView;
+    }
+
+    String readJuceString()
+    {
+        const auto view = readString();
+        return String(view.data(), view.size());
+    }
+
+    std::optional<SfzSampleMetadata> readMetadata()
+    {
+        if (read<uint8_t>() == 0)
+            return {};
+
+        SfzSampleMetadata metadata;
+        metadata.sampleRate = read<double>();
+        metadata.lengthInSamples = read<int64_t>();
+        metadata.numChannels = read<int32_t>();
+        const auto format = read<uint8_t>();
+        if (format > static_cast<uint8_t>(SfzSampleFormat::float32))
+            failed = true;
+        else
+            metadata.format = static_cast<SfzSampleFormat>(format);
+        if (read<uint8_t>() != 0)
+        {
+            const auto loopStart = read<uint32_t>();
+            const auto loopEnd = read<uint32_t>();
+            metadata.loopRange = Range<uint32_t>(loopStart, loopEnd);
+        }
+        return metadata;
+    }
+
+    // Checks that a dependency did not change on disk since the cache was written
+    bool readAndCheckDependency()
+    {
+        const File file { readJuceString() };
+        const auto modificationTime = read<int64_t>();
+        const auto fileSize = read<int64_t>();
+        if (failed)
+            return false;
+
+        return file.getLastModificationTime().toMilliseconds() == modificationTime
+            && file.getSize() == fileSize;
+    }
+
+    bool hasFailed() const noexcept { return failed; }
+private:
+    const char* data;
+    size_t size;
+    size_t position { 0 };
+    bool failed { false };
+};
+
+namespace SfzInstrumentCache
+{
+    inline constexpr uint32_t magicNumber { 0x435a4653 }; // "SFZC"
+    // Bump this whenever the layout of the cache or the meaning of an opcode changes
+    inline constexpr uint32_t version { 2 };
+    inline constexpr const char* extension { ".sfzcache" };
+    inline constexpr uint32_t indexMagicNumber { 0x495a4653 }; // "SFZI"
+    inline constexpr const char* indexExtension { ".sfzindex" };
+
+    inline File getCacheFileFor(const File& cacheDirectory, const File& sfzFile)
+    {
+        const auto fileHash = String::toHexString(sfzFile.getFullPathName().hashCode64());
+        return cacheDirectory.getChildFile(sfzFile.getFileNameWithoutExtension() + "-" + fileHash + extension);
+    }
+
+    // One sample index per sample directory, shared by all the instruments using it
+    inline File getSampleIndexFileFor(const File& cacheDirectory, const File& sampleDirectory)
+    {
+        const auto directoryHash = String::toHexString(sampleDirectory.getFullPathName().hashCode64());
+        return cacheDirectory.getChildFile(sampleDirectory.getFileName() + "-" + directoryHash + indexExtension);
+    }
+
+    /*
+     * Sample index layout, all values in native byte order:
+     * - magic number and version
+     * - for each sample: full path, modification time, file size and metadata
+     *
+     * The entries are not checked here; the file pool discards the stale ones when they are looked up.
+     */
+    inline bool readSampleIndex(const File& indexFile, SfzFilePool& filePool)
+    {
+        if (!indexFile.existsAsFile())
+            return false;
+
+        MemoryMappedFile mappedFile { indexFile, MemoryMappedFile::readOnly };
+        SfzCacheReader reader { mappedFile.getData(), mappedFile.getSize() };
+        if (reader.read<uint32_t>() != indexMagicNumber || reader.read<uint32_t>() != version)
+            return false;
+
+        const auto numEntries = reader.read<uint32_t>();
+        for (uint32_t entryIdx = 0; entryIdx < numEntries && !reader.hasFailed(); ++entryIdx)
+        {
+            const auto path = reader.readJuceString();
+            SfzSampleIndexEntry entry;
+            entry.modificationTime = reader.read<int64_t>();
+            entry.fileSize = reader.read<int64_t>();
+            const auto metadata = reader.readMetadata();
+            if (reader.hasFailed() || !metadata)
+                break;
+
+            entry.metadata = *metadata;
+            filePool.addToIndex(path, entry);
+        }
+
+        if (reader.hasFailed())
+            DBG("The sample index " << indexFile.getFullPathName() << " is corrupted");
+
+        // Reading the index does not need it written back
+        filePool.setIndexSaved();
+        return !reader.hasFailed();
+    }
+
+    // Only rewrites the index if samples were added to it since it was last read or written
+    inline void writeSampleIndex(const File& indexFile, SfzFilePool& filePool)
+    {
+        if (!filePool.isIndexModified())
+            return;
+
+        // The pool may have indexed samples from other directories for a previous instrument
+        const auto sampleDirectory = filePool.getRootDirectory();
+        std::vector<std::pair<String, SfzSampleIndexEntry>> entries;
+        for (auto& [path, entry]: filePool.getMetadataIndex())
+        {
+            if (File(path).isAChildOf(sampleDirectory))
+                entries.emplace_back(path, entry);
+        }
+
+        SfzCacheWriter writer;
+        writer.write(indexMagicNumber);
+        writer.write(version);
+        writer.write(static_cast<uint32_t>(entries.size()));
+        for (auto& [path, entry]: entries)
+        {
+            writer.writeJuceString(path);
+            writer.write<int64_t>(entry.modificationTime);
+            writer.write<int64_t>(entry.fileSize);
+            writer.writeMetadata(entry.metadata);
+        }
+
+        if (!indexFile.getParentDirectory().createDirectory() || !indexFile.replaceWithData(writer.getData(), writer.getSize()))
+        {
+            DBG("Could not write the sample index " << indexFile.getFullPathName());
+            return;
+        }
+        filePool.setIndexSaved();
+    }
+}
@@ -0,0 +1,193 @@
+/*
+    ==============================================================================
+
+    Copyright 2019 - Paul Ferrand (paulfd@outlook.fr)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    ==============================================================================
+*/
+
+
+#pragma once
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "SfzGlobals.h"
+#include "SfzSynth.h"
+#include <atomic>
+#include <functional>
+#include <memory>
+
+/**
+ * Loads instruments into fresh synths on a background thread and hands them over to the
+ * audio thread without ever blocking it.
+ *
+ * A loaded synth is prepared and then published through an atomic pointer. The audio
+ * thread picks it up at the start of a block, releases the notes of the previous synth
+ * and keeps rendering it until its voices are done; it is then handed back through
+ * another atomic pointer and deleted on the loading thread. A load requested while
+ * another one is still waiting to be picked up replaces it.
+ *
+ * The audio thread calls beginBlock(), sends the MIDI to getActiveSynth(), renders both
+ * getActiveSynth() and getFadingSynth() if any, and calls endBlock(). The other threads
+ * only see the latest loaded synth through withLatestSynth().
+ */
+class SfzInstrumentLoader: private Thread, public ChangeBroadcaster
+{
+public:
+    using Configuration = std::function<void(SfzSynth&)>;
+
+    // The configuration is applied to every new synth before it loads its instrument
+    SfzInstrumentLoader(Configuration configure = {})
+    : Thread("Sfz instrument loader"), configure(std::move(configure))
+    {
+        activeSynth = createSynth().release();
+        latestSynth = activeSynth;
+        startThread();
+    }
+
+    ~SfzInstrumentLoader()
+    {
+        stopThread(-1);
+        delete activeSynth;
+        delete fadingSynth;
+        delete pendingSynth.exchange(nullptr);
+        delete retiredSynth.exchange(nullptr);
+    }
+
+    // Any thread; the latest request wins
+    void load(const File& sfzFile)
+    {
+        {
+            const ScopedLock lock { requestLock };
+            requestedFile = sfzFile;
+            hasRequest = true;
+        }
+        notify();
+    }
+
+    // Only while the audio thread is stopped
+    void prepareToPlay(double newSampleRate, int newSamplesPerBlock)
+    {
+        const ScopedLock lock { synthLock };
+        sampleRate = newSampleRate;
+        samplesPerBlock = newSamplesPerBlock;
+        for (auto* synth: { activeSynth, fadingSynth, pendingSynth.load() })
+        {
+            if (synth != nullptr)
+                synth->prepareToPlay(sampleRate, samplesPerBlock);
+        }
+    }
+
+    // Runs a function on the latest loaded synth, which cannot be deleted meanwhile
+    template<class F>
+    auto withLatestSynth(F&& function) const
+    {
+        const ScopedLock lock { synthLock };
+        return function(static_cast<const SfzSynth&>(*latestSynth));
+    }
+
+    // Audio thread
+    void beginBlock() noexcept
+    {
+        // Wait for the previous synth to be gone before switching again
+        if (fadingSynth != nullptr)
+            return;
+
+        if (auto* newSynth = pendingSynth.exchange(nullptr))
+        {
+            fadingSynth = activeSynth;
+            fadingSynth->releaseAllVoices(0);
+            activeSynth = newSynth;
+        }
+    }
+
+    SfzSynth& getActiveSynth() noexcept { return *activeSynth; }
+    SfzSynth* getFadingSynth() noexcept { return fadingSynth; }
+
+    void endBlock() noexcept
+    {
+        if (fadingSynth == nullptr || fadingSynth->getNumActiveVoices() > 0)
+            return;
+
+        // The slot is only taken if the loading thread did not delete the previous one yet
+        SfzSynth* expected { nullptr };
+        if (retiredSynth.compare_exchange_strong(expected, fadingSynth))
+            fadingSynth = nullptr;
+    }
+
+private:
+    std::unique_ptr<SfzSynth> createSynth()
+    {
+        auto synth = std::make_unique<SfzSynth>();
+        if (configure)
+            configure(*synth);
+        return synth;
+    }
+
+    void run() override
+    {
+        while (!threadShouldExit())
+        {
+            delete retiredSynth.exchange(nullptr);
+
+            File sfzFile;
+            {
+                const ScopedLock lock { requestLock };
+                if (hasRequest)
+                    sfzFile = requestedFile;
+                hasRequest = false;
+            }
+
+            if (sfzFile != File())
+                loadAndPublish(sfzFile);
+
+            wait(config::instrumentLoaderInterval);
+        }
+    }
+
+    void loadAndPublish(const File& sfzFile)
+    {
+        auto newSynth = createSynth();
+        if (!newSynth->loadSfzFile(sfzFile.getFullPathName().toStdString()))
+            DBG("Could not load " << sfzFile.getFullPathName());
+
+        std::unique_ptr<SfzSynth> replacedSynth;
+        {
+            const ScopedLock lock { synthLock };
+            newSynth->prepareToPlay(sampleRate, samplesPerBlock);
+            latestSynth = newSynth.get();
+            // A synth the audio thread did not pick up yet was never used and can go away
+            replacedSynth.reset(pendingSynth.exchange(newSynth.release()));
+        }
+        replacedSynth.reset();
+        sendChangeMessage();
+    }
+
+    Configuration configure;
+    CriticalSection requestLock;
+    File requestedFile;
+    bool hasRequest { false };
+
+    // Guards the latest synth and the playback settings, never taken by the audio thread
+    CriticalSection synthLock;
+    double sampleRate { config::defaultSampleRate };
+    int samplesPerBlock { config::defaultSamplesPerBlock };
+    SfzSynth* latestSynth { nullptr };
+
+    // Owned by the audio thread while playing
+    SfzSynth* activeSynth { nullptr };
+    SfzSynth* fadingSynth { nullptr };
+    std::atomic<SfzSynth*> pendingSynth { nullptr };
+    std::atomic<SfzSynth*> retiredSynth { nullptr };
+};
@@ -0,0 +1,260 @@
+/*
+    ==============================================================================
+
+    Copyright 2019 - Paul Ferrand (paulfd@outlook.fr)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    ==============================================================================
+*/
+
+
+#pragma once
+#include "SfzSIMD.h"
+#include "SfzSampleBuffer.h"
+#include "SfzSimdDispatch.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+
+/**
+ * Linear interpolation kernels for sample playback.
+ *
+ * A playback position is an integer frame index and a fraction in [0, 1). The kernels work
+ * on contiguous runs of source frames: the caller splits a block at loop points, sample ends
+ * or buffer wraps with framesInRun() and handles the boundary frames on its own, so that the
+ * inner loops do not branch. Output frame k reads the source at
+ * index + fraction + k * step, which is the same position whatever the run length.
+ * The sources can be float, 16 bit or 24 bit samples, which are converted to float as they are read.
+ */
+namespace SfzInterpolation
+{
+    // The integer part of fraction + frame * step, computed the same way by every kernel
+    inline int offsetAt(float fraction, float step, int frame) noexcept
+    {
+        return static_cast<int>(fraction + static_cast<float>(frame) * step);
+    }
+
+    /**
+     * Number of output frames that only read source frames up to lastIndex (included),
+     * starting from index and fraction. One frame of margin is kept so that a rounding
+     * difference between the vector and scalar paths can never read past lastIndex.
+     */
+    inline int framesInRun(int index, float fraction, float step, int lastIndex, int maxFrames) noexcept
+    {
+        // Frame k reads index + offsetAt(k) and the next one
+        const auto room = static_cast<float>(lastIndex - index - 1) - fraction;
+        if (room <= 0.0f || step <= 0.0f)
+            return 0;
+
+        auto numFrames = static_cast<int>(std::min(std::ceil(room / step), static_cast<float>(maxFrames)));
+        while (numFrames > 0 && index + offsetAt(fraction, step, numFrames - 1) + 2 > lastIndex)
+            numFrames--;
+        return numFrames;
+    }
+
+    // Moves the playback position forward by a number of output frames
+    template<class Index>
+    inline void advance(Index& index, float& fraction, float step, int numFrames) noexcept
+    {
+        const float position = fraction + static_cast<float>(numFrames) * step;
+        const int wholeFrames = static_cast<int>(position);
+        index += wholeFrames;
+        fraction = position - static_cast<float>(wholeFrames);
+    }
+
+#if SFZ_HAVE_SSE
+    // Reads in[offsets[lane] + shift] for the 4 lanes, converting integer samples with a single conversion
+    template<class T>
+    inline __m128 gather(const T* in, const int32_t* offsets, int shift) noexcept
+    {
+        if constexpr (std::is_same<T, float>::value)
+        {
+            return _mm_set_ps(in[offsets[3] + shift], in[offsets[2] + shift], in[offsets[1] + shift], in[offsets[0] + shift]);
+        }
+        else
+        {
+            using Traits = SfzSampleTraits<T>;
+            const __m128i integers = _mm_set_epi32(Traits::toInt(in[offsets[3] + shift]), Traits::toInt(in[offsets[2] + shift]),
+                                                   Traits::toInt(in[offsets[1] + shift]), Traits::toInt(in[offsets[0] + shift]));
+            return _mm_mul_ps(_mm_cvtepi32_ps(integers), _mm_set1_ps(Traits::scale));
+        }
+    }
+#elif SFZ_HAVE_NEON
+    template<class T>
+    inline float32x4_t gather(const T* in, const int32_t* offsets, int shift) noexcept
+    {
+        if constexpr (std::is_same<T, float>::value)
+        {
+            alignas(16) float values[4];
+            for (int lane = 0; lane < 4; ++lane)
+                values[lane] = in[offsets[lane] + shift];
+            return vld1q_f32(values);
+        }
+        else
+        {
+            using Traits = SfzSampleTraits<T>;
+            alignas(16) int32_t integers[4];
+            for (int lane = 0; lane < 4; ++lane)
+                integers[lane] = Traits::toInt(in[offsets[lane] + shift]);
+            return vmulq_n_f32(vcvtq_f32_s32(vld1q_s32(integers)), Traits::scale);
+        }
+    }
+#endif
+
+    /**
+     * Baseline kernel of linear(), for the instruction set the code is compiled for.
+     * The wider kernels of SfzSimdDispatch compute the positions and weights the same way,
+     * so that every instruction set renders the same samples. Like them, it is kept free of
+     * fused multiply-adds even when the build enables FMA.
+     */
+#if defined(__GNUC__) && !defined(__clang__)
+    #pragma GCC push_options
+    #pragma GCC optimize("fp-contract=off")
+#endif
+    template<class T>
+    inline void linearKernel(const T* const* source, float* const* output, int numChannels, int index, float fraction, float step, int numFrames) noexcept
+    {
+#if defined(__clang__)
+        #pragma clang fp contract(off)
+#endif
+        using Traits = SfzSampleTraits<T>;
+        int frame = 0;
+#if SFZ_HAVE_SSE
+        const __m128 fractionVector = _mm_set1_ps(fraction);
+        const __m128 stepVector = _mm_set1_ps(step);
+        const __m128 ramp = _mm_set_ps(3.0f, 2.0f, 1.0f, 0.0f);
+        alignas(16) int32_t offsets[4];
+        for (; frame + 4 <= numFrames; frame += 4)
+        {
+            const __m128 frames = _mm_add_ps(_mm_set1_ps(static_cast<float>(frame)), ramp);
+            const __m128 position = _mm_add_ps(fractionVector, _mm_mul_ps(frames, stepVector));
+            const __m128i wholeFrames = _mm_cvttps_epi32(position);
+            const __m128 weights = _mm_sub_ps(position, _mm_cvtepi32_ps(wholeFrames));
+            _mm_store_si128(reinterpret_cast<__m128i*>(offsets), wholeFrames);
+
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                const T* in = source[channel] + index;
+                const __m128 current = gather(in, offsets, 0);
+                const __m128 next = gather(in, offsets, 1);
+                _mm_storeu_ps(output[channel] + frame, _mm_add_ps(current, _mm_mul_ps(weights, _mm_sub_ps(next, current))));
+            }
+        }
+#elif SFZ_HAVE_NEON
+        const float32x4_t fractionVector = vdupq_n_f32(fraction);
+        const float32x4_t stepVector = vdupq_n_f32(step);
+        alignas(16) const float rampValues[4] { 0.0f, 1.0f, 2.0f, 3.0f };
+        const float32x4_t ramp = vld1q_f32(rampValues);
+        alignas(16) int32_t offsets[4];
+        for (; frame + 4 <= numFrames; frame += 4)
+        {
+            const float32x4_t frames = vaddq_f32(vdupq_n_f32(static_cast<float>(frame)), ramp);
+            const float32x4_t position = vaddq_f32(fractionVector, vmulq_f32(frames, stepVector));
+            const int32x4_t wholeFrames = vcvtq_s32_f32(position);
+            const float32x4_t weights = vsubq_f32(position, vcvtq_f32_s32(wholeFrames));
+            vst1q_s32(offsets, wholeFrames);
+
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                const T* in = source[channel] + index;
+                const float32x4_t currentVector = gather(in, offsets, 0);
+                const float32x4_t nextVector = gather(in, offsets, 1);
+                vst1q_f32(output[channel] + frame, vmlaq_f32(currentVector, weights, vsubq_f32(nextVector, currentVector)));
+            }
+        }
+#endif
+        for (; frame < numFrames; ++frame)
+        {
+            const float position = fraction + static_cast<float>(frame) * step;
+            const int offset = static_cast<int>(position);
+            const float weight = position - static_cast<float>(offset);
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                const T* in = source[channel] + index + offset;
+                const float current = Traits::toFloat(in[0]);
+                output[channel][frame] = current + weight * (Traits::toFloat(in[1]) - current);
+            }
+        }
+    }
+#if defined(__GNUC__) && !defined(__clang__)
+    #pragma GCC pop_options
+#endif
+
+    /**
+     * Linear interpolation of numFrames frames on numChannels channels, starting at
+     * source[channel][index] with the given fraction. Every source frame read has to be valid;
+     * use framesInRun() to find how many output frames are safe.
+     * Runs the widest kernel that the CPU supports.
+     */
+    template<class T>
+    inline void linear(const T* const* source, float* const* output, int numChannels, int index, float fraction, float step, int numFrames) noexcept
+    {
+        const auto& kernels = SfzSimd::getKernels();
+        if constexpr (std::is_same<T, float>::value)
+            kernels.linearFloat(source, output, numChannels, index, fraction, step, numFrames);
+        else if constexpr (std::is_same<T, int16_t>::value)
+            kernels.linearInt16(source, output, numChannels, index, fraction, step, numFrames);
+        else
+            kernels.linearInt24(source, output, numChannels, index, fraction, step, numFrames);
+    }
+
+    /**
+     * Playback at unit speed with a zero fraction: output frame k is source frame index + k,
+     * so the samples are copied, or converted for integer formats, without interpolating.
+     * Only the frames up to index + numFrames - 1 are read.
+     */
+    template<class T>
+    inline void copy(const T* const* source, float* const* output, int numChannels, int index, int numFrames) noexcept
+    {
+        for (int channel = 0; channel < numChannels; ++channel)
+        {
+            const T* in = source[channel] + index;
+            if constexpr (std::is_same<T, float>::value)
+            {
+                std::copy(in, in + numFrames, output[channel]);
+            }
+            else
+            {
+                for (int frame = 0; frame < numFrames; ++frame)
+                    output[channel][frame] = SfzSampleTraits<T>::toFloat(in[frame]);
+            }
+        }
+    }
+
+    // Same as above, reading the channels of a sample buffer in its own format
+    inline void linear(const SfzSampleBuffer& source, float* const* output, int numChannels, int index, float fraction, float step, int numFrames) noexcept
+    {
+        SfzSampleBuffer::withSampleType(source.getFormat(), [&](auto sampleType) {
+            using T = decltype(sampleType);
+            const T* channels[SfzSampleBuffer::maxChannels];
+            for (int channel = 0; channel < numChannels && channel < SfzSampleBuffer::maxChannels; ++channel)
+                channels[channel] = source.getReadPointer<T>(channel);
+            linear(channels, output, std::min(numChannels, SfzSampleBuffer::maxChannels), index, fraction, step, numFrames);
+        });
+    }
+
+    // Same as above, reading the channels of a sample buffer in its own format
+    inline void copy(const SfzSampleBuffer& source, float* const* output, int numChannels, int index, int numFrames) noexcept
+    {
+        SfzSampleBuffer::withSampleType(source.getFormat(), [&](auto sampleType) {
+            using T = decltype(sampleType);
+            const T* channels[SfzSampleBuffer::maxChannels];
+            for (int channel = 0; channel < numChannels && channel < SfzSampleBuffer::maxChannels; ++channel)
+                channels[channel] = source.getReadPointer<T>(channel);
+            copy(channels, output, std::min(numChannels, SfzSampleBuffer::maxChannels), index, numFrames);
+        });
+    }
+}
@@ -0,0 +1,131 @@
+/*
+    ==============================================================================
+
+    Copyright 2019 - Paul Ferrand (paulfd@outlook.fr)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    ==============================================================================
+*/
+
+
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <utility>
+
+/**
+ * Bounded multi-producer multi-consumer queue that never locks nor allocates after
+ * construction (Dmitry Vyukov's design). Each cell carries a sequence number telling
+ * producers and consumers whether it is theirs to fill or to empty; a full queue makes
+ * tryPush fail instead of waiting.
+ */
+template<class T>
+class SfzLockFreeQueue
+{
+public:
+    explicit SfzLockFreeQueue(size_t minimumCapacity)
+    : capacity(roundToPowerOfTwo(minimumCapacity)), mask(capacity - 1), cells(std::make_unique<Cell[]>(capacity))
+    {
+        for (size_t cellIdx = 0; cellIdx < capacity; ++cellIdx)
+            cells[cellIdx].sequence.store(cellIdx, std::memory_order_relaxed);
+    }
+
+    bool tryPush(const T& value) noexcept { return push(value); }
+    // The value is only moved from if the push succeeds
+    bool tryPush(T&& value) noexcept { return push(std::move(value)); }
+
+    // The value is moved out so that the queue does not keep a copy
+    bool tryPop(T& value) noexcept
+    {
+        auto position = dequeuePosition.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            auto& cell = cells[position & mask];
+            const auto sequence = cell.sequence.load(std::memory_order_acquire);
+            const auto difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+            if (difference == 0)
+            {
+                if (dequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    value = std::move(cell.value);
+                    cell.sequence.store(position + capacity, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (difference < 0)
+            {
+                return false;
+            }
+            else
+            {
+                position = dequeuePosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    size_t getCapacity() const noexcept { return capacity; }
+private:
+    template<class U>
+    bool push(U&& value) noexcept
+    {
+        auto position = enqueuePosition.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            auto& cell = cells[position & mask];
+            const auto sequence = cell.sequence.load(std::memory_order_acquire);
+            const auto difference = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+            if (difference == 0)
+            {
+                if (enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                {
+                    cell.value = std::forward<U>(value);
+                    cell.sequence.store(position + 1, std::memory_order_release);
+                    return true;
+                }
+            }
+            else if (difference < 0)
+            {
+                return false;
+            }
+            else
+            {
+                position = enqueuePosition.load(std::memory_order_relaxed);
+            }
+        }
+    }
+
+    struct Cell
+    {
+        std::atomic<size_t> sequence { 0 };
+        T value {};
+    };
+
+    static size_t roundToPowerOfTwo(size_t value) noexcept
+    {
+        size_t powerOfTwo { 1 };
+        while (powerOfTwo < value)
+            powerOfTwo <<= 1;
+        return powerOfTwo;
+    }
+
+    const size_t capacity;
+    const size_t mask;
+    std::unique_ptr<Cell[]> cells;
+    // Producers and consumers contend on different cache lines
+    alignas(64) std::atomic<size_t> enqueuePosition { 0 };
+    alignas(64) std::atomic<size_t> dequeuePosition { 0 };
+};
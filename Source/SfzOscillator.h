@@ -0,0 +1,188 @@
+/*
+    ==============================================================================
+
+    Copyright 2019 - Paul Ferrand (paulfd@outlook.fr)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    ==============================================================================
+*/
+
+
+
+#pragma once
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+#include <string_view>
+
+// Waveforms of the generator samples, e.g. sample=*saw
+enum class SfzWaveform { silence, sine, saw, square, triangle, noise };
+
+/**
+ * Oscillator for the generator samples, rendered a block at a time.
+ *
+ * The phase is a double in [0, 1) so that long notes keep their pitch. The sine reads a shared
+ * table, while the saw, square and triangle are naive waveforms with polyBLEP/polyBLAMP
+ * corrections around their discontinuities to keep the aliasing down. The noise is white.
+ */
+class SfzOscillator
+{
+public:
+    // Returns the waveform for a generator sample name, or silence if it is not known
+    static SfzWaveform waveformFromName(std::string_view name) noexcept
+    {
+        if (name == "*sine")
+            return SfzWaveform::sine;
+        if (name == "*saw")
+            return SfzWaveform::saw;
+        if (name == "*square")
+            return SfzWaveform::square;
+        if (name == "*triangle" || name == "*tri")
+            return SfzWaveform::triangle;
+        if (name == "*noise")
+            return SfzWaveform::noise;
+        return SfzWaveform::silence;
+    }
+
+    void prepare(SfzWaveform newWaveform, double frequency, double sampleRate, uint32_t seed = 1) noexcept
+    {
+        waveform = newWaveform;
+        phase = 0.0;
+        // Above Nyquist the corrections do not hold anymore
+        increment = std::clamp(frequency / sampleRate, 0.0, 0.5);
+        noiseState = seed != 0 ? seed : 1;
+    }
+
+    SfzWaveform getWaveform() const noexcept { return waveform; }
+
+    void render(float* output, int numSamples) noexcept
+    {
+        switch (waveform)
+        {
+        case SfzWaveform::sine: renderWith(output, numSamples, [this]() { return sine(); }); break;
+        case SfzWaveform::saw: renderWith(output, numSamples, [this]() { return saw(); }); break;
+        case SfzWaveform::square: renderWith(output, numSamples, [this]() { return square(); }); break;
+        case SfzWaveform::triangle: renderWith(output, numSamples, [this]() { return triangle(); }); break;
+        case SfzWaveform::noise:
+            for (int sampleIdx = 0; sampleIdx < numSamples; ++sampleIdx)
+                output[sampleIdx] = noise();
+            break;
+        case SfzWaveform::silence:
+            std::fill(output, output + numSamples, 0.0f);
+            break;
+        }
+    }
+
+    static constexpr int sineTableSize { 4096 };
+
+private:
+    template<class F>
+    void renderWith(float* output, int numSamples, F&& waveformValue) noexcept
+    {
+        for (int sampleIdx = 0; sampleIdx < numSamples; ++sampleIdx)
+        {
+            output[sampleIdx] = static_cast<float>(waveformValue());
+            phase += increment;
+            if (phase >= 1.0)
+                phase -= 1.0;
+        }
+    }
+
+    static double wrap(double value) noexcept { return value >= 1.0 ? value - 1.0 : value; }
+
+    // Residual of a band-limited step of height 2 at phase 0
+    double blep(double t) const noexcept
+    {
+        if (t < increment)
+        {
+            t /= increment;
+            return t + t - t * t - 1.0;
+        }
+        if (t > 1.0 - increment)
+        {
+            t = (t - 1.0) / increment;
+            return t * t + t + t + 1.0;
+        }
+        return 0.0;
+    }
+
+    // Residual of a band-limited change of slope of one sample at phase 0
+    double blamp(double t) const noexcept
+    {
+        if (t < increment)
+        {
+            t = t / increment - 1.0;
+            return -t * t * t / 3.0;
+        }
+        if (t > 1.0 - increment)
+        {
+            t = (t - 1.0) / increment + 1.0;
+            return t * t * t / 3.0;
+        }
+        return 0.0;
+    }
+
+    double sine() const noexcept
+    {
+        const auto position = phase * sineTableSize;
+        const auto index = static_cast<int>(position);
+        const auto fraction = static_cast<float>(position - index);
+        const auto current = sineTable[static_cast<size_t>(index)];
+        return current + fraction * (sineTable[static_cast<size_t>(index) + 1] - current);
+    }
+
+    double saw() const noexcept
+    {
+        return 2.0 * phase - 1.0 - blep(phase);
+    }
+
+    double square() const noexcept
+    {
+        const auto value = phase < 0.5 ? 1.0 : -1.0;
+        return value + blep(phase) - blep(wrap(phase + 0.5));
+    }
+
+    double triangle() const noexcept
+    {
+        // Rises from -1 to 1 on the first half period, and the slope changes by 8 per period at the corners
+        const auto value = phase < 0.5 ? 4.0 * phase - 1.0 : 3.0 - 4.0 * phase;
+        const auto slopeChange = 8.0 * increment;
+        return value + slopeChange * (blamp(phase) - blamp(wrap(phase + 0.5)));
+    }
+
+    float noise() noexcept
+    {
+        // xorshift32, mapped to [-1, 1)
+        noiseState ^= noiseState << 13;
+        noiseState ^= noiseState >> 17;
+        noiseState ^= noiseState << 5;
+        return static_cast<float>(static_cast<int32_t>(noiseState)) * (1.0f / 2147483648.0f);
+    }
+
+    // Extra points past a full period so that the interpolation never wraps, even when
+    // the position rounds up to the table size
+    static inline const std::array<float, sineTableSize + 2> sineTable = []() {
+        std::array<float, sineTableSize + 2> table {};
+        for (int index = 0; index < sineTableSize + 2; ++index)
+            table[static_cast<size_t>(index)] = static_cast<float>(std::sin(2.0 * 3.14159265358979323846 * index / sineTableSize));
+        return table;
+    }();
+
+    SfzWaveform waveform { SfzWaveform::silence };
+    double phase { 0.0 };
+    double increment { 0.0 };
+    uint32_t noiseState { 1 };
+};
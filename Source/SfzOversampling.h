@@ -0,0 +1,49 @@
+/*
+    ==============================================================================
+
+    Copyright 2019 - Paul Ferrand (paulfd@outlook.fr)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    ==============================================================================
+*/
+
+
+#pragma once
+
+/**
+ * Voices can render at 2 or 4 times the output rate; SfzVoiceBatch brings them back to the
+ * output rate with the polyphase IIR half-band filters from hiir. A factor of 4 goes through
+ * two 2x stages: the first one only has to protect the band that the second one keeps, so it
+ * needs fewer coefficients.
+ */
+namespace SfzOversampling
+{
+    inline constexpr int maxFactor { 4 };
+    inline constexpr bool isValidFactor(int factor) noexcept { return factor == 1 || factor == 2 || factor == 4; }
+
+    // Designed with hiir::PolyphaseIir2Designer::compute_coefs_spec_order_tbw:
+    // 12 coefficients and a 0.02 transition band for the last stage (123 dB of rejection),
+    // 4 coefficients and a 0.255 transition band for the first stage of a 4x decimation (118 dB)
+    inline constexpr int lastStageOrder { 12 };
+    inline constexpr int firstStageOrder { 4 };
+    inline constexpr double lastStageCoefs[lastStageOrder] {
+        0.027155856726483182, 0.10300238556004077, 0.21303004592041422, 0.33933626891036295,
+        0.46602752012040527, 0.58224701385700428, 0.68259076485235193, 0.76595528238687738,
+        0.83396924102510472, 0.88969265368750716, 0.93680311116581549, 0.97923872973422221
+    };
+    inline constexpr double firstStageCoefs[firstStageOrder] {
+        0.041893991997656171, 0.16890348243995201, 0.39056077292116592, 0.74389574826847815
+    };
+}
@@ -88,6 +88,8 @@ void SfzRegion::parseOpcode(const SfzOpcode& opcode)
                 DBG("Unkown off mode:" << std::string(opcode.value));
         }
         break;
+    case hash("polyphony"): setValueFromOpcode(opcode, polyphony, SfzDefault::polyphonyRange); break;
+    case hash("note_polyphony"): setValueFromOpcode(opcode, notePolyphony, SfzDefault::polyphonyRange); break;
     // Region logic: key mapping
     case hash("lokey"): setRangeStartFromOpcode(opcode, keyRange, SfzDefault::keyRange); break;
     case hash("hikey"): setRangeEndFromOpcode(opcode, keyRange, SfzDefault::keyRange); break;
@@ -438,33 +440,33 @@ void SfzRegion::registerTempo(float secondsPerQuarter)
         bpmSwitched = false;
 }
 
-bool SfzRegion::prepare()
+bool SfzRegion::prepare(std::optional<SfzSampleMetadata> knownMetadata)
 {
     prepared = false;
 
     if (!isGenerator())
     {
-        filePool.preload(sample, offset + offsetRandom);
-        auto reader = filePool.createReaderFor(sample);
-        if (reader == nullptr)
+        sampleMetadata = knownMetadata ? knownMetadata : filePool.getMetadata(sample);
+        if (!sampleMetadata)
         {
             DBG("[Prepare region] Error creating reader for " << sample);
             return false;
         }
+        filePool.preload(sample, offset, offset + offsetRandom, config::preloadSize, sampleMetadata->lengthInSamples);
 
-        sampleRate = reader->sampleRate;
+        sampleRate = sampleMetadata->sampleRate;
         // The file is way too big to be "normal". A sample of 4 GB is a bit over the top, isn't it?
-        jassert(reader->lengthInSamples <= SfzDefault::sampleEndRange.getEnd());
+        jassert(sampleMetadata->lengthInSamples <= SfzDefault::sampleEndRange.getEnd());
         
         if (sampleEnd == SfzDefault::sampleEndRange.getEnd())
-            sampleEnd = static_cast<uint32_t>(reader->lengthInSamples);
-        numChannels = reader->numChannels;
+            sampleEnd = static_cast<uint32_t>(sampleMetadata->lengthInSamples);
+        numChannels = sampleMetadata->numChannels;
 
-        if (reader->metadataValues.containsKey("Loop0Start") && reader->metadataValues.containsKey("Loop0End") && loopRange == SfzDefault::loopRange)
+        if (sampleMetadata->loopRange && loopRange == SfzDefault::loopRange)
         {
-            // DBG("Looping between " << reader->metadataValues["Loop0Start"] << " and " << reader->metadataValues["Loop0End"]);
-            loopRange.setStart(static_cast<uint32_t>(reader->metadataValues["Loop0Start"].getLargeIntValue()));
-            loopRange.setEnd(static_cast<uint32_t>(reader->metadataValues["Loop0End"].getLargeIntValue()));
+            // DBG("Looping between " << sampleMetadata->loopRange->getStart() << " and " << sampleMetadata->loopRange->getEnd());
+            loopRange.setStart(sampleMetadata->loopRange->getStart());
+            loopRange.setEnd(sampleMetadata->loopRange->getEnd());
         }
     }
 
@@ -39,7 +39,7 @@ struct SfzRegion
     SfzRegion(const File& root, SfzFilePool& filePool);
     void parseOpcode(const SfzOpcode& opcode);
     String stringDescription() const noexcept;
-    bool prepare();
+    bool prepare(std::optional<SfzSampleMetadata> knownMetadata = {});
     bool isStereo() const noexcept;
     float velocityGain(uint8_t velocity) const noexcept;
     float getBasePitchVariation(int noteNumber, uint8_t velocity) const noexcept
@@ -140,6 +140,8 @@ struct SfzRegion
     uint32_t group { SfzDefault::group }; // group
     std::optional<uint32_t> offBy {}; // off_by
     SfzOffMode offMode { SfzDefault::offMode }; // off_mode
+    std::optional<uint32_t> polyphony {}; // polyphony, counted over the voices of the region's group
+    std::optional<uint32_t> notePolyphony {}; // note_polyphony, same but for a given note
 
     // Region logic: key mapping
     Range<uint8_t> keyRange{ SfzDefault::keyRange }; //lokey, hikey and key
@@ -209,6 +211,7 @@ struct SfzRegion
     int numChannels { 1 };
 
     std::vector<std::string> unknownOpcodes;
+    std::optional<SfzSampleMetadata> sampleMetadata; // Filled by prepare() for sample-based regions
     std::shared_ptr<AudioBuffer<float>> preloadedData;
 private:
     bool prepared { false };
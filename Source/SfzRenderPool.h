@@ -0,0 +1,292 @@
+/*
+    ==============================================================================
+
+    Copyright 2019 - Paul Ferrand (paulfd@outlook.fr)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    ==============================================================================
+*/
+
+
+#pragma once
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "SfzGlobals.h"
+#include "SfzSIMD.h"
+#include "SfzSemaphore.h"
+#include "SfzSimdDispatch.h"
+#include "SfzVoice.h"
+#include "SfzVoiceBatch.h"
+#include <atomic>
+#include <memory>
+#include <vector>
+
+/**
+ * Spreads the rendering of a block of voices over real-time worker threads.
+ *
+ * The voices, or the batches of voices when they are oversampled, are split in one
+ * contiguous lane per thread, the calling (audio) thread included. Each thread claims the
+ * items of its own lane through an atomic counter and then steals the remaining items of
+ * the other lanes through the same counters, so nothing locks or allocates while rendering.
+ * Every lane renders into its own accumulation buffer and the calling thread sums them once
+ * all the workers are done.
+ *
+ * Idle workers spin for a while waiting for the next block, and then park on a semaphore
+ * until the audio thread posts to it, which does not lock either. A worker joins a block
+ * only while it is open; once every item is claimed the audio thread closes the block and
+ * waits for the workers that joined it, never for the parked ones. Resizing the pool or
+ * preparing it must not happen while a block is being rendered.
+ */
+class SfzRenderPool
+{
+public:
+    SfzRenderPool() { setNumThreads(0); }
+    ~SfzRenderPool() { stopWorkers(); }
+
+    void setNumThreads(int numThreads)
+    {
+        stopWorkers();
+        lanes.clear();
+        // Lane 0 belongs to the calling thread
+        for (int laneIdx = 0; laneIdx <= numThreads; ++laneIdx)
+            lanes.push_back(std::make_unique<Lane>(samplesPerBlock));
+
+        for (int laneIdx = 1; laneIdx <= numThreads; ++laneIdx)
+            workers.push_back(std::make_unique<Worker>(*this, laneIdx));
+
+        for (auto& worker: workers)
+            worker->startThread(10);
+    }
+
+    int getNumThreads() const noexcept { return static_cast<int>(workers.size()); }
+
+    void prepare(int newSamplesPerBlock)
+    {
+        samplesPerBlock = newSamplesPerBlock;
+        for (auto& lane: lanes)
+            lane->setSize(samplesPerBlock);
+    }
+
+    // Adds the rendering of all the voices to the output buffer
+    void render(const std::vector<SfzVoice*>& voices, AudioBuffer<float>& outputAudio, int startSample, int numSamples) noexcept
+    {
+        renderItems(voices, outputAudio, startSample, numSamples);
+    }
+
+    // Same with batches of oversampled voices; the voices of a batch are rendered by a single thread
+    void render(const std::vector<SfzVoiceBatch*>& batches, AudioBuffer<float>& outputAudio, int startSample, int numSamples) noexcept
+    {
+        renderItems(batches, outputAudio, startSample, numSamples);
+    }
+
+private:
+    struct Lane
+    {
+        Lane(int samplesPerBlock) { setSize(samplesPerBlock); }
+
+        void setSize(int samplesPerBlock)
+        {
+            accumulator.setSize(config::numChannels, samplesPerBlock);
+            voiceBuffer.setSize(config::numChannels, samplesPerBlock);
+        }
+
+        // Own cache line since every thread hammers it when stealing
+        alignas(64) std::atomic<size_t> next { 0 };
+        size_t end { 0 };
+        bool hasRendered { false };
+        AudioBuffer<float> accumulator;
+        AudioBuffer<float> voiceBuffer;
+    };
+
+    // Renders the item at an index of the vector of items of the current block into a lane
+    using ItemRenderer = void (*)(const void* items, size_t index, Lane& lane, int startSample, int numSamples) noexcept;
+
+    template<class Item>
+    static void renderItemAt(const void* items, size_t index, Lane& lane, int startSample, int numSamples) noexcept
+    {
+        renderItem(*(*static_cast<const std::vector<Item*>*>(items))[index], lane, startSample, numSamples);
+    }
+
+    static void renderItem(SfzVoice& voice, Lane& lane, int startSample, int numSamples) noexcept
+    {
+        voice.renderNextBlock(lane.voiceBuffer, startSample, numSamples);
+        const auto& kernels = SfzSimd::getKernels();
+        for (int channelIdx = 0; channelIdx < config::numChannels; ++channelIdx)
+            kernels.add(lane.accumulator.getWritePointer(channelIdx, startSample), lane.voiceBuffer.getReadPointer(channelIdx, startSample), numSamples);
+    }
+
+    static void renderItem(SfzVoiceBatch& batch, Lane& lane, int startSample, int numSamples) noexcept
+    {
+        batch.renderNextBlock(lane.accumulator, lane.voiceBuffer, startSample, numSamples);
+    }
+
+    // Splits the items in lanes, renders them on all the threads and sums the lanes into the output
+    template<class Item>
+    void renderItems(const std::vector<Item*>& items, AudioBuffer<float>& outputAudio, int startSample, int numSamples) noexcept
+    {
+        jassert(startSample + numSamples <= samplesPerBlock);
+        currentItems = &items;
+        currentRenderer = &renderItemAt<Item>;
+        currentStartSample = startSample;
+        currentNumSamples = numSamples;
+
+        const auto numLanes = lanes.size();
+        const auto itemsPerLane = items.size() / numLanes;
+        const auto remainder = items.size() % numLanes;
+        size_t laneStart = 0;
+        for (size_t laneIdx = 0; laneIdx < numLanes; ++laneIdx)
+        {
+            auto& lane = *lanes[laneIdx];
+            const auto laneSize = itemsPerLane + (laneIdx < remainder ? 1 : 0);
+            lane.next.store(laneStart, std::memory_order_relaxed);
+            lane.end = laneStart + laneSize;
+            lane.hasRendered = false;
+            laneStart += laneSize;
+        }
+
+        // Publishes the lanes to the workers
+        const auto blockGeneration = generation.load(std::memory_order_relaxed) + 1;
+        openGeneration.store(blockGeneration);
+        generation.store(blockGeneration);
+        for (auto& worker: workers)
+            worker->wakeUp();
+
+        // Every item is claimed when this returns; late workers stay out once the block is closed
+        renderLanes(0);
+        openGeneration.store(0);
+        for (auto& worker: workers)
+        {
+            while (worker->activeGeneration.load() == blockGeneration)
+                spinPause();
+        }
+
+        for (auto& lane: lanes)
+        {
+            if (!lane->hasRendered)
+                continue;
+
+            const auto& kernels = SfzSimd::getKernels();
+            for (int channelIdx = 0; channelIdx < config::numChannels; ++channelIdx)
+                kernels.add(outputAudio.getWritePointer(channelIdx, startSample), lane->accumulator.getReadPointer(channelIdx, startSample), numSamples);
+        }
+    }
+
+    class Worker: public Thread
+    {
+    public:
+        Worker(SfzRenderPool& pool, int laneIndex)
+        : Thread("Sfz render worker"), pool(pool), laneIndex(laneIndex), seenGeneration(pool.generation.load()) { }
+
+        void wakeUp() noexcept
+        {
+            if (parked.load())
+                wakeUpSignal.post();
+        }
+
+        void stop()
+        {
+            signalThreadShouldExit();
+            wakeUpSignal.post();
+            stopThread(-1);
+        }
+
+        void run() override
+        {
+            while (!threadShouldExit())
+            {
+                if (!waitForBlock())
+                    continue;
+
+                seenGeneration = pool.generation.load(std::memory_order_acquire);
+                // Announced before checking that the block is still open: the audio thread closes
+                // it before looking for the workers to wait for, so one of them sees the other
+                activeGeneration.store(seenGeneration);
+                if (pool.openGeneration.load() == seenGeneration)
+                    pool.renderLanes(laneIndex);
+                activeGeneration.store(0, std::memory_order_release);
+            }
+        }
+
+        // The block the worker is rendering, or 0
+        std::atomic<uint64> activeGeneration { 0 };
+    private:
+        // Returns false if woken up without a new block
+        bool waitForBlock()
+        {
+            for (int spinIdx = 0; spinIdx < config::renderSpinCount; ++spinIdx)
+            {
+                if (pool.generation.load(std::memory_order_acquire) != seenGeneration)
+                    return true;
+                spinPause();
+            }
+
+            // The generation is checked again after raising the flag so that a wake up is never missed
+            parked.store(true);
+            if (pool.generation.load() == seenGeneration && !threadShouldExit())
+                wakeUpSignal.wait();
+            parked.store(false);
+            return pool.generation.load(std::memory_order_acquire) != seenGeneration;
+        }
+
+        SfzRenderPool& pool;
+        const int laneIndex;
+        // Taken at construction so that a block published before the thread starts is not missed
+        uint64 seenGeneration;
+        std::atomic<bool> parked { false };
+        SfzSemaphore wakeUpSignal;
+    };
+
+    void renderLanes(int laneIndex) noexcept
+    {
+        auto& lane = *lanes[laneIndex];
+        const auto numLanes = static_cast<int>(lanes.size());
+        lane.accumulator.clear(currentStartSample, currentNumSamples);
+        // Own lane first, then steal from the others
+        for (int offset = 0; offset < numLanes; ++offset)
+        {
+            auto& victim = *lanes[(laneIndex + offset) % numLanes];
+            for (auto itemIdx = victim.next.fetch_add(1); itemIdx < victim.end; itemIdx = victim.next.fetch_add(1))
+            {
+                currentRenderer(currentItems, itemIdx, lane, currentStartSample, currentNumSamples);
+                lane.hasRendered = true;
+            }
+        }
+    }
+
+    void stopWorkers()
+    {
+        for (auto& worker: workers)
+            worker->stop();
+        workers.clear();
+    }
+
+    static void spinPause() noexcept
+    {
+#if SFZ_HAVE_SSE
+        _mm_pause();
+#endif
+    }
+
+    std::vector<std::unique_ptr<Lane>> lanes;
+    std::vector<std::unique_ptr<Worker>> workers;
+    int samplesPerBlock { config::defaultSamplesPerBlock };
+    std::atomic<uint64> generation { 0 };
+    // The block workers may still join, or 0 once it is closed
+    std::atomic<uint64> openGeneration { 0 };
+    // Written before the generation is bumped, read by the workers after they see it
+    const void* currentItems { nullptr };
+    ItemRenderer currentRenderer { nullptr };
+    int currentStartSample { 0 };
+    int currentNumSamples { 0 };
+};
@@ -0,0 +1,41 @@
+/*
+    ==============================================================================
+
+    Copyright 2019 - Paul Ferrand (paulfd@outlook.fr)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    ==============================================================================
+*/
+
+
+#pragma once
+
+// Compile-time instruction set selection for the hand-vectorized kernels.
+// Every kernel keeps a scalar path for the other targets.
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+    #define SFZ_HAVE_SSE 1
+    #include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+    #define SFZ_HAVE_NEON 1
+    #include <arm_neon.h>
+#endif
+
+#ifndef SFZ_HAVE_SSE
+    #define SFZ_HAVE_SSE 0
+#endif
+
+#ifndef SFZ_HAVE_NEON
+    #define SFZ_HAVE_NEON 0
+#endif
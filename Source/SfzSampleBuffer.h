@@ -0,0 +1,183 @@
+/*
+    ==============================================================================
+
+    Copyright 2019 - Paul Ferrand (paulfd@outlook.fr)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    ==============================================================================
+*/
+
+
+#pragma once
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+enum class SfzSampleFormat { int16, int24, float32 };
+
+// Packed little-endian 24 bit sample, so that 24 bit files take 3 bytes per sample in memory
+struct SfzInt24
+{
+    uint8_t bytes[3];
+
+    int32_t toInt() const noexcept
+    {
+        const auto shifted = (static_cast<uint32_t>(bytes[2]) << 24) | (static_cast<uint32_t>(bytes[1]) << 16) | (static_cast<uint32_t>(bytes[0]) << 8);
+        return static_cast<int32_t>(shifted) >> 8;
+    }
+
+    static SfzInt24 fromInt(int32_t value) noexcept
+    {
+        return { { static_cast<uint8_t>(value), static_cast<uint8_t>(value >> 8), static_cast<uint8_t>(value >> 16) } };
+    }
+};
+
+/**
+ * Storage type of each sample format and its conversion to float. Integer samples convert
+ * through toInt() and scale, which the SIMD kernels use to convert 4 samples at once.
+ */
+template<class T>
+struct SfzSampleTraits;
+
+template<>
+struct SfzSampleTraits<float>
+{
+    static constexpr SfzSampleFormat format { SfzSampleFormat::float32 };
+    static float toFloat(float sample) noexcept { return sample; }
+};
+
+template<>
+struct SfzSampleTraits<int16_t>
+{
+    static constexpr SfzSampleFormat format { SfzSampleFormat::int16 };
+    static constexpr float scale { 1.0f / 32768.0f };
+    static int32_t toInt(int16_t sample) noexcept { return sample; }
+    static float toFloat(int16_t sample) noexcept { return static_cast<float>(sample) * scale; }
+};
+
+template<>
+struct SfzSampleTraits<SfzInt24>
+{
+    static constexpr SfzSampleFormat format { SfzSampleFormat::int24 };
+    static constexpr float scale { 1.0f / 8388608.0f };
+    static int32_t toInt(SfzInt24 sample) noexcept { return sample.toInt(); }
+    static float toFloat(SfzInt24 sample) noexcept { return static_cast<float>(sample.toInt()) * scale; }
+};
+
+/**
+ * Sample data kept in the native width and channel count of the file: 16 and 24 bit files
+ * are stored as integers, everything else as floats, and mono files keep a single channel.
+ * A mono buffer hands out its only channel for any channel index, so it plays on both sides.
+ * Channels are stored one after the other.
+ */
+class SfzSampleBuffer
+{
+public:
+    static constexpr int maxChannels { 2 };
+
+    SfzSampleBuffer(SfzSampleFormat format, int numChannels, int numSamples)
+    : format(format),
+      numChannels(std::min(std::max(numChannels, 1), maxChannels)),
+      numSamples(std::max(numSamples, 0)),
+      data(std::make_unique<char[]>(getSizeInBytes()))
+    { }
+
+    // Calls the function with a value of the storage type of the format, to instantiate it for each type
+    template<class F>
+    static decltype(auto) withSampleType(SfzSampleFormat format, F&& function)
+    {
+        switch (format)
+        {
+        case SfzSampleFormat::int16: return function(int16_t {});
+        case SfzSampleFormat::int24: return function(SfzInt24 {});
+        case SfzSampleFormat::float32: break;
+        }
+        return function(float {});
+    }
+    SfzSampleFormat getFormat() const noexcept { return format; }
+    int getNumChannels() const noexcept { return numChannels; }
+    int getNumSamples() const noexcept { return numSamples; }
+
+    size_t getSizeInBytes() const noexcept
+    {
+        return getSizeInBytes(format, numChannels, numSamples);
+    }
+
+    // Size of a buffer holding these frames, e.g. to check it against a budget before reading them
+    static size_t getSizeInBytes(SfzSampleFormat format, int numChannels, int64_t numSamples) noexcept
+    {
+        const auto storedChannels = std::min(std::max(numChannels, 1), maxChannels);
+        return static_cast<size_t>(storedChannels) * static_cast<size_t>(std::max<int64_t>(numSamples, 0)) * bytesPerSample(format);
+    }
+
+    static size_t bytesPerSample(SfzSampleFormat format) noexcept
+    {
+        switch (format)
+        {
+        case SfzSampleFormat::int16: return sizeof(int16_t);
+        case SfzSampleFormat::int24: return sizeof(SfzInt24);
+        case SfzSampleFormat::float32: break;
+        }
+        return sizeof(float);
+    }
+
+    // T has to match the format of the buffer
+    template<class T>
+    const T* getReadPointer(int channel) const noexcept
+    {
+        return reinterpret_cast<const T*>(data.get() + channelOffset(channel));
+    }
+
+    template<class T>
+    T* getWritePointer(int channel) noexcept
+    {
+        return reinterpret_cast<T*>(data.get() + channelOffset(channel));
+    }
+
+    float getSample(int channel, int index) const noexcept
+    {
+        return withSampleType(format, [&](auto sampleType) {
+            using T = decltype(sampleType);
+            return SfzSampleTraits<T>::toFloat(getReadPointer<T>(channel)[index]);
+        });
+    }
+
+    // Copies all of the other buffer, which has the same format and channel count, at this position
+    void copyFrom(int destStartSample, const SfzSampleBuffer& source) noexcept
+    {
+        const auto sampleSize = bytesPerSample(format);
+        const auto numSamplesToCopy = std::min(source.numSamples, numSamples - destStartSample);
+        if (source.format != format || source.numChannels != numChannels || numSamplesToCopy <= 0)
+            return;
+
+        for (int channel = 0; channel < numChannels; ++channel)
+            std::memcpy(data.get() + channelOffset(channel) + static_cast<size_t>(destStartSample) * sampleSize,
+                        source.data.get() + source.channelOffset(channel), static_cast<size_t>(numSamplesToCopy) * sampleSize);
+    }
+
+private:
+    size_t channelOffset(int channel) const noexcept
+    {
+        return static_cast<size_t>(std::min(channel, numChannels - 1)) * static_cast<size_t>(numSamples) * bytesPerSample(format);
+    }
+
+    SfzSampleFormat format;
+    int numChannels;
+    int numSamples;
+    std::unique_ptr<char[]> data;
+};
@@ -0,0 +1,226 @@
+/*
+    ==============================================================================
+
+    Copyright 2019 - Paul Ferrand (paulfd@outlook.fr)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    ==============================================================================
+*/
+
+#pragma once
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "SfzGlobals.h"
+#include "SfzSampleBuffer.h"
+#include <deque>
+#include <functional>
+#include <map>
+#include <memory>
+#include <optional>
+#include <set>
+
+/**
+ * Process-wide cache of fully decoded samples, shared through a SharedResourcePointer.
+ *
+ * The buffers are immutable once inserted so any number of voices can read them.
+ * When the memory budget is exceeded the least recently used buffers that no voice
+ * holds are evicted; buffers still in use are never evicted so the cache can go
+ * over budget temporarily. Never call this from the audio thread: it locks and
+ * allocates.
+ *
+ * Samples missing from the cache are decoded on its own thread, one request per key at a
+ * time, so that the loading threads asking for them can stream them meanwhile.
+ */
+class SfzSampleCache: private Thread
+{
+public:
+    using DecodedSample = std::shared_ptr<const SfzSampleBuffer>;
+    using Decoder = std::function<DecodedSample()>;
+
+    SfzSampleCache()
+    : Thread("Sfz sample decoder")
+    {
+        startThread();
+    }
+
+    ~SfzSampleCache()
+    {
+        stopThread(-1);
+    }
+
+    DecodedSample get(const String& key, int64 modificationTime)
+    {
+        const ScopedLock lock { entriesLock };
+        const auto entry = entries.find(key);
+        if (entry == entries.end())
+            return {};
+
+        // The file changed on disk since it was decoded
+        if (entry->second.modificationTime != modificationTime)
+        {
+            memoryUsage -= entry->second.size;
+            entries.erase(entry);
+            return {};
+        }
+
+        entry->second.lastUse = ++useCounter;
+        return entry->second.data;
+    }
+
+    // Returns the cached buffer, which may come from another thread that inserted the same key first
+    DecodedSample insert(const String& key, int64 modificationTime, DecodedSample data)
+    {
+        const ScopedLock lock { entriesLock };
+        const auto entry = entries.find(key);
+        if (entry != entries.end() && entry->second.modificationTime == modificationTime)
+        {
+            entry->second.lastUse = ++useCounter;
+            return entry->second.data;
+        }
+
+        if (entry != entries.end())
+        {
+            memoryUsage -= entry->second.size;
+            entries.erase(entry);
+        }
+
+        const auto size = data->getSizeInBytes();
+        evictUnused(size);
+        entries[key] = { data, modificationTime, size, ++useCounter };
+        memoryUsage += size;
+        return data;
+    }
+
+    // Decodes and inserts a sample later, unless it is cached already or a decode of the same key is pending
+    void requestDecode(const String& key, int64 modificationTime, Decoder decode)
+    {
+        {
+            const ScopedLock lock { entriesLock };
+            const auto entry = entries.find(key);
+            if (entry != entries.end() && entry->second.modificationTime == modificationTime)
+                return;
+            if (!decodingKeys.insert(key).second)
+                return;
+
+            pendingDecodes.push_back({ key, modificationTime, std::move(decode) });
+        }
+        notify();
+    }
+
+    // The decodes requested and not inserted yet
+    int getNumPendingDecodes() const
+    {
+        const ScopedLock lock { entriesLock };
+        return static_cast<int>(decodingKeys.size());
+    }
+
+    void setMemoryBudget(size_t newBudget)
+    {
+        const ScopedLock lock { entriesLock };
+        memoryBudget = newBudget;
+        evictUnused(0);
+    }
+
+    size_t getMemoryBudget() const
+    {
+        const ScopedLock lock { entriesLock };
+        return memoryBudget;
+    }
+
+    size_t getMemoryUsage() const
+    {
+        const ScopedLock lock { entriesLock };
+        return memoryUsage;
+    }
+
+    int getNumEntries() const
+    {
+        const ScopedLock lock { entriesLock };
+        return static_cast<int>(entries.size());
+    }
+
+private:
+    struct Entry
+    {
+        DecodedSample data;
+        int64 modificationTime;
+        size_t size;
+        uint64 lastUse;
+    };
+
+    struct PendingDecode
+    {
+        String key;
+        int64 modificationTime;
+        Decoder decode;
+    };
+
+    void run() override
+    {
+        while (!threadShouldExit())
+        {
+            std::optional<PendingDecode> pending;
+            {
+                const ScopedLock lock { entriesLock };
+                if (!pendingDecodes.empty())
+                {
+                    pending = std::move(pendingDecodes.front());
+                    pendingDecodes.pop_front();
+                }
+            }
+
+            if (!pending)
+            {
+                wait(-1);
+                continue;
+            }
+
+            // A failed decode can be requested again
+            if (auto data = pending->decode())
+                insert(pending->key, pending->modificationTime, std::move(data));
+
+            const ScopedLock lock { entriesLock };
+            decodingKeys.erase(pending->key);
+        }
+    }
+
+    // Evict unused entries, oldest first, until there is room for the incoming size
+    void evictUnused(size_t incomingSize)
+    {
+        while (memoryUsage + incomingSize > memoryBudget)
+        {
+            auto oldestUnused = entries.end();
+            for (auto entry = entries.begin(); entry != entries.end(); ++entry)
+            {
+                // The cache holds the only reference: no voice is playing this buffer
+                if (entry->second.data.use_count() == 1 && (oldestUnused == entries.end() || entry->second.lastUse < oldestUnused->second.lastUse))
+                    oldestUnused = entry;
+            }
+
+            if (oldestUnused == entries.end())
+                return;
+
+            memoryUsage -= oldestUnused->second.size;
+            entries.erase(oldestUnused);
+        }
+    }
+
+    CriticalSection entriesLock;
+    std::map<String, Entry> entries;
+    size_t memoryBudget { config::sampleCacheBudget };
+    size_t memoryUsage { 0 };
+    uint64 useCounter { 0 };
+    std::deque<PendingDecode> pendingDecodes;
+    std::set<String> decodingKeys; // Pending or being decoded
+};
@@ -0,0 +1,103 @@
+/*
+    ==============================================================================
+
+    Copyright 2019 - Paul Ferrand (paulfd@outlook.fr)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    ==============================================================================
+*/
+
+
+
+#include "SfzSemaphore.h"
+#if defined(_WIN32)
+    #include <windows.h>
+    #include <climits>
+#else
+    #include <cerrno>
+#endif
+
+#if defined(__APPLE__)
+
+SfzSemaphore::SfzSemaphore()
+: semaphore(dispatch_semaphore_create(0))
+{
+    jassert(semaphore != nullptr);
+}
+
+SfzSemaphore::~SfzSemaphore()
+{
+    dispatch_release(semaphore);
+}
+
+void SfzSemaphore::post() noexcept
+{
+    dispatch_semaphore_signal(semaphore);
+}
+
+void SfzSemaphore::wait() noexcept
+{
+    dispatch_semaphore_wait(semaphore, DISPATCH_TIME_FOREVER);
+}
+
+#elif defined(_WIN32)
+
+SfzSemaphore::SfzSemaphore()
+: semaphore(CreateSemaphoreW(nullptr, 0, LONG_MAX, nullptr))
+{
+    jassert(semaphore != nullptr);
+}
+
+SfzSemaphore::~SfzSemaphore()
+{
+    CloseHandle(semaphore);
+}
+
+void SfzSemaphore::post() noexcept
+{
+    ReleaseSemaphore(semaphore, 1, nullptr);
+}
+
+void SfzSemaphore::wait() noexcept
+{
+    WaitForSingleObject(semaphore, INFINITE);
+}
+
+#else
+
+SfzSemaphore::SfzSemaphore()
+{
+    [[maybe_unused]] const auto result = sem_init(&semaphore, 0, 0);
+    jassert(result == 0);
+}
+
+SfzSemaphore::~SfzSemaphore()
+{
+    sem_destroy(&semaphore);
+}
+
+void SfzSemaphore::post() noexcept
+{
+    sem_post(&semaphore);
+}
+
+void SfzSemaphore::wait() noexcept
+{
+    // Signals interrupt the wait
+    while (sem_wait(&semaphore) != 0 && errno == EINTR)
+        continue;
+}
+
+#endif
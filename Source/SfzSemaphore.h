@@ -0,0 +1,61 @@
+/*
+    ==============================================================================
+
+    Copyright 2019 - Paul Ferrand (paulfd@outlook.fr)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    ==============================================================================
+*/
+
+
+
+
+#pragma once
+#include "../JuceLibraryCode/JuceHeader.h"
+#if defined(__APPLE__)
+    #include <dispatch/dispatch.h>
+#elif !defined(_WIN32)
+    #include <semaphore.h>
+#endif
+
+/**
+ * Counting semaphore that the audio thread can post to.
+ *
+ * JUCE's WaitableEvent takes a mutex when it is signalled. The semaphores of the OS do not
+ * lock in user space when posted: a futex on Linux, a Mach semaphore on Apple platforms, a
+ * kernel object on Windows. Posting never allocates.
+ */
+class SfzSemaphore
+{
+public:
+    SfzSemaphore();
+    ~SfzSemaphore();
+
+    // Real-time safe
+    void post() noexcept;
+    // Blocks until the count is positive, and decrements it
+    void wait() noexcept;
+
+private:
+#if defined(__APPLE__)
+    dispatch_semaphore_t semaphore;
+#elif defined(_WIN32)
+    void* semaphore;
+#else
+    sem_t semaphore;
+#endif
+
+    JUCE_DECLARE_NON_COPYABLE (SfzSemaphore)
+};
@@ -0,0 +1,173 @@
+/*
+    ==============================================================================
+
+    Copyright 2019 - Paul Ferrand (paulfd@outlook.fr)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    ==============================================================================
+*/
+
+
+#include "SfzSimdDispatch.h"
+#if SFZ_HAVE_X86_DISPATCH
+#include <immintrin.h>
+#include <array>
+#include <cassert>
+
+// Everything up to the matching pop is compiled for AVX2, and is only reached through
+// getAvx2Kernels() once SfzSimd::isSupported() agreed. Only code with internal linkage
+// or templates used nowhere else belongs there, so that no AVX2 copy of a shared inline
+// function can be picked by the linker for the rest of the program.
+// The kernels have to match the baseline ones bit for bit so that the output does not depend
+// on the CPU, and a fused multiply-add rounds once where the baseline rounds twice. Contractions
+// are turned off whether FMA comes with the target or from build flags such as -mfma.
+#if defined(__clang__)
+    #pragma clang attribute push (__attribute__((target("avx2"))), apply_to = function)
+    #pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+    #pragma GCC push_options
+    #pragma GCC target("avx2")
+    #pragma GCC optimize("fp-contract=off")
+#endif
+
+#include "hiir/Downsampler2x8Avx.h"
+
+namespace
+{
+    // Reads the samples at the 8 offsets and the ones just after
+    inline void gatherPairs(const float* in, __m256i offsets, __m256& current, __m256& next) noexcept
+    {
+        current = _mm256_i32gather_ps(in, offsets, 4);
+        next = _mm256_i32gather_ps(in + 1, offsets, 4);
+    }
+
+    // A 32 bit gather reads a 16 bit sample and the next one at once
+    inline void gatherPairs(const int16_t* in, __m256i offsets, __m256& current, __m256& next) noexcept
+    {
+        const __m256i pairs = _mm256_i32gather_epi32(reinterpret_cast<const int*>(in), offsets, 2);
+        const __m256 scale = _mm256_set1_ps(SfzSampleTraits<int16_t>::scale);
+        current = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srai_epi32(_mm256_slli_epi32(pairs, 16), 16)), scale);
+        next = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srai_epi32(pairs, 16)), scale);
+    }
+
+    // 24 bit samples are read 4 bytes at a time, from the start of the current sample and from
+    // the last byte of the current sample, so that no byte past the next sample is read
+    inline void gatherPairs(const SfzInt24* in, __m256i offsets, __m256& current, __m256& next) noexcept
+    {
+        const auto bytes = reinterpret_cast<const char*>(in);
+        const __m256i byteOffsets = _mm256_add_epi32(offsets, _mm256_add_epi32(offsets, offsets));
+        const __m256i currentBits = _mm256_i32gather_epi32(reinterpret_cast<const int*>(bytes), byteOffsets, 1);
+        const __m256i nextBits = _mm256_i32gather_epi32(reinterpret_cast<const int*>(bytes + 2), byteOffsets, 1);
+        const __m256 scale = _mm256_set1_ps(SfzSampleTraits<SfzInt24>::scale);
+        current = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srai_epi32(_mm256_slli_epi32(currentBits, 8), 8)), scale);
+        next = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_srai_epi32(nextBits, 8)), scale);
+    }
+
+    // Same computations as SfzInterpolation::linearKernel, 8 frames at a time
+    template<class T>
+    void linear(const T* const* source, float* const* output, int numChannels, int index, float fraction, float step, int numFrames) noexcept
+    {
+        int frame = 0;
+        const __m256 fractionVector = _mm256_set1_ps(fraction);
+        const __m256 stepVector = _mm256_set1_ps(step);
+        const __m256 ramp = _mm256_set_ps(7.0f, 6.0f, 5.0f, 4.0f, 3.0f, 2.0f, 1.0f, 0.0f);
+        for (; frame + 8 <= numFrames; frame += 8)
+        {
+            const __m256 frames = _mm256_add_ps(_mm256_set1_ps(static_cast<float>(frame)), ramp);
+            const __m256 position = _mm256_add_ps(fractionVector, _mm256_mul_ps(frames, stepVector));
+            const __m256i offsets = _mm256_cvttps_epi32(position);
+            const __m256 weights = _mm256_sub_ps(position, _mm256_cvtepi32_ps(offsets));
+
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                __m256 current;
+                __m256 next;
+                gatherPairs(source[channel] + index, offsets, current, next);
+                _mm256_storeu_ps(output[channel] + frame, _mm256_add_ps(current, _mm256_mul_ps(weights, _mm256_sub_ps(next, current))));
+            }
+        }
+
+        using Traits = SfzSampleTraits<T>;
+        for (; frame < numFrames; ++frame)
+        {
+            const float position = fraction + static_cast<float>(frame) * step;
+            const int offset = static_cast<int>(position);
+            const float weight = position - static_cast<float>(offset);
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                const T* in = source[channel] + index + offset;
+                const float current = Traits::toFloat(in[0]);
+                output[channel][frame] = current + weight * (Traits::toFloat(in[1]) - current);
+            }
+        }
+    }
+
+    void add(float* destination, const float* source, int numSamples) noexcept
+    {
+        int sample = 0;
+        for (; sample + 8 <= numSamples; sample += 8)
+            _mm256_storeu_ps(destination + sample, _mm256_add_ps(_mm256_loadu_ps(destination + sample), _mm256_loadu_ps(source + sample)));
+        for (; sample < numSamples; ++sample)
+            destination[sample] += source[sample];
+    }
+
+    void multiply(float* destination, const float* source, int numSamples) noexcept
+    {
+        int sample = 0;
+        for (; sample + 8 <= numSamples; sample += 8)
+            _mm256_storeu_ps(destination + sample, _mm256_mul_ps(_mm256_loadu_ps(destination + sample), _mm256_loadu_ps(source + sample)));
+        for (; sample < numSamples; ++sample)
+            destination[sample] *= source[sample];
+    }
+
+    template<int NumCoefs>
+    class Avx2LaneDecimator final : public SfzLaneDecimator
+    {
+    public:
+        int getNumLanes() const noexcept override { return 8; }
+        void setCoefs(const double* coefs) noexcept override { downsampler.set_coefs(coefs); }
+        void clear() noexcept override { downsampler.clear_buffers(); }
+        void clearLane(int lane) noexcept override { downsampler.clear_buffers_lane(lane); }
+        void process(float* output, const float* input, int numSamples) noexcept override
+        {
+            if (numSamples > 0)
+                downsampler.process_block(output, input, numSamples);
+        }
+    private:
+        hiir::Downsampler2x8Avx<NumCoefs> downsampler;
+    };
+}
+
+#if defined(__clang__)
+    #pragma clang attribute pop
+#elif defined(__GNUC__)
+    #pragma GCC pop_options
+#endif
+
+const SfzSimd::Kernels& SfzSimd::getAvx2Kernels() noexcept
+{
+    static const Kernels kernels {
+        SfzSimdLevel::avx2,
+        8,
+        linear<float>,
+        linear<int16_t>,
+        linear<SfzInt24>,
+        add,
+        multiply,
+        makeLaneDecimator<Avx2LaneDecimator>
+    };
+    return kernels;
+}
+#endif
@@ -0,0 +1,178 @@
+/*
+    ==============================================================================
+
+    Copyright 2019 - Paul Ferrand (paulfd@outlook.fr)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    ==============================================================================
+*/
+
+
+#include "SfzSimdDispatch.h"
+#if SFZ_HAVE_X86_DISPATCH
+#include <immintrin.h>
+#include <array>
+#include <cassert>
+
+// Everything up to the matching pop is compiled for AVX-512F, and is only reached through
+// getAvx512Kernels() once SfzSimd::isSupported() agreed. Only code with internal linkage
+// or templates used nowhere else belongs there, so that no AVX-512 copy of a shared inline
+// function can be picked by the linker for the rest of the program.
+// The kernels have to match the baseline ones bit for bit so that the output does not depend
+// on the CPU, and a fused multiply-add rounds once where the baseline rounds twice. Contractions
+// are turned off whether FMA comes with the target (AVX-512F implies it) or from build flags such as -mfma.
+#if defined(__clang__)
+    #pragma clang attribute push (__attribute__((target("avx512f"))), apply_to = function)
+    #pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+    #pragma GCC push_options
+    #pragma GCC target("avx512f")
+    #pragma GCC optimize("fp-contract=off")
+    // Some GCC versions warn about the undefined vectors in their own AVX-512 intrinsics
+    #pragma GCC diagnostic push
+    #pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#endif
+
+#include "hiir/Downsampler2x16Avx512.h"
+
+namespace
+{
+    // Reads the samples at the 16 offsets and the ones just after
+    inline void gatherPairs(const float* in, __m512i offsets, __m512& current, __m512& next) noexcept
+    {
+        current = _mm512_i32gather_ps(offsets, in, 4);
+        next = _mm512_i32gather_ps(offsets, in + 1, 4);
+    }
+
+    // A 32 bit gather reads a 16 bit sample and the next one at once
+    inline void gatherPairs(const int16_t* in, __m512i offsets, __m512& current, __m512& next) noexcept
+    {
+        const __m512i pairs = _mm512_i32gather_epi32(offsets, reinterpret_cast<const int*>(in), 2);
+        const __m512 scale = _mm512_set1_ps(SfzSampleTraits<int16_t>::scale);
+        current = _mm512_mul_ps(_mm512_cvtepi32_ps(_mm512_srai_epi32(_mm512_slli_epi32(pairs, 16), 16)), scale);
+        next = _mm512_mul_ps(_mm512_cvtepi32_ps(_mm512_srai_epi32(pairs, 16)), scale);
+    }
+
+    // 24 bit samples are read 4 bytes at a time, from the start of the current sample and from
+    // the last byte of the current sample, so that no byte past the next sample is read
+    inline void gatherPairs(const SfzInt24* in, __m512i offsets, __m512& current, __m512& next) noexcept
+    {
+        const auto bytes = reinterpret_cast<const char*>(in);
+        const __m512i byteOffsets = _mm512_add_epi32(offsets, _mm512_add_epi32(offsets, offsets));
+        const __m512i currentBits = _mm512_i32gather_epi32(byteOffsets, reinterpret_cast<const int*>(bytes), 1);
+        const __m512i nextBits = _mm512_i32gather_epi32(byteOffsets, reinterpret_cast<const int*>(bytes + 2), 1);
+        const __m512 scale = _mm512_set1_ps(SfzSampleTraits<SfzInt24>::scale);
+        current = _mm512_mul_ps(_mm512_cvtepi32_ps(_mm512_srai_epi32(_mm512_slli_epi32(currentBits, 8), 8)), scale);
+        next = _mm512_mul_ps(_mm512_cvtepi32_ps(_mm512_srai_epi32(nextBits, 8)), scale);
+    }
+
+    // Same computations as SfzInterpolation::linearKernel, 16 frames at a time
+    template<class T>
+    void linear(const T* const* source, float* const* output, int numChannels, int index, float fraction, float step, int numFrames) noexcept
+    {
+        int frame = 0;
+        const __m512 fractionVector = _mm512_set1_ps(fraction);
+        const __m512 stepVector = _mm512_set1_ps(step);
+        const __m512 ramp = _mm512_set_ps(15.0f, 14.0f, 13.0f, 12.0f, 11.0f, 10.0f, 9.0f, 8.0f,
+                                           7.0f, 6.0f, 5.0f, 4.0f, 3.0f, 2.0f, 1.0f, 0.0f);
+        for (; frame + 16 <= numFrames; frame += 16)
+        {
+            const __m512 frames = _mm512_add_ps(_mm512_set1_ps(static_cast<float>(frame)), ramp);
+            const __m512 position = _mm512_add_ps(fractionVector, _mm512_mul_ps(frames, stepVector));
+            const __m512i offsets = _mm512_cvttps_epi32(position);
+            const __m512 weights = _mm512_sub_ps(position, _mm512_cvtepi32_ps(offsets));
+
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                __m512 current;
+                __m512 next;
+                gatherPairs(source[channel] + index, offsets, current, next);
+                _mm512_storeu_ps(output[channel] + frame, _mm512_add_ps(current, _mm512_mul_ps(weights, _mm512_sub_ps(next, current))));
+            }
+        }
+
+        using Traits = SfzSampleTraits<T>;
+        for (; frame < numFrames; ++frame)
+        {
+            const float position = fraction + static_cast<float>(frame) * step;
+            const int offset = static_cast<int>(position);
+            const float weight = position - static_cast<float>(offset);
+            for (int channel = 0; channel < numChannels; ++channel)
+            {
+                const T* in = source[channel] + index + offset;
+                const float current = Traits::toFloat(in[0]);
+                output[channel][frame] = current + weight * (Traits::toFloat(in[1]) - current);
+            }
+        }
+    }
+
+    void add(float* destination, const float* source, int numSamples) noexcept
+    {
+        int sample = 0;
+        for (; sample + 16 <= numSamples; sample += 16)
+            _mm512_storeu_ps(destination + sample, _mm512_add_ps(_mm512_loadu_ps(destination + sample), _mm512_loadu_ps(source + sample)));
+        for (; sample < numSamples; ++sample)
+            destination[sample] += source[sample];
+    }
+
+    void multiply(float* destination, const float* source, int numSamples) noexcept
+    {
+        int sample = 0;
+        for (; sample + 16 <= numSamples; sample += 16)
+            _mm512_storeu_ps(destination + sample, _mm512_mul_ps(_mm512_loadu_ps(destination + sample), _mm512_loadu_ps(source + sample)));
+        for (; sample < numSamples; ++sample)
+            destination[sample] *= source[sample];
+    }
+
+    template<int NumCoefs>
+    class Avx512LaneDecimator final : public SfzLaneDecimator
+    {
+    public:
+        int getNumLanes() const noexcept override { return 16; }
+        void setCoefs(const double* coefs) noexcept override { downsampler.set_coefs(coefs); }
+        void clear() noexcept override { downsampler.clear_buffers(); }
+        void clearLane(int lane) noexcept override { downsampler.clear_buffers_lane(lane); }
+        void process(float* output, const float* input, int numSamples) noexcept override
+        {
+            if (numSamples > 0)
+                downsampler.process_block(output, input, numSamples);
+        }
+    private:
+        hiir::Downsampler2x16Avx512<NumCoefs> downsampler;
+    };
+}
+
+#if defined(__clang__)
+    #pragma clang attribute pop
+#elif defined(__GNUC__)
+    #pragma GCC diagnostic pop
+    #pragma GCC pop_options
+#endif
+
+const SfzSimd::Kernels& SfzSimd::getAvx512Kernels() noexcept
+{
+    static const Kernels kernels {
+        SfzSimdLevel::avx512,
+        16,
+        linear<float>,
+        linear<int16_t>,
+        linear<SfzInt24>,
+        add,
+        multiply,
+        makeLaneDecimator<Avx512LaneDecimator>
+    };
+    return kernels;
+}
+#endif
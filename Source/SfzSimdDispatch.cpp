@@ -0,0 +1,274 @@
+/*
+    ==============================================================================
+
+    Copyright 2019 - Paul Ferrand (paulfd@outlook.fr)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    ==============================================================================
+*/
+
+
+#include "SfzSimdDispatch.h"
+#include "SfzInterpolation.h"
+#if SFZ_HAVE_SSE
+    #include "hiir/Downsampler2x4Sse.h"
+#elif SFZ_HAVE_NEON
+    #include "hiir/Downsampler2x4Neon.h"
+#else
+    #include "hiir/Downsampler2xFpu.h"
+#endif
+#if SFZ_HAVE_X86_DISPATCH
+    #if defined(_MSC_VER)
+        #include <intrin.h>
+    #else
+        #include <cpuid.h>
+    #endif
+#endif
+#include <array>
+#include <atomic>
+
+namespace
+{
+#if SFZ_HAVE_SSE
+    constexpr SfzSimdLevel baselineLevel { SfzSimdLevel::sse2 };
+#elif SFZ_HAVE_NEON
+    constexpr SfzSimdLevel baselineLevel { SfzSimdLevel::neon };
+#else
+    constexpr SfzSimdLevel baselineLevel { SfzSimdLevel::scalar };
+#endif
+
+    void addBaseline(float* destination, const float* source, int numSamples) noexcept
+    {
+        int sample = 0;
+#if SFZ_HAVE_SSE
+        for (; sample + 4 <= numSamples; sample += 4)
+            _mm_storeu_ps(destination + sample, _mm_add_ps(_mm_loadu_ps(destination + sample), _mm_loadu_ps(source + sample)));
+#elif SFZ_HAVE_NEON
+        for (; sample + 4 <= numSamples; sample += 4)
+            vst1q_f32(destination + sample, vaddq_f32(vld1q_f32(destination + sample), vld1q_f32(source + sample)));
+#endif
+        for (; sample < numSamples; ++sample)
+            destination[sample] += source[sample];
+    }
+
+    void multiplyBaseline(float* destination, const float* source, int numSamples) noexcept
+    {
+        int sample = 0;
+#if SFZ_HAVE_SSE
+        for (; sample + 4 <= numSamples; sample += 4)
+            _mm_storeu_ps(destination + sample, _mm_mul_ps(_mm_loadu_ps(destination + sample), _mm_loadu_ps(source + sample)));
+#elif SFZ_HAVE_NEON
+        for (; sample + 4 <= numSamples; sample += 4)
+            vst1q_f32(destination + sample, vmulq_f32(vld1q_f32(destination + sample), vld1q_f32(source + sample)));
+#endif
+        for (; sample < numSamples; ++sample)
+            destination[sample] *= source[sample];
+    }
+
+#if SFZ_HAVE_SSE || SFZ_HAVE_NEON
+    template<int NumCoefs>
+    class BaselineLaneDecimator final : public SfzLaneDecimator
+    {
+    public:
+        int getNumLanes() const noexcept override { return 4; }
+        void setCoefs(const double* coefs) noexcept override { downsampler.set_coefs(coefs); }
+        void clear() noexcept override { downsampler.clear_buffers(); }
+        void clearLane(int lane) noexcept override { downsampler.clear_buffers_lane(lane); }
+        void process(float* output, const float* input, int numSamples) noexcept override
+        {
+            if (numSamples > 0)
+                downsampler.process_block(output, input, numSamples);
+        }
+    private:
+    #if SFZ_HAVE_SSE
+        hiir::Downsampler2x4Sse<NumCoefs> downsampler;
+    #else
+        hiir::Downsampler2x4Neon<NumCoefs> downsampler;
+    #endif
+    };
+#else
+    // One scalar decimator per lane, reading the interleaved frames two by two
+    template<int NumCoefs>
+    class BaselineLaneDecimator final : public SfzLaneDecimator
+    {
+    public:
+        int getNumLanes() const noexcept override { return numLanes; }
+        void setCoefs(const double* coefs) noexcept override
+        {
+            for (auto& downsampler: downsamplers)
+                downsampler.set_coefs(coefs);
+        }
+        void clear() noexcept override
+        {
+            for (auto& downsampler: downsamplers)
+                downsampler.clear_buffers();
+        }
+        void clearLane(int lane) noexcept override { downsamplers[static_cast<size_t>(lane)].clear_buffers(); }
+        void process(float* output, const float* input, int numSamples) noexcept override
+        {
+            for (int sample = 0; sample < numSamples; ++sample)
+            {
+                const float* frames = input + 2 * sample * numLanes;
+                for (int lane = 0; lane < numLanes; ++lane)
+                {
+                    const float pair[2] { frames[lane], frames[numLanes + lane] };
+                    output[sample * numLanes + lane] = downsamplers[static_cast<size_t>(lane)].process_sample(pair);
+                }
+            }
+        }
+    private:
+        static constexpr int numLanes { 4 };
+        std::array<hiir::Downsampler2xFpu<NumCoefs>, numLanes> downsamplers;
+    };
+#endif
+
+    const SfzSimd::Kernels baselineKernels {
+        baselineLevel,
+        4,
+        SfzInterpolation::linearKernel<float>,
+        SfzInterpolation::linearKernel<int16_t>,
+        SfzInterpolation::linearKernel<SfzInt24>,
+        addBaseline,
+        multiplyBaseline,
+        SfzSimd::makeLaneDecimator<BaselineLaneDecimator>
+    };
+
+#if SFZ_HAVE_X86_DISPATCH
+    struct CpuidRegisters { uint32_t eax, ebx, ecx, edx; };
+
+    bool cpuid(uint32_t leaf, uint32_t subleaf, CpuidRegisters& registers) noexcept
+    {
+    #if defined(_MSC_VER)
+        int info[4];
+        __cpuid(info, 0);
+        if (static_cast<uint32_t>(info[0]) < leaf)
+            return false;
+        __cpuidex(info, static_cast<int>(leaf), static_cast<int>(subleaf));
+        registers = { static_cast<uint32_t>(info[0]), static_cast<uint32_t>(info[1]), static_cast<uint32_t>(info[2]), static_cast<uint32_t>(info[3]) };
+        return true;
+    #else
+        return __get_cpuid_count(leaf, subleaf, &registers.eax, &registers.ebx, &registers.ecx, &registers.edx) != 0;
+    #endif
+    }
+
+    // Register states that the OS saves on context switches
+    uint64_t readXcr0() noexcept
+    {
+    #if defined(_MSC_VER)
+        return _xgetbv(0);
+    #else
+        uint32_t eax, edx;
+        __asm__ volatile ("xgetbv" : "=a"(eax), "=d"(edx) : "c"(0));
+        return (static_cast<uint64_t>(edx) << 32) | eax;
+    #endif
+    }
+
+    // The CPU has to support the instructions and the OS has to save the wider registers
+    SfzSimdLevel detectX86Level() noexcept
+    {
+        constexpr uint32_t osxsaveBit { 1u << 27 };
+        constexpr uint32_t avxBit { 1u << 28 };
+        constexpr uint32_t avx2Bit { 1u << 5 };
+        constexpr uint32_t avx512fBit { 1u << 16 };
+        constexpr uint64_t avxStates { 0x6 };     // SSE and AVX registers
+        constexpr uint64_t avx512States { 0xe6 }; // Same, plus the opmask and upper ZMM registers
+
+        CpuidRegisters features;
+        CpuidRegisters extendedFeatures;
+        if (!cpuid(1, 0, features) || (features.ecx & osxsaveBit) == 0 || (features.ecx & avxBit) == 0)
+            return SfzSimdLevel::sse2;
+        if (!cpuid(7, 0, extendedFeatures))
+            return SfzSimdLevel::sse2;
+
+        // The AVX-512 level also runs the AVX2 kernels
+        const auto xcr0 = readXcr0();
+        if ((xcr0 & avxStates) != avxStates || (extendedFeatures.ebx & avx2Bit) == 0)
+            return SfzSimdLevel::sse2;
+        if ((xcr0 & avx512States) == avx512States && (extendedFeatures.ebx & avx512fBit) != 0)
+            return SfzSimdLevel::avx512;
+        return SfzSimdLevel::avx2;
+    }
+#endif
+
+    const SfzSimd::Kernels& getKernelsFor(SfzSimdLevel level) noexcept
+    {
+        switch (level)
+        {
+#if SFZ_HAVE_X86_DISPATCH
+        case SfzSimdLevel::avx2: return SfzSimd::getAvx2Kernels();
+        case SfzSimdLevel::avx512: return SfzSimd::getAvx512Kernels();
+#endif
+        default: return baselineKernels;
+        }
+    }
+
+    std::atomic<const SfzSimd::Kernels*>& activeKernels() noexcept
+    {
+        static std::atomic<const SfzSimd::Kernels*> kernels { &getKernelsFor(SfzSimd::detectLevel()) };
+        return kernels;
+    }
+}
+
+SfzSimdLevel SfzSimd::detectLevel() noexcept
+{
+#if SFZ_HAVE_X86_DISPATCH
+    static const SfzSimdLevel level { detectX86Level() };
+    return level;
+#else
+    return baselineLevel;
+#endif
+}
+
+bool SfzSimd::isSupported(SfzSimdLevel level) noexcept
+{
+    if (level == baselineLevel)
+        return true;
+#if SFZ_HAVE_X86_DISPATCH
+    if (level == SfzSimdLevel::avx2 || level == SfzSimdLevel::avx512)
+        return static_cast<int>(level) <= static_cast<int>(detectLevel());
+#endif
+    return false;
+}
+
+const char* SfzSimd::getLevelName(SfzSimdLevel level) noexcept
+{
+    switch (level)
+    {
+    case SfzSimdLevel::sse2: return "SSE2";
+    case SfzSimdLevel::avx2: return "AVX2";
+    case SfzSimdLevel::avx512: return "AVX-512";
+    case SfzSimdLevel::neon: return "NEON";
+    default: return "scalar";
+    }
+}
+
+const SfzSimd::Kernels& SfzSimd::getKernels() noexcept
+{
+    return *activeKernels().load(std::memory_order_acquire);
+}
+
+SfzSimdLevel SfzSimd::getLevel() noexcept
+{
+    return getKernels().level;
+}
+
+bool SfzSimd::setLevel(SfzSimdLevel level) noexcept
+{
+    if (!isSupported(level))
+        return false;
+
+    activeKernels().store(&getKernelsFor(level), std::memory_order_release);
+    return true;
+}
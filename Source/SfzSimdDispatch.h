@@ -0,0 +1,118 @@
+/*
+    ==============================================================================
+
+    Copyright 2019 - Paul Ferrand (paulfd@outlook.fr)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    ==============================================================================
+*/
+
+
+
+#pragma once
+#include "SfzSIMD.h"
+#include "SfzSampleBuffer.h"
+#include <cstdint>
+#include <memory>
+
+// The AVX2 and AVX-512 kernels are built in their own translation units with a target pragma,
+// and only called once the CPU has been checked for them
+#if SFZ_HAVE_SSE && (defined(__GNUC__) || defined(_MSC_VER))
+    #define SFZ_HAVE_X86_DISPATCH 1
+#else
+    #define SFZ_HAVE_X86_DISPATCH 0
+#endif
+
+// Instruction sets that the kernels can be dispatched to; sse2 and neon are the compile-time baselines
+enum class SfzSimdLevel { scalar, sse2, avx2, avx512, neon };
+
+/**
+ * A 2x polyphase IIR decimator working on several independent lanes at once, e.g. several
+ * voices or channels. The input holds 2 * numSamples frames and the output numSamples frames,
+ * with the lanes interleaved within each frame: sample s of lane l is at s * getNumLanes() + l.
+ */
+class SfzLaneDecimator
+{
+public:
+    virtual ~SfzLaneDecimator() = default;
+    virtual int getNumLanes() const noexcept = 0;
+    // Coefficients from hiir::PolyphaseIir2Designer, as many as the order of the decimator
+    virtual void setCoefs(const double* coefs) noexcept = 0;
+    virtual void process(float* output, const float* input, int numSamples) noexcept = 0;
+    // Clears the filter memories of all the lanes
+    virtual void clear() noexcept = 0;
+    // Clears the filter memory of one lane, e.g. when a new voice starts using it
+    virtual void clearLane(int lane) noexcept = 0;
+
+    // The orders of the SfzOversampling stages are the only ones instantiated
+    static bool isSupportedOrder(int numCoefs) noexcept { return numCoefs == 4 || numCoefs == 12; }
+};
+
+namespace SfzSimd
+{
+    template<class T>
+    using LinearKernel = void (*)(const T* const* source, float* const* output, int numChannels, int index, float fraction, float step, int numFrames) noexcept;
+    using BinaryKernel = void (*)(float* destination, const float* source, int numSamples) noexcept;
+    using DecimatorFactory = std::unique_ptr<SfzLaneDecimator> (*)(int numCoefs);
+
+    /**
+     * The kernels of one instruction set. The linear interpolation kernels have the contract
+     * of SfzInterpolation::linear(), add and multiply work in place on the destination,
+     * and createDecimator returns an empty pointer for an unsupported order. The decimators
+     * it creates have numDecimatorLanes lanes.
+     */
+    struct Kernels
+    {
+        SfzSimdLevel level;
+        int numDecimatorLanes;
+        LinearKernel<float> linearFloat;
+        LinearKernel<int16_t> linearInt16;
+        LinearKernel<SfzInt24> linearInt24;
+        BinaryKernel add;
+        BinaryKernel multiply;
+        DecimatorFactory createDecimator;
+    };
+
+    // Widest instruction set supported by both the build and the CPU, detected once
+    SfzSimdLevel detectLevel() noexcept;
+    bool isSupported(SfzSimdLevel level) noexcept;
+    const char* getLevelName(SfzSimdLevel level) noexcept;
+
+    // Kernels in use, which are the ones of the detected level unless setLevel() was called
+    const Kernels& getKernels() noexcept;
+    SfzSimdLevel getLevel() noexcept;
+
+    // Switches the kernels in use, e.g. to compare the instruction sets in tests and benchmarks.
+    // Returns false and changes nothing if the level is not supported.
+    bool setLevel(SfzSimdLevel level) noexcept;
+
+    // Creates a decimator of one of the supported orders from a decimator template over the order
+    template<template<int> class Decimator>
+    std::unique_ptr<SfzLaneDecimator> makeLaneDecimator(int numCoefs)
+    {
+        switch (numCoefs)
+        {
+        case 4: return std::unique_ptr<SfzLaneDecimator>(new Decimator<4>());
+        case 12: return std::unique_ptr<SfzLaneDecimator>(new Decimator<12>());
+        default: return {};
+        }
+    }
+
+#if SFZ_HAVE_X86_DISPATCH
+    // Defined in SfzSimdAvx2.cpp and SfzSimdAvx512.cpp; only use them if isSupported() agrees
+    const Kernels& getAvx2Kernels() noexcept;
+    const Kernels& getAvx512Kernels() noexcept;
+#endif
+}
@@ -20,13 +20,17 @@
 */
 
 #include "SfzSynth.h"
+#include "SfzTokenizer.h"
 #include <string>
 #include <fstream>
 #include <regex>
 #include <algorithm>
 #include <string_view>
+#include <set>
+#include <atomic>
+#include <future>
+#include <map>
 
-using svregex_iterator = std::regex_iterator<std::string_view::const_iterator>;
 using svmatch_results = std::match_results<std::string_view::const_iterator>;
 
 SfzSynth::SfzSynth()
@@ -43,10 +47,175 @@ SfzSynth::~SfzSynth()
 void SfzSynth::initalizeVoices(int numVoices)
 {
     voices.clear();
-	for (int i = 0; i < numVoices; ++i)
+	freeVoices.clear();
+	activeVoices.clear();
+	maxPolyphony = numVoices;
+	const int numPhysicalVoices = numVoices + config::voiceHeadroom;
+	jassert(static_cast<size_t>(numPhysicalVoices) <= backgroundLoader.getMaximumJobs());
+	// Reserve everything here so that triggering voices never allocates
+	voices.reserve(numPhysicalVoices);
+	freeVoices.reserve(numPhysicalVoices);
+	activeVoices.reserve(numPhysicalVoices);
+	for (int i = 0; i < numPhysicalVoices; ++i)
 	{
-		auto & voice = voices.emplace_back(fileLoadingPool, filePool, ccState);
-		voice.prepareToPlay(sampleRate, samplesPerBlock);
+		auto& voice = voices.emplace_back(std::make_unique<SfzVoice>(backgroundLoader, filePool, ccState));
+		voice->prepareToPlay(sampleRate, samplesPerBlock);
+		voice->setSynchronousLoading(synchronousLoading);
+		voice->setOversamplingFactor(oversamplingFactor);
+		freeVoices.push_back(voice.get());
+	}
+	prepareVoiceBatches();
+}
+
+void SfzSynth::prepareVoiceBatches()
+{
+	voiceBatches.clear();
+	playingBatches.clear();
+	if (oversamplingFactor == 1)
+		return;
+
+	// Neighbouring voices share a batch for their whole life, since the batch keeps their filter memories
+	const auto batchSize = static_cast<size_t>(SfzVoiceBatch::getPreferredSize());
+	for (size_t firstVoice = 0; firstVoice < voices.size(); firstVoice += batchSize)
+	{
+		std::vector<SfzVoice*> batchVoices;
+		for (size_t voiceIdx = firstVoice; voiceIdx < std::min(firstVoice + batchSize, voices.size()); ++voiceIdx)
+			batchVoices.push_back(voices[voiceIdx].get());
+		auto& batch = voiceBatches.emplace_back(std::make_unique<SfzVoiceBatch>(std::move(batchVoices)));
+		batch->prepare(oversamplingFactor, samplesPerBlock);
+	}
+	playingBatches.reserve(voiceBatches.size());
+}
+
+void SfzSynth::setSynchronousLoading(bool synchronous)
+{
+	synchronousLoading = synchronous;
+	for (auto& voice: voices)
+		voice->setSynchronousLoading(synchronous);
+}
+
+void SfzSynth::setOversamplingFactor(int factor)
+{
+	jassert(SfzOversampling::isValidFactor(factor));
+	oversamplingFactor = SfzOversampling::isValidFactor(factor) ? factor : 1;
+	for (auto& voice: voices)
+		voice->setOversamplingFactor(oversamplingFactor);
+	prepareVoiceBatches();
+}
+
+SfzVoice* SfzSynth::findFreeVoice() noexcept
+{
+	if (freeVoices.empty())
+		collectFreeVoices();
+
+	if (freeVoices.empty())
+		return nullptr;
+
+	auto* voice = freeVoices.back();
+	freeVoices.pop_back();
+	activeVoices.push_back(voice);
+	return voice;
+}
+
+template<class Predicate>
+SfzVoice* SfzSynth::selectVoiceToSteal(std::optional<int> noteNumber, Predicate&& isCandidate) const noexcept
+{
+	SfzVoice* oldest { nullptr };
+	SfzVoice* quietest { nullptr };
+	SfzVoice* oldestSameNote { nullptr };
+	SfzVoice* oldestReleasing { nullptr };
+	auto isOlder = [](const SfzVoice* voice, const SfzVoice* other) { 
+		return other == nullptr || voice->getTriggerOrder() < other->getTriggerOrder(); 
+	};
+
+	for (auto* voice: activeVoices)
+	{
+		// Voices without a region are being reset and free up on their own
+		if (voice->getRegion() == nullptr || !isCandidate(*voice))
+			continue;
+
+		if (isOlder(voice, oldest))
+			oldest = voice;
+		if (quietest == nullptr || voice->getCurrentLevel() < quietest->getCurrentLevel())
+			quietest = voice;
+		if (noteNumber && voice->getTriggeringNoteNumber() == noteNumber && isOlder(voice, oldestSameNote))
+			oldestSameNote = voice;
+		if (voice->isReleasing() && isOlder(voice, oldestReleasing))
+			oldestReleasing = voice;
+	}
+
+	switch (stealingPolicy)
+	{
+	case SfzStealingPolicy::quietest:
+		return quietest;
+	case SfzStealingPolicy::sameNoteFirst:
+		return oldestSameNote != nullptr ? oldestSameNote : oldest;
+	case SfzStealingPolicy::releaseFirst:
+		return oldestReleasing != nullptr ? oldestReleasing : oldest;
+	case SfzStealingPolicy::oldest:
+	default:
+		return oldest;
+	}
+}
+
+template<class Predicate>
+void SfzSynth::enforcePolyphony(uint32_t limit, std::optional<int> noteNumber, int timestamp, Predicate&& isCandidate) noexcept
+{
+	auto isSoundingCandidate = [&](const SfzVoice& voice) { return voice.isSounding() && isCandidate(voice); };
+	auto numSounding = std::count_if(activeVoices.begin(), activeVoices.end(), [&](const SfzVoice* voice) { return isSoundingCandidate(*voice); });
+	while (numSounding >= static_cast<decltype(numSounding)>(limit))
+	{
+		auto* stolenVoice = selectVoiceToSteal(noteNumber, isSoundingCandidate);
+		if (stolenVoice == nullptr)
+			return;
+
+		stolenVoice->steal(timestamp);
+		numSounding--;
+	}
+}
+
+SfzVoice* SfzSynth::allocateVoice(const SfzRegion& region, std::optional<int> noteNumber, int timestamp) noexcept
+{
+	// A voice being reset by the loader thread may have lost its region already
+	auto sameGroup = [&region](const SfzVoice& voice) {
+		const auto* voiceRegion = voice.getRegion();
+		return voiceRegion != nullptr && voiceRegion->group == region.group;
+	};
+	if (region.polyphony)
+		enforcePolyphony(*region.polyphony, noteNumber, timestamp, sameGroup);
+
+	if (region.notePolyphony && noteNumber)
+		enforcePolyphony(*region.notePolyphony, noteNumber, timestamp, [&](const SfzVoice& voice) { 
+			return sameGroup(voice) && voice.getTriggeringNoteNumber() == noteNumber; 
+		});
+
+	enforcePolyphony(static_cast<uint32_t>(maxPolyphony), noteNumber, timestamp, [](const SfzVoice&) { return true; });
+
+	auto* voice = findFreeVoice();
+	if (voice == nullptr)
+	{
+		DBG("No voice left to fade out stolen voices, dropping a note");
+		return nullptr;
+	}
+
+	voice->setTriggerOrder(voiceTriggerCounter++);
+	return voice;
+}
+
+void SfzSynth::collectFreeVoices() noexcept
+{
+	for (size_t voiceIdx = 0; voiceIdx < activeVoices.size();)
+	{
+		if (activeVoices[voiceIdx]->isFree())
+		{
+			freeVoices.push_back(activeVoices[voiceIdx]);
+			activeVoices[voiceIdx] = activeVoices.back();
+			activeVoices.pop_back();
+		}
+		else
+		{
+			voiceIdx++;
+		}
 	}
 }
 
@@ -159,14 +328,32 @@ bool SfzSynth::loadSfzFile(const std::filesystem::path &file)
 
 	rootDirectory = file.parent_path();
 	filePool.setRootDirectory(File(rootDirectory.string()));
+
+	const bool useCache = instrumentCacheDirectory != File();
+	const File absoluteSfzFile { std::filesystem::absolute(sfzFile).string() };
+	const auto cacheFile = SfzInstrumentCache::getCacheFileFor(instrumentCacheDirectory, absoluteSfzFile);
+	const auto indexFile = SfzInstrumentCache::getSampleIndexFileFor(instrumentCacheDirectory, filePool.getRootDirectory());
+	if (useCache)
+	{
+		SfzInstrumentCache::readSampleIndex(indexFile, filePool);
+		if (loadFromCache(cacheFile))
+		{
+			SfzInstrumentCache::writeSampleIndex(indexFile, filePool);
+			return true;
+		}
+
+		// Start again from a clean slate if the cache was partially read
+		clear();
+		filePool.setRootDirectory(File(rootDirectory.string()));
+	}
+
 	std::vector<std::string> lines;
 	readSfzFile(file, lines);
 
 	const auto fullString = joinIntoString(lines);
 	const std::string_view fullStringView { fullString };
 
-	svregex_iterator headerIterator(fullStringView.cbegin(), fullStringView.cend(), SfzRegexes::headers);
-	const auto regexEnd = svregex_iterator();
+	SfzTokenizer tokenizer { fullStringView };
 
 	std::optional<uint8_t> defaultSwitch {};
 	std::vector<SfzOpcode> globalMembers;
@@ -178,6 +365,8 @@ bool SfzSynth::loadSfzFile(const std::filesystem::path &file)
 	bool regionStarted = false;
 	bool hasGlobal = false;
 	bool hasControl = false;
+	unsigned int currentHeader = 0;
+	SfzCacheWriter regionOpcodes;
 	
 	auto buildRegion = [&, this]() {
 		regions.emplace_back(File(rootDirectory.string()), filePool);
@@ -191,125 +380,128 @@ bool SfzSynth::loadSfzFile(const std::filesystem::path &file)
 			region.parseOpcode(opcode);
 		for (auto& opcode: regionMembers)
 			region.parseOpcode(opcode);
+
+		// Keep the flattened opcode list so that the cache can rebuild the region without parsing
+		if (useCache)
+		{
+			regionOpcodes.write(static_cast<uint32_t>(globalMembers.size() + masterMembers.size() + groupMembers.size() + regionMembers.size()));
+			for (auto* members: { &globalMembers, &masterMembers, &groupMembers, &regionMembers })
+				for (auto& opcode: *members)
+					regionOpcodes.writeOpcode(opcode);
+		}
 		regionMembers.clear();	
 	};
 
-	for (; headerIterator != regexEnd; ++headerIterator)
+	for (auto token = tokenizer.next(); token.type != SfzTokenType::end; token = tokenizer.next())
   	{
-		svmatch_results headerMatch = *headerIterator;
-
-		// Can't use uniform initialization here because it generates narrowing conversions
-		const std::string_view header(&*headerMatch[1].first, headerMatch[1].length());
-		const std::string_view members(&*headerMatch[2].first, headerMatch[2].length());
-		auto paramIterator = svregex_iterator (members.cbegin(), members.cend(), SfzRegexes::members);
-
-		// If we had a building region and we encounter a new header we have to build it
-		if (regionStarted)
+		if (token.type == SfzTokenType::header)
 		{
-			buildRegion();
-			regionStarted = false;
-		}
+			// If we had a building region and we encounter a new header we have to build it
+			if (regionStarted)
+			{
+				buildRegion();
+				regionStarted = false;
+			}
 
-		// Header logic
-		switch (hash(header))
-		{
-			case hash("global"):
-				if (hasGlobal)
-					// We shouldn't have multiple global headers in file
-					jassertfalse;
-				else
-					hasGlobal = true;
-				break;
-			case hash("control"):
-				if (hasControl)
-					// We shouldn't have multiple control headers in file
-					jassertfalse;
-				else
-					hasControl = true;
-				break;
-			case hash("master"):
-				numMasters += 1;
-				groupMembers.clear();
-				masterMembers.clear();
-				break;
-			case hash("group"):
-				numGroups += 1;
-				groupMembers.clear();
-				break;
-			case hash("region"):
-				regionStarted = true;
-				break;
-			// TODO: handle these
-			case hash("curve"):
-				DBG("Curve header not implemented");
-				break;
-			case hash("effect"):
-				DBG("Effect header not implemented");
-				break;
-			default:
-				DBG("unknown header: " << std::string(header));
+			// Header logic
+			currentHeader = hash(token.header);
+			switch (currentHeader)
+			{
+				case hash("global"):
+					if (hasGlobal)
+						// We shouldn't have multiple global headers in file
+						jassertfalse;
+					else
+						hasGlobal = true;
+					break;
+				case hash("control"):
+					if (hasControl)
+						// We shouldn't have multiple control headers in file
+						jassertfalse;
+					else
+						hasControl = true;
+					break;
+				case hash("master"):
+					numMasters += 1;
+					groupMembers.clear();
+					masterMembers.clear();
+					break;
+				case hash("group"):
+					numGroups += 1;
+					groupMembers.clear();
+					break;
+				case hash("region"):
+					regionStarted = true;
+					break;
+				// TODO: handle these
+				case hash("curve"):
+					DBG("Curve header not implemented");
+					break;
+				case hash("effect"):
+					DBG("Effect header not implemented");
+					break;
+				default:
+					DBG("unknown header: " << std::string(token.header));
+			}
+			continue;
 		}
 
 		// Store or handle members
-		for (; paramIterator != regexEnd; ++paramIterator)
-		{
-			svmatch_results paramMatch = *paramIterator;
-			const std::string_view opcode(&*paramMatch[1].first, paramMatch[1].length());
-			const std::string_view value(&*paramMatch[2].first, paramMatch[2].length());
+		const std::string_view opcode { token.opcode };
+		const std::string_view value { token.value };
 
-			// Store the members depending on the header
-			switch (hash(header))
+		// Store the members depending on the header
+		switch (currentHeader)
+		{
+		case hash("global"):
+			if (opcode == "sw_default")
+				setValueFromOpcode({opcode, value}, defaultSwitch, SfzDefault::keyRange);
+			else
+				globalMembers.emplace_back(opcode, value);
+			break;
+		case hash("master"):
+			masterMembers.emplace_back(opcode, value);
+			break;
+		case hash("group"):
+			groupMembers.emplace_back(opcode, value);
+			break;
+		case hash("region"):
+			regionMembers.emplace_back(opcode, value);
+			break;
+		case hash("control"):
+		{
+			SfzOpcode lastOpcode{opcode, value};
+			switch (hash(lastOpcode.opcode))
 			{
-			case hash("global"):
-				if (opcode == "sw_default")
-					setValueFromOpcode({opcode, value}, defaultSwitch, SfzDefault::keyRange);
-				else
-					globalMembers.emplace_back(opcode, value);
-				break;
-			case hash("master"):
-				masterMembers.emplace_back(opcode, value);
-				break;
-			case hash("group"):
-				groupMembers.emplace_back(opcode, value);
-				break;
-			case hash("region"):
-				regionMembers.emplace_back(opcode, value);
+			case hash("set_cc"):
+				if (lastOpcode.parameter && withinRange(SfzDefault::ccRange, *lastOpcode.parameter))
+					setValueFromOpcode(lastOpcode, ccState[*lastOpcode.parameter], SfzDefault::ccRange);
 				break;
-			case hash("control"):
-			{
-				SfzOpcode lastOpcode{opcode, value};
-				switch (hash(lastOpcode.opcode))
-				{
-				case hash("set_cc"):
-					if (lastOpcode.parameter && withinRange(SfzDefault::ccRange, *lastOpcode.parameter))
-						setValueFromOpcode(lastOpcode, ccState[*lastOpcode.parameter], SfzDefault::ccRange);
-					break;
-				case hash("label_cc"):
-					if (lastOpcode.parameter && withinRange(SfzDefault::ccRange, *lastOpcode.parameter))
-					{
-						String ccName{lastOpcode.value.data(), lastOpcode.value.size()};
-						ccNames.emplace_back(*lastOpcode.parameter, std::move(ccName));
-					}
-					break;
-				case hash("default_path"):
+			case hash("label_cc"):
+				if (lastOpcode.parameter && withinRange(SfzDefault::ccRange, *lastOpcode.parameter))
 				{
-					String newPath{lastOpcode.value.data(), lastOpcode.value.size()};
-					File newRootDirectory{newPath};
-					filePool.setRootDirectory(newRootDirectory);
-				}
-					break;
-				default:
-					DBG("Unknown/unsupported opcode in <control> header: " << std::string(lastOpcode.opcode));
+					String ccName{lastOpcode.value.data(), lastOpcode.value.size()};
+					ccNames.emplace_back(*lastOpcode.parameter, std::move(ccName));
 				}
+				break;
+			case hash("default_path"):
+			{
+				String newPath{lastOpcode.value.data(), lastOpcode.value.size()};
+				File newRootDirectory{newPath};
+				filePool.setRootDirectory(newRootDirectory);
 			}
-			break;
-			case hash("curve"):
-				curveMembers.emplace_back(opcode, value);
 				break;
-			case hash("effect"):
-				effectMembers.emplace_back(opcode, value);          
+			default:
+				DBG("Unknown/unsupported opcode in <control> header: " << std::string(lastOpcode.opcode));
 			}
 		}
+		break;
+		case hash("curve"):
+			curveMembers.emplace_back(opcode, value);
+			break;
+		case hash("effect"):
+			effectMembers.emplace_back(opcode, value);          
+		}
 	}
 	
 	// Build the last region
@@ -322,9 +514,132 @@ bool SfzSynth::loadSfzFile(const std::filesystem::path &file)
 	// Sort the CC labels
 	std::sort(begin(ccNames), end(ccNames), [](auto& lhs, auto& rhs) { return lhs.first < rhs.first; });
 
+	prepareRegions(defaultSwitch);
+	if (useCache)
+	{
+		writeCache(cacheFile, absoluteSfzFile, defaultSwitch, regionOpcodes);
+		SfzInstrumentCache::writeSampleIndex(indexFile, filePool);
+	}
+	return true;
+}
+
+namespace
+{
+	// Calls the function for every index from a few threads, and returns once all the calls are done
+	template<class F>
+	void parallelFor(size_t count, F&& function)
+	{
+		std::atomic<size_t> nextIndex { 0 };
+		auto worker = [&]() {
+			for (auto index = nextIndex++; index < count; index = nextIndex++)
+				function(index);
+		};
+
+		std::vector<std::future<void>> helpers;
+		const auto numThreads = std::min<size_t>(config::numLoadingThreads, count);
+		for (size_t threadIdx = 1; threadIdx < numThreads; ++threadIdx)
+			helpers.push_back(std::async(std::launch::async, worker));
+		worker();
+		for (auto& helper: helpers)
+			helper.get();
+	}
+}
+
+void SfzSynth::loadSamples()
+{
+	struct SampleToLoad
+	{
+		String name;
+		std::vector<Range<int64>> startRanges {}; // The offsets each region can start from
+		std::optional<SfzSampleMetadata> metadata {};
+		bool readHeader { false };
+		std::vector<SfzPreloadWindow> preloadedWindows {};
+	};
+
+	// One entry per sample, however many regions use it
+	std::vector<SampleToLoad> samples;
+	std::map<String, size_t> sampleIndices;
+	for (const auto& region: regions)
+	{
+		if (region.isGenerator() || region.sample.isEmpty())
+			continue;
+
+		const auto [indexPosition, inserted] = sampleIndices.try_emplace(region.sample, samples.size());
+		if (inserted)
+			samples.push_back({ region.sample });
+
+		auto& sample = samples[indexPosition->second];
+		sample.startRanges.emplace_back(region.offset, static_cast<int64>(region.offset) + region.offsetRandom);
+		// Regions rebuilt from the cache already know their sample metadata
+		if (!sample.metadata)
+			sample.metadata = region.sampleMetadata;
+	}
+
+	for (auto& sample: samples)
+	{
+		if (!sample.metadata)
+			sample.metadata = filePool.getIndexedMetadata(sample.name);
+	}
+
+	// A single reader per sample gives both the metadata and the preloaded windows
+	parallelFor(samples.size(), [&](size_t sampleIdx) {
+		auto& sample = samples[sampleIdx];
+		auto reader = filePool.createReaderFor(sample.name);
+		if (reader == nullptr)
+			return;
+
+		if (!sample.metadata)
+		{
+			sample.metadata = SfzFilePool::readMetadata(*reader);
+			sample.readHeader = true;
+		}
+
+		// Regions slicing the same file share the windows where their preloads overlap
+		std::vector<Range<int64>> preloadRanges;
+		for (auto& startRange: sample.startRanges)
+			preloadRanges.push_back(SfzFilePool::getPreloadRange(startRange.getStart(), startRange.getEnd(), config::preloadSize, reader->lengthInSamples));
+		std::sort(begin(preloadRanges), end(preloadRanges), [](auto& lhs, auto& rhs) { return lhs.getStart() < rhs.getStart(); });
+
+		std::vector<Range<int64>> mergedRanges;
+		for (auto& range: preloadRanges)
+		{
+			if (!mergedRanges.empty() && range.getStart() <= mergedRanges.back().getEnd())
+				mergedRanges.back() = mergedRanges.back().getUnionWith(range);
+			else
+				mergedRanges.push_back(range);
+		}
+
+		// The pool is only read while the workers run
+		for (auto& range: mergedRanges)
+			for (auto& missingRange: filePool.getMissingRanges(sample.name, range))
+				sample.preloadedWindows.push_back({ missingRange.getStart(), SfzFilePool::readPreloadedData(*reader, missingRange) });
+	});
+
+	for (auto& sample: samples)
+	{
+		for (auto& window: sample.preloadedWindows)
+			filePool.addPreloadedData(sample.name, window.start, std::move(window.data));
+		if (sample.metadata)
+			filePool.addToIndex(sample.name, *sample.metadata);
+		if (sample.readHeader)
+			filePool.countMetadataRead();
+	}
+
+	for (auto& region: regions)
+	{
+		const auto sampleIndex = sampleIndices.find(region.sample);
+		if (sampleIndex != sampleIndices.end() && !region.sampleMetadata)
+			region.sampleMetadata = samples[sampleIndex->second].metadata;
+	}
+}
+
+void SfzSynth::prepareRegions(std::optional<uint8_t> defaultSwitch)
+{
+	loadSamples();
 	for (auto& region: regions)
 	{
-		region.prepare();
+		// The samples are loaded already, so this does not touch the disk
+		region.prepare(region.sampleMetadata);
 		
 		for (int ccIdx = 1; ccIdx < 128; ccIdx++)
 		{
@@ -337,9 +652,175 @@ bool SfzSynth::loadSfzFile(const std::filesystem::path &file)
 			region.registerNoteOff(region.channelRange.getStart(), *defaultSwitch, 0, 1.0f);
 		}
 	}
+
+	buildNoteIndex();
+}
+
+void SfzSynth::buildNoteIndex()
+{
+	for (auto& regionList: noteRegions)
+		regionList.clear();
+
+	// A region ignores the notes outside of these ranges, so only candidates need to see note events.
+	// The channel is still checked by the region itself since almost all regions span every channel.
+	for (auto& region: regions)
+	{
+		const bool hasKeyswitch = region.keyswitch || region.keyswitchUp || region.keyswitchDown;
+		for (int noteNumber = 0; noteNumber < static_cast<int>(noteRegions.size()); ++noteNumber)
+		{
+			if (withinRange(region.keyRange, noteNumber) || (hasKeyswitch && withinRange(region.keyswitchRange, noteNumber)))
+				noteRegions[noteNumber].push_back(&region);
+		}
+	}
+}
+
+/*
+ * Cache layout, all values in native byte order:
+ * - magic number and version
+ * - dependencies (root file, included files and samples) with their modification time and size
+ * - included files, sample root directory, CC values, CC labels, defines, sw_default, group and master counts
+ * - the flattened opcode list of each region
+ * - the sample metadata of each region
+ */
+bool SfzSynth::loadFromCache(const File& cacheFile)
+{
+	if (!cacheFile.existsAsFile())
+		return false;
+
+	MemoryMappedFile mappedFile { cacheFile, MemoryMappedFile::readOnly };
+	SfzCacheReader reader { mappedFile.getData(), mappedFile.getSize() };
+	if (reader.read<uint32_t>() != SfzInstrumentCache::magicNumber || reader.read<uint32_t>() != SfzInstrumentCache::version)
+		return false;
+
+	const auto numDependencies = reader.read<uint32_t>();
+	for (uint32_t i = 0; i < numDependencies; ++i)
+	{
+		if (!reader.readAndCheckDependency())
+		{
+			DBG("The instrument cache " << cacheFile.getFullPathName() << " is out of date");
+			return false;
+		}
+	}
+
+	const auto numIncludedFiles = reader.read<uint32_t>();
+	for (uint32_t i = 0; i < numIncludedFiles && !reader.hasFailed(); ++i)
+		includedFiles.emplace_back(reader.readString());
+
+	filePool.setRootDirectory(File(reader.readJuceString()));
+
+	for (auto& cc: ccState)
+		cc = reader.read<uint8_t>();
+
+	const auto numCCNames = reader.read<uint32_t>();
+	for (uint32_t i = 0; i < numCCNames && !reader.hasFailed(); ++i)
+	{
+		const auto ccNumber = reader.read<uint8_t>();
+		ccNames.emplace_back(ccNumber, reader.readJuceString());
+	}
+
+	const auto numDefines = reader.read<uint32_t>();
+	for (uint32_t i = 0; i < numDefines && !reader.hasFailed(); ++i)
+	{
+		const std::string name { reader.readString() };
+		defines[name] = std::string(reader.readString());
+	}
+
+	std::optional<uint8_t> defaultSwitch {};
+	if (reader.read<uint8_t>() != 0)
+		defaultSwitch = reader.read<uint8_t>();
+	numGroups = reader.read<int32_t>();
+	numMasters = reader.read<int32_t>();
+
+	const auto numRegions = reader.read<uint32_t>();
+	for (uint32_t regionIdx = 0; regionIdx < numRegions && !reader.hasFailed(); ++regionIdx)
+	{
+		auto& region = regions.emplace_back(File(rootDirectory.string()), filePool);
+		const auto numOpcodes = reader.read<uint32_t>();
+		for (uint32_t opcodeIdx = 0; opcodeIdx < numOpcodes && !reader.hasFailed(); ++opcodeIdx)
+		{
+			const auto opcode = reader.readString();
+			const auto value = reader.readString();
+			region.parseOpcode({ opcode, value });
+		}
+	}
+
+	for (auto& region: regions)
+		region.sampleMetadata = reader.readMetadata();
+
+	if (reader.hasFailed())
+	{
+		DBG("The instrument cache " << cacheFile.getFullPathName() << " is corrupted");
+		return false;
+	}
+
+	prepareRegions(defaultSwitch);
+	loadedFromCache = true;
 	return true;
 }
 
+void SfzSynth::writeCache(const File& cacheFile, const File& sfzFile, std::optional<uint8_t> defaultSwitch, const SfzCacheWriter& regionOpcodes)
+{
+	std::vector<File> dependencies { sfzFile };
+	for (auto& included: includedFiles)
+		dependencies.emplace_back(std::filesystem::absolute(included).string());
+
+	std::set<String> samplePaths;
+	for (auto& region: regions)
+	{
+		if (region.isGenerator())
+			continue;
+
+		const auto sampleFile = filePool.getSampleFile(region.sample);
+		if (samplePaths.insert(sampleFile.getFullPathName()).second)
+			dependencies.push_back(sampleFile);
+	}
+
+	SfzCacheWriter writer;
+	writer.write(SfzInstrumentCache::magicNumber);
+	writer.write(SfzInstrumentCache::version);
+
+	writer.write(static_cast<uint32_t>(dependencies.size()));
+	for (auto& dependency: dependencies)
+		writer.writeDependency(dependency);
+
+	writer.write(static_cast<uint32_t>(includedFiles.size()));
+	for (auto& included: includedFiles)
+		writer.writeString(included.string());
+
+	writer.writeJuceString(filePool.getRootDirectory().getFullPathName());
+
+	for (auto cc: ccState)
+		writer.write(cc);
+
+	writer.write(static_cast<uint32_t>(ccNames.size()));
+	for (auto& ccNamePair: ccNames)
+	{
+		writer.write(ccNamePair.first);
+		writer.writeJuceString(ccNamePair.second);
+	}
+
+	writer.write(static_cast<uint32_t>(defines.size()));
+	for (auto& definePair: defines)
+	{
+		writer.writeString(definePair.first);
+		writer.writeString(definePair.second);
+	}
+
+	writer.write<uint8_t>(defaultSwitch ? 1 : 0);
+	if (defaultSwitch)
+		writer.write(*defaultSwitch);
+	writer.write<int32_t>(numGroups);
+	writer.write<int32_t>(numMasters);
+
+	writer.write(static_cast<uint32_t>(regions.size()));
+	writer.writeBlock(regionOpcodes);
+	for (auto& region: regions)
+		writer.writeMetadata(region.sampleMetadata);
+
+	if (!instrumentCacheDirectory.createDirectory() || !cacheFile.replaceWithData(writer.getData(), writer.getSize()))
+		DBG("Could not write the instrument cache " << cacheFile.getFullPathName());
+}
+
 StringArray SfzSynth::getUnknownOpcodes() const
 {
 	StringArray returnedArray;
@@ -380,12 +861,19 @@ const SfzRegion* SfzSynth::getRegionView(int num) const
 void SfzSynth::clear()
 {
 	ccNames.clear();
+	for (auto& regionList: noteRegions)
+		regionList.clear();
 	regions.clear();
 	for (auto& voice: voices)
-		voice.reset();
+		voice->reset();
+	collectFreeVoices();
 	filePool.clear();
 	resetMidiState();
 	defines.clear();
+	includedFiles.clear();
+	numGroups = 0;
+	numMasters = 0;
+	loadedFromCache = false;
 }
 
 void SfzSynth::resetMidiState()
@@ -399,28 +887,38 @@ void SfzSynth::prepareToPlay(double newSampleRate, int newSamplesPerBlock)
 	this->sampleRate = newSampleRate;
 	this->samplesPerBlock = newSamplesPerBlock;
 	for (auto& voice: voices)
-		voice.prepareToPlay(newSampleRate, newSamplesPerBlock);
+		voice->prepareToPlay(newSampleRate, newSamplesPerBlock);
+	collectFreeVoices();
 	tempBuffer = AudioBuffer<float>(config::numChannels, newSamplesPerBlock);
+	renderPool.prepare(newSamplesPerBlock);
+	prepareVoiceBatches();
 }
 
 void SfzSynth::registerNoteOn(int channel, int noteNumber, uint8_t velocity, int timestamp)
 {
+	if (!withinRange(SfzDefault::keyRange, noteNumber))
+		return;
+
 	const auto randValue = Random::getSystemRandom().nextFloat();
 
-	for (auto& region: regions)
+	for (auto* region: noteRegions[noteNumber])
 	{
-		if (region.registerNoteOn(channel, noteNumber, velocity, randValue))
+		if (region->registerNoteOn(channel, noteNumber, velocity, randValue))
 		{
-			for (auto& voice: voices)
+			// Releasing the voices leaves the active list alone, but the note-offs can start release voices,
+			// and finding them a voice may grow or compact the list; so they are only sent once it has been walked
+			int numNoteOffs { 0 };
+			for (auto* voice: activeVoices)
 			{
-				const auto triggeringNoteNumber = voice.getTriggeringNoteNumber();
-				if (voice.checkOffGroup(region.group, timestamp) && triggeringNoteNumber)
-					registerNoteOff(channel, noteNumber, 0, timestamp);
+				const auto triggeringNoteNumber = voice->getTriggeringNoteNumber();
+				if (voice->checkOffGroup(region->group, timestamp) && triggeringNoteNumber)
+					numNoteOffs++;
 			}
+			for (int noteOffIdx = 0; noteOffIdx < numNoteOffs; ++noteOffIdx)
+				registerNoteOff(channel, noteNumber, 0, timestamp);
 
-			auto freeVoice = std::find_if(voices.begin(), voices.end(), [](auto& voice) { return voice.isFree(); });
-			if (freeVoice != end(voices))
-				freeVoice->startVoiceWithNote(region, channel, noteNumber, velocity, timestamp);
+			if (auto* freeVoice = allocateVoice(*region, noteNumber, timestamp))
+				freeVoice->startVoiceWithNote(*region, channel, noteNumber, velocity, timestamp);
 		}		
 	}
 }
@@ -429,19 +927,20 @@ void SfzSynth::registerNoteOff(int channel, int noteNumber, uint8_t velocity, in
 {
 	const auto randValue = Random::getSystemRandom().nextFloat();
 	
-	for (auto& region: regions)
+	if (withinRange(SfzDefault::keyRange, noteNumber))
 	{
-		if (region.registerNoteOff(channel, noteNumber, velocity, randValue))
+		for (auto* region: noteRegions[noteNumber])
 		{
-			auto freeVoice = std::find_if(voices.begin(), voices.end(), [](auto& voice) { return voice.isFree(); });
-			if (freeVoice != end(voices))
-				freeVoice->startVoiceWithNote(region, channel, noteNumber, velocity, timestamp);
+			if (region->registerNoteOff(channel, noteNumber, velocity, randValue))
+			{
+				if (auto* freeVoice = allocateVoice(*region, noteNumber, timestamp))
+					freeVoice->startVoiceWithNote(*region, channel, noteNumber, velocity, timestamp);
+			}
 		}
-		
 	}
 
-	for (auto& voice: voices)
-		voice.registerNoteOff(channel, noteNumber, velocity, timestamp);
+	for (auto* voice: activeVoices)
+		voice->registerNoteOff(channel, noteNumber, velocity, timestamp);
 }
 
 void SfzSynth::registerCC(int channel, int ccNumber, uint8_t ccValue, int timestamp)
@@ -452,24 +951,66 @@ void SfzSynth::registerCC(int channel, int ccNumber, uint8_t ccValue, int timest
 	{
 		if (region.registerCC(channel, ccNumber, ccValue))
 		{
-			auto freeVoice = std::find_if(voices.begin(), voices.end(), [](auto& voice) { return voice.isFree(); });
-			if (freeVoice != end(voices))
+			if (auto* freeVoice = allocateVoice(region, {}, timestamp))
 				freeVoice->startVoiceWithCC(region, channel, ccNumber, ccValue, timestamp);
 		}		
 	}
 
-	for (auto& voice: voices)
-		voice.registerCC(channel, ccNumber, ccValue, timestamp);
+	for (auto* voice: activeVoices)
+		voice->registerCC(channel, ccNumber, ccValue, timestamp);
 }
 
 void SfzSynth::renderNextBlock(AudioBuffer<float>& outputAudio, int startSample, int numSamples)
 {
-	// Render all the voices
-	for (auto& voice: voices)
+	// Render the active voices; idle ones would only add silence
+	const bool parallel = renderPool.getNumThreads() > 0 && static_cast<int>(activeVoices.size()) >= config::parallelRenderThreshold;
+	if (oversamplingFactor > 1)
+	{
+		// Oversampled voices are decimated together, a batch at a time
+		playingBatches.clear();
+		for (auto& batch: voiceBatches)
+		{
+			if (batch->isPlaying())
+				playingBatches.push_back(batch.get());
+		}
+
+		if (parallel)
+		{
+			renderPool.render(playingBatches, outputAudio, startSample, numSamples);
+		}
+		else
+		{
+			for (auto* batch: playingBatches)
+				batch->renderNextBlock(outputAudio, tempBuffer, startSample, numSamples);
+		}
+	}
+	else if (parallel)
+	{
+		renderPool.render(activeVoices, outputAudio, startSample, numSamples);
+	}
+	else
+	{
+		const auto& kernels = SfzSimd::getKernels();
+		for (auto* voice: activeVoices)
+		{
+			voice->renderNextBlock(tempBuffer, startSample, numSamples);
+			for (int channelIdx = 0; channelIdx < config::numChannels; ++channelIdx)
+				kernels.add(outputAudio.getWritePointer(channelIdx, startSample), tempBuffer.getReadPointer(channelIdx, startSample), numSamples);
+		}
+	}
+
+	collectFreeVoices();
+	// The other threads cannot walk the voice lists, they read these instead
+	numActiveVoicesInLastBlock.store(getNumActiveVoices(), std::memory_order_relaxed);
+	numStolenVoicesInLastBlock.store(getNumStolenVoices(), std::memory_order_relaxed);
+}
+
+void SfzSynth::releaseAllVoices(int timestamp) noexcept
+{
+	for (auto* voice: activeVoices)
 	{
-		voice.renderNextBlock(tempBuffer, startSample, numSamples);
-		for (int channelIdx = 0; channelIdx < config::numChannels; ++channelIdx)
-			outputAudio.addFrom(channelIdx, startSample, tempBuffer, channelIdx, startSample, numSamples);
+		if (voice->isPlaying())
+			voice->release(timestamp);
 	}
 }
 
@@ -478,8 +1019,8 @@ void SfzSynth::registerPitchWheel(int channel, int pitch, int timestamp)
 	for (auto& region: regions)
 		region.registerPitchWheel(channel, pitch);
 	
-	for (auto& voice: voices)
-		voice.registerPitchWheel(channel, pitch, timestamp);
+	for (auto* voice: activeVoices)
+		voice->registerPitchWheel(channel, pitch, timestamp);
 }
 
 void SfzSynth::registerAftertouch(int channel, uint8_t aftertouch, int timestamp)
@@ -487,8 +1028,8 @@ void SfzSynth::registerAftertouch(int channel, uint8_t aftertouch, int timestamp
 	for (auto& region: regions)
 		region.registerAftertouch(channel, aftertouch);
 
-	for (auto& voice: voices)
-		voice.registerAftertouch(channel, aftertouch, timestamp);
+	for (auto* voice: activeVoices)
+		voice->registerAftertouch(channel, aftertouch, timestamp);
 }
 
 void SfzSynth::registerTempo(float secondsPerQuarter, int timestamp [[maybe_unused]])
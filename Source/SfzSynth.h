@@ -25,11 +25,16 @@
 #include "SfzGlobals.h"
 #include "SfzRegion.h"
 #include "SfzVoice.h"
+#include <array>
+#include <atomic>
 #include <vector>
-#include <list>
+#include <memory>
 #include <algorithm>
 #include <filesystem>
 #include "SfzFilePool.h"
+#include "SfzInstrumentCache.h"
+#include "SfzRenderPool.h"
+#include "SfzVoiceBatch.h"
 
 class SfzSynth
 {
@@ -37,8 +42,34 @@ public:
     SfzSynth();
     ~SfzSynth();
     bool loadSfzFile(const std::filesystem::path &file);
+    // Sets the polyphony; config::voiceHeadroom more voices are allocated to fade out stolen voices
     void initalizeVoices(int numVoices = config::numVoices);
+    int getMaxPolyphony() const { return maxPolyphony; }
+    void setStealingPolicy(SfzStealingPolicy policy) { stealingPolicy = policy; }
+    SfzStealingPolicy getStealingPolicy() const { return stealingPolicy; }
     void clear();
+    // Opt-in: when set, parsed instruments are cached in this directory and reloaded from there while still valid.
+    // The sample metadata index of each sample directory is also kept there.
+    void setInstrumentCacheDirectory(const File& directory) { instrumentCacheDirectory = directory; }
+    bool wasLoadedFromCache() const { return loadedFromCache; }
+    // Sample headers parsed because the metadata was neither in the instrument cache nor in the sample index
+    int getNumMetadataReads() const { return filePool.getNumMetadataReads(); }
+    // The decoded sample cache is shared by every synth in the process
+    void setSampleCacheBudget(size_t bytes) { filePool.getSampleCache().setMemoryBudget(bytes); }
+    // Sample memory freed by the collector thread rather than by the audio or loading threads
+    size_t getReclaimedBytes() { return filePool.getGarbageCollector().getReclaimedBytes(); }
+    // Worker threads helping the audio thread render the voices; 0 renders everything on the audio thread.
+    // Do not call this while rendering.
+    void setNumRenderThreads(int numThreads) { renderPool.setNumThreads(numThreads); }
+    int getNumRenderThreads() const { return renderPool.getNumThreads(); }
+    // Streams samples and frees voices on the rendering thread instead of the loading threads. This is only
+    // useful for offline rendering, where the output should not depend on the speed of the disk.
+    void setSynchronousLoading(bool synchronous);
+    // Renders the voices at 2 or 4 times the output rate and decimates them, which removes most of the
+    // aliasing when samples are pitched up, at 2 to 4 times the voice cost. Mostly meant for offline renders.
+    // 1 disables oversampling. Do not call this while rendering.
+    void setOversamplingFactor(int factor);
+    int getOversamplingFactor() const { return oversamplingFactor; }
 
     void prepareToPlay(double sampleRate, int samplesPerBlock);
     void registerNoteOn(int channel, int noteNumber, uint8_t velocity, int timestamp);
@@ -48,6 +79,8 @@ public:
     void registerAftertouch(int channel, uint8_t aftertouch, int timestamp);
     void registerTempo(float secondsPerQuarter, int timestamp);
     void renderNextBlock(AudioBuffer<float>& outputAudio, int startSample, int numSamples);
+    // Starts the release of every playing voice, e.g. before this synth is swapped out
+    void releaseAllVoices(int timestamp) noexcept;
     
     int getNumRegions() const { return static_cast<int>(regions.size()); }
     int getNumGroups() const { return numGroups; }
@@ -55,10 +88,18 @@ public:
     StringArray getUnknownOpcodes() const;
     StringArray getCCLabels() const;
     const SfzRegion* getRegionView(int num) const;
+    // Audio thread only, the voice lists change as notes come in
     inline int getNumActiveVoices() const
     { 
-        return static_cast<int>(std::count_if(voices.cbegin(), voices.cend(), [](const auto& voice) { return voice.isPlaying(); })); 
+        return static_cast<int>(std::count_if(activeVoices.cbegin(), activeVoices.cend(), [](const auto* voice) { return voice->isPlaying(); })); 
     }
+    inline int getNumStolenVoices() const
+    {
+        return static_cast<int>(std::count_if(activeVoices.cbegin(), activeVoices.cend(), [](const auto* voice) { return voice->isPlaying() && voice->isStolen(); }));
+    }
+    // Any thread: the counts at the end of the last rendered block
+    int getNumActiveVoicesInLastBlock() const noexcept { return numActiveVoicesInLastBlock.load(std::memory_order_relaxed); }
+    int getNumStolenVoicesInLastBlock() const noexcept { return numStolenVoicesInLastBlock.load(std::memory_order_relaxed); }
     std::map<std::string, std::string> getDefines() const { return defines; }
     std::vector<std::string> getIncludedFiles() const
     {
@@ -76,18 +117,52 @@ private:
     AudioBuffer<float> tempBuffer;
     int numGroups { 0 };
     int numMasters { 0 };
-    ThreadPool fileLoadingPool { config::numLoadingThreads };
+    SfzBackgroundLoader backgroundLoader { config::numLoadingThreads };
     void readSfzFile(const std::filesystem::path& fileName, std::vector<std::string>& lines) noexcept;
     SfzFilePool filePool { File::getCurrentWorkingDirectory() };
     double sampleRate { config::defaultSampleRate };
     int samplesPerBlock { config::defaultSamplesPerBlock };
-    std::list<SfzVoice> voices;
+    // Voices are not movable (the background loader refers to them) so the array holds pointers. Every voice
+    // is either in the free stack or in the active list; voices that went idle in the background
+    // are moved back to the free stack by collectFreeVoices().
+    std::vector<std::unique_ptr<SfzVoice>> voices;
+    std::vector<SfzVoice*> freeVoices;
+    std::vector<SfzVoice*> activeVoices;
+    int maxPolyphony { config::numVoices };
+    SfzStealingPolicy stealingPolicy { SfzStealingPolicy::oldest };
+    uint64_t voiceTriggerCounter { 0 };
+    SfzRenderPool renderPool;
+    std::atomic<int> numActiveVoicesInLastBlock { 0 };
+    std::atomic<int> numStolenVoicesInLastBlock { 0 };
+    // Only used when oversampling; see prepareVoiceBatches()
+    std::vector<std::unique_ptr<SfzVoiceBatch>> voiceBatches;
+    std::vector<SfzVoiceBatch*> playingBatches;
+    bool synchronousLoading { false };
+    int oversamplingFactor { 1 };
     std::vector<SfzRegion> regions;
+    // For each note number, the regions whose key or keyswitch range contains it, in file order
+    std::array<std::vector<SfzRegion*>, 128> noteRegions;
     std::vector<std::filesystem::path> includedFiles;
     CCValueArray ccState;
     std::vector<CCNamePair> ccNames;
     std::map<std::string, std::string> defines;
+    File instrumentCacheDirectory {};
+    bool loadedFromCache { false };
 
+    // Reads the metadata and preloads every sample, in parallel, before the regions are prepared
+    void loadSamples();
+    void prepareRegions(std::optional<uint8_t> defaultSwitch);
+    void buildNoteIndex();
+    SfzVoice* findFreeVoice() noexcept;
+    SfzVoice* allocateVoice(const SfzRegion& region, std::optional<int> noteNumber, int timestamp) noexcept;
+    template<class Predicate>
+    void enforcePolyphony(uint32_t limit, std::optional<int> noteNumber, int timestamp, Predicate&& isCandidate) noexcept;
+    template<class Predicate>
+    SfzVoice* selectVoiceToSteal(std::optional<int> noteNumber, Predicate&& isCandidate) const noexcept;
+    void collectFreeVoices() noexcept;
+    void prepareVoiceBatches();
+    bool loadFromCache(const File& cacheFile);
+    void writeCache(const File& cacheFile, const File& sfzFile, std::optional<uint8_t> defaultSwitch, const SfzCacheWriter& regionOpcodes);
     void resetMidiState();
     void checkRegionsForActivation(const MidiMessage& msg, int timestamp);
     
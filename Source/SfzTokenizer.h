@@ -0,0 +1,162 @@
+/*
+    ==============================================================================
+
+    Copyright 2019 - Paul Ferrand (paulfd@outlook.fr)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    ==============================================================================
+*/
+
+#pragma once
+#include <string_view>
+#include <algorithm>
+
+enum class SfzTokenType { header, member, end };
+
+struct SfzToken
+{
+    SfzTokenType type { SfzTokenType::end };
+    std::string_view header {};
+    std::string_view opcode {};
+    std::string_view value {};
+};
+
+/**
+ * Single pass lexer over a (comment-free, define-expanded) sfz string.
+ *
+ * The tokens are views into the source string so it has to outlive the tokenizer;
+ * nothing is allocated. On values made of the characters accepted by SfzRegexes::members,
+ * separated by whitespace, the behavior follows the SfzRegexes::headers and SfzRegexes::members
+ * expressions it replaces: anything before the first header is ignored, and a member value
+ * runs until the next opcode or header and is trimmed.
+ *
+ * Members with a blank value are always skipped, whereas the regex kept them with an empty
+ * value when two whitespace characters or more followed the equal sign.
+ * Values are also deliberately more lenient than the regex: they may hold any character except
+ * '<' and '=', so that sample paths with '&', '+', non-ASCII bytes and the like are kept whole,
+ * where the regex cuts the value at the first such character or drops the member when it
+ * starts with one. In the same way a non-whitespace character right before the next opcode
+ * (as in "a=1.b=2") stays in the value, where the regex drops it.
+ */
+class SfzTokenizer
+{
+public:
+    SfzTokenizer(std::string_view source) noexcept
+    : source(source) { }
+
+    SfzToken next() noexcept
+    {
+        while (position < source.size())
+        {
+            const char c = source[position];
+            if (c == '<')
+            {
+                const auto headerEnd = source.find('>', position + 1);
+                if (headerEnd == source.npos)
+                {
+                    // Unterminated header: nothing else can match
+                    position = source.size();
+                    break;
+                }
+
+                SfzToken token { SfzTokenType::header };
+                token.header = source.substr(position + 1, headerEnd - position - 1);
+                position = headerEnd + 1;
+                insideHeader = true;
+                return token;
+            }
+
+            if (!insideHeader)
+            {
+                const auto nextHeader = source.find('<', position);
+                position = nextHeader == source.npos ? source.size() : nextHeader;
+                continue;
+            }
+
+            if (c != '=')
+            {
+                position++;
+                continue;
+            }
+
+            // Found an equal sign: the opcode is the identifier right before it
+            const auto opcodeEnd = position;
+            const auto opcodeStart = identifierStart(opcodeEnd);
+            const auto valueStart = position + 1;
+            const auto valueEnd = findValueEnd(valueStart);
+            position = valueEnd;
+
+            if (opcodeStart == opcodeEnd)
+                continue;
+
+            auto value = trimmed(source.substr(valueStart, valueEnd - valueStart));
+            if (value.empty())
+                continue;
+
+            SfzToken token { SfzTokenType::member };
+            token.opcode = source.substr(opcodeStart, opcodeEnd - opcodeStart);
+            token.value = value;
+            return token;
+        }
+
+        return {};
+    }
+
+    static bool isIdentifierCharacter(char c) noexcept
+    {
+        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+    }
+
+    static bool isWhitespace(char c) noexcept
+    {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n' || c == '\f' || c == '\v';
+    }
+
+private:
+    std::string_view source;
+    std::string_view::size_type position { 0 };
+    bool insideHeader { false };
+
+    std::string_view::size_type identifierStart(std::string_view::size_type end) const noexcept
+    {
+        auto start = end;
+        while (start > 0 && isIdentifierCharacter(source[start - 1]))
+            start--;
+        return start;
+    }
+
+    // The value stops at the next header, or at the start of the opcode owning the next equal sign
+    std::string_view::size_type findValueEnd(std::string_view::size_type start) const noexcept
+    {
+        for (auto idx = start; idx < source.size(); ++idx)
+        {
+            if (source[idx] == '<')
+                return idx;
+
+            if (source[idx] == '=')
+                return std::max(identifierStart(idx), start);
+        }
+        return source.size();
+    }
+
+    static std::string_view trimmed(std::string_view s) noexcept
+    {
+        while (!s.empty() && isWhitespace(s.front()))
+            s.remove_prefix(1);
+        while (!s.empty() && isWhitespace(s.back()))
+            s.remove_suffix(1);
+        return s;
+    }
+};
@@ -20,10 +20,11 @@
 */
 
 #include "SfzVoice.h"
+#include "SfzInterpolation.h"
+#include "SfzSimdDispatch.h"
 
-SfzVoice::SfzVoice(ThreadPool& fileLoadingPool, SfzFilePool& filePool, const CCValueArray& ccState)
-: ThreadPoolJob( "SfzVoice" )
-, fileLoadingPool(fileLoadingPool)
+SfzVoice::SfzVoice(SfzBackgroundLoader& backgroundLoader, SfzFilePool& filePool, const CCValueArray& ccState)
+: backgroundLoader(backgroundLoader)
 , filePool(filePool)
 , ccState(ccState)
 {
@@ -31,8 +32,7 @@ SfzVoice::SfzVoice(ThreadPool& fileLoadingPool, SfzFilePool& filePool, const CCV
 
 SfzVoice::~SfzVoice() noexcept
 {
-    if (fileLoadingPool.contains(this))
-        fileLoadingPool.removeJob(this, true, 100);
+    backgroundLoader.waitForJob(*this);
 }
 
 void SfzVoice::release(int timestamp, bool useFastRelease) noexcept
@@ -47,22 +47,22 @@ void SfzVoice::release(int timestamp, bool useFastRelease) noexcept
 
 void SfzVoice::startVoiceWithNote(SfzRegion& newRegion, int channel, int noteNumber, uint8_t velocity, int sampleDelay) noexcept
 {
-    commonStartVoice(newRegion, sampleDelay);
+    commonStartVoice(newRegion, sampleDelay, newRegion.getBasePitchVariation(noteNumber, velocity));
     triggeringNoteNumber = noteNumber;
     triggeringChannel = channel;
-    pitchRatio = region->getBasePitchVariation(noteNumber, velocity);
     baseGain *= region->getNoteGain(noteNumber, velocity);
     amplitudeEGEnvelope.prepare(region->amplitudeEG, ccState, velocity, sampleDelay);
 }
 
 void SfzVoice::startVoiceWithCC(SfzRegion& newRegion, int channel, int ccNumber, uint8_t ccValue [[maybe_unused]], int sampleDelay) noexcept
 {
-    commonStartVoice(newRegion, sampleDelay);
+    // No note: play at the pitch center
+    commonStartVoice(newRegion, sampleDelay, newRegion.getBasePitchVariation(newRegion.pitchKeycenter, 0));
     triggeringCCNumber = ccNumber;
     triggeringChannel = channel;
 }
 
-void SfzVoice::commonStartVoice(SfzRegion& newRegion, int sampleDelay) noexcept
+void SfzVoice::commonStartVoice(SfzRegion& newRegion, int sampleDelay, float newPitchRatio) noexcept
 {
     // The voice should be idling!
     jassert(state == SfzVoiceState::idle);
@@ -79,14 +79,37 @@ void SfzVoice::commonStartVoice(SfzRegion& newRegion, int sampleDelay) noexcept
 
     region = &newRegion;
     noteIsOff = false;
+    stolen = false;
+    currentLevel = 1.0f;
     state = SfzVoiceState::playing;
 
-    // Compute the resampling ratio for this region
-    speedRatio = static_cast<float>(region->sampleRate / this->sampleRate);
+    // Compute the resampling ratio for this region, at the rate the voice renders
+    const auto renderSampleRate = this->sampleRate * oversamplingFactor;
+    speedRatio = static_cast<float>(region->sampleRate / renderSampleRate);
+    pitchRatio = newPitchRatio;
 
     // Compute the base amplitude gain
     baseGain = region->getBaseGain();
 
+    // Mono samples and generators render one channel, which is spread over the stereo pair at the end
+    numRenderedChannels = (region->isGenerator() || region->numChannels == 1) ? 1 : config::numChannels;
+    leftPanGain = 1.0f;
+    rightPanGain = 1.0f;
+    if (numRenderedChannels == 1 && region->pan != 0.0f)
+    {
+        // Scaled so that the gains are 1 in the center, as when the channel was simply duplicated
+        leftPanGain = MathConstants<float>::sqrt2;
+        rightPanGain = MathConstants<float>::sqrt2;
+        applyPanToSample(region->pan, leftPanGain, rightPanGain);
+    }
+
+    if (region->isGenerator())
+    {
+        const auto frequency = MidiMessage::getMidiNoteInHertz(region->pitchKeycenter) * pitchRatio;
+        const auto waveform = SfzOscillator::waveformFromName(region->sample.toRawUTF8());
+        oscillator.prepare(waveform, frequency, renderSampleRate, static_cast<uint32_t>(Random::getSystemRandom().nextInt()));
+    }
+
     // Initialize the CC envelopes
     if (region->amplitudeCC)
     {
@@ -108,13 +131,50 @@ void SfzVoice::commonStartVoice(SfzRegion& newRegion, int sampleDelay) noexcept
         initialDelay += secondsToSamples(region->delay);
     if (region->delayRandom > 0)
         initialDelay += Random::getSystemRandom().nextInt(secondsToSamples(region->delayRandom));
+    // The delay is counted in rendered frames
+    initialDelay *= oversamplingFactor;
+    decimatorResetPending = true;
     
-    preloadedData = filePool.getPreloadedData(region->sample);
-    if (preloadedData == nullptr)
+    // The preloaded window starts at or before the region offset, not necessarily at the file start
+    const auto preloadWindow = filePool.getPreloadedData(region->sample, sourcePosition);
+    if (preloadWindow.data == nullptr)
         return;
 
+    preloadedData = preloadWindow.data;
+    preloadStart = preloadWindow.start;
+
+    // Samples that fit in the preloaded window are played from there directly, as long as looping
+    // does not jump back before the window
+    const auto endOrLoopEnd = static_cast<int64>(jmin(region->sampleEnd, region->loopRange.getEnd()));
+    const auto loopStart = static_cast<int64>(region->loopRange.getStart());
+    const bool canWrap = region->shouldLoop() || region->sampleCount;
+    if (endOrLoopEnd <= preloadWindow.getEnd() && (!canWrap || loopStart >= preloadStart))
+    {
+        fileData = preloadedData;
+        fileDataStart = static_cast<int>(preloadStart);
+        fileRenderer = selectFileRenderer(*fileData);
+        dataReady = true;
+        return;
+    }
+
+    // Otherwise stream the rest of the file, starting where the preloaded window ends.
+    // Playback positions match the file positions until the first loop jump.
+    streaming = true;
+    streamRenderer = selectStreamRenderer();
+    streamStart = jmin(preloadWindow.getEnd(), endOrLoopEnd);
+    streamReadPosition = streamStart;
+    streamWritePosition = streamStart;
+
+    const auto loopLength = endOrLoopEnd - loopStart;
+    if (region->shouldLoop() && loopLength > 0)
+        streamLength.reset();
+    else if (region->sampleCount && loopLength > 0)
+        streamLength = endOrLoopEnd + (jmax<int64>(*region->sampleCount, 1) - 1) * loopLength;
+    else
+        streamLength = endOrLoopEnd;
+
     // Schedule a callback in the background thread
-    fileLoadingPool.addJob(this, false);
+    scheduleJob();
 }
 
 void SfzVoice::registerNoteOff(int channel, int noteNumber, uint8_t velocity [[maybe_unused]], int timestamp) noexcept
@@ -171,53 +231,100 @@ void SfzVoice::registerCC(int channel, int ccNumber, uint8_t ccValue, int timest
         widthEnvelope.addEvent(timestamp, ccValue);
 }
 
-ThreadPoolJob::JobStatus SfzVoice::runJob()
+void SfzVoice::runBackgroundJob()
 {
     if (state == SfzVoiceState::idle)
-        return ThreadPoolJob::jobHasFinished;
+        return;
 
     if (region == nullptr)
-        return ThreadPoolJob::jobHasFinished;
+        return;
 
     // Normal case: the voice has ended, free up memory and reset the state
-    if (state == SfzVoiceState::release)
+    if (releaseFinished)
     {
+        streamReader.reset();
         reset();
-        return ThreadPoolJob::jobHasFinished;
+        return;
     }
     
-    // From here on we load a sample file: generators don't need to do this.
-    if (region->isGenerator())
-        return ThreadPoolJob::jobHasFinished;
-
-    // TODO: do a switch here?
-    // Normal case: we are not releasing so we are playing
-    
-    const uint32_t endOrLoopEnd = std::min(region->sampleEnd, region->loopRange.getEnd());
-    // A >2 gb sample file is a bit unreasonable, but it will cause serious issues
-    jassert(endOrLoopEnd <= std::numeric_limits<int>::max());
-    const int numSamples = static_cast<int>(endOrLoopEnd);
+    // Otherwise we are playing and possibly need to stream more of the sample
+    if (streaming)
+        fillStreamBuffer();
+}
 
-    
-    if (numSamples <= preloadedData->getNumSamples())
+void SfzVoice::scheduleJob() noexcept
+{
+    if (synchronousLoading)
     {
-        fileData = preloadedData;
+        runBackgroundJob();
+        return;
     }
-    else
+
+    backgroundLoader.request(*this);
+}
+
+bool SfzVoice::streamFullyRead() const noexcept
+{
+    return streamLength && streamWritePosition.load() >= *streamLength;
+}
+
+void SfzVoice::fillStreamBuffer()
+{
+    // Before streaming anything, play the whole sample from the shared cache if it holds it already
+    if (streamWritePosition.load() == streamStart && region->sampleMetadata)
     {
-        fileData = std::make_shared<AudioBuffer<float>>(config::numChannels, numSamples);
-        auto reader = filePool.createReaderFor(region->sample);
-        // We should not have a null reader here, something is wrong
-        if (reader == nullptr) // still null
+        if (auto decodedSample = filePool.getDecodedSample(region->sample, *region->sampleMetadata))
         {
-            DBG("Could not create reader: something is wrong with the sample " << region->sample);
-            return ThreadPoolJob::jobHasFinished;
+            fileRenderer = selectFileRenderer(*decodedSample);
+            fileData = std::move(decodedSample);
+            fileDataStart = 0;
+            dataReady = true;
+            return;
         }
-        reader->read(fileData.get(), 0, numSamples, 0, true, true);
     }
 
-    dataReady = true;
-    return ThreadPoolJob::jobHasFinished;
+    const auto sampleFile = filePool.getSampleFile(region->sample);
+    if (streamReader == nullptr || streamReaderFile != sampleFile)
+    {
+        streamReader = filePool.createReaderFor(region->sample);
+        streamReaderFile = sampleFile;
+    }
+
+    // We should not have a null reader here, something is wrong
+    if (streamReader == nullptr)
+    {
+        DBG("Could not create reader: something is wrong with the sample " << region->sample);
+        return;
+    }
+
+    const auto endOrLoopEnd = static_cast<int64>(jmin(region->sampleEnd, region->loopRange.getEnd()));
+    const auto loopStart = static_cast<int64>(region->loopRange.getStart());
+    const auto loopLength = endOrLoopEnd - loopStart;
+
+    auto writePosition = streamWritePosition.load();
+    // Never overwrite the frames the voice did not play yet
+    auto lastPosition = streamReadPosition.load() + config::streamBufferSize;
+    if (streamLength)
+        lastPosition = jmin(lastPosition, *streamLength);
+
+    while (writePosition < lastPosition && !releaseFinished)
+    {
+        // Map the playback position back into the file; a read stops at the loop end or at the ring end
+        auto filePosition = writePosition;
+        auto framesUntilJump = endOrLoopEnd - writePosition;
+        if (writePosition >= endOrLoopEnd)
+        {
+            const auto positionInLoop = (writePosition - endOrLoopEnd) % loopLength;
+            filePosition = loopStart + positionInLoop;
+            framesUntilJump = loopLength - positionInLoop;
+        }
+
+        const auto ringIndex = static_cast<int>(writePosition & (config::streamBufferSize - 1));
+        const auto numFrames = static_cast<int>(std::min<int64>({ lastPosition - writePosition, framesUntilJump, config::streamBufferSize - ringIndex, config::streamChunkSize }));
+        streamReader->read(&streamBuffer, ringIndex, numFrames, filePosition, true, true);
+        writePosition += numFrames;
+        streamWritePosition.store(writePosition);
+    }
 }
 
 void SfzVoice::prepareToPlay(double newSampleRate, int newSamplesPerBlock)
@@ -227,6 +334,7 @@ void SfzVoice::prepareToPlay(double newSampleRate, int newSamplesPerBlock)
     amplitudeEGEnvelope.setSampleRate(newSampleRate);
     tempBlock1 = dsp::AudioBlock<float>(tempHeapBlock1, config::numChannels, newSamplesPerBlock);
     tempBlock2 = dsp::AudioBlock<float>(tempHeapBlock2, config::numChannels, newSamplesPerBlock);
+    oversampledBlock = dsp::AudioBlock<float>(oversampledHeapBlock, config::numChannels, static_cast<size_t>(newSamplesPerBlock * oversamplingFactor));
     amplitudeEnvelope.reserve(newSamplesPerBlock);
     panEnvelope.reserve(newSamplesPerBlock);
     positionEnvelope.reserve(newSamplesPerBlock);
@@ -234,6 +342,25 @@ void SfzVoice::prepareToPlay(double newSampleRate, int newSamplesPerBlock)
     reset();
 }
 
+void SfzVoice::setOversamplingFactor(int factor)
+{
+    jassert(SfzOversampling::isValidFactor(factor));
+    oversamplingFactor = SfzOversampling::isValidFactor(factor) ? factor : 1;
+    oversampledBlock = dsp::AudioBlock<float>(oversampledHeapBlock, config::numChannels, static_cast<size_t>(samplesPerBlock * oversamplingFactor));
+}
+
+void SfzVoice::releaseAtRenderedFrame(int frame) noexcept
+{
+    // The envelopes run at the output rate
+    release(frame / oversamplingFactor);
+}
+
+void SfzVoice::steal(int timestamp) noexcept
+{
+    stolen = true;
+    release(timestamp, true);
+}
+
 bool SfzVoice::checkOffGroup(uint32_t group, int timestamp) noexcept
 {
     if (region != nullptr && region->offBy && *region->offBy == group)
@@ -247,18 +374,46 @@ bool SfzVoice::checkOffGroup(uint32_t group, int timestamp) noexcept
 
 void SfzVoice::fillGenerator(dsp::AudioBlock<float> block) noexcept
 {
-    if (region->sample == "*silence")
-    {
-        block.clear();
-    }
-    else if (region->sample == "*sine")
-    {
-        const auto frequency = MathConstants<float>::twoPi * MidiMessage::getMidiNoteInHertz(region->pitchKeycenter) * pitchRatio;
+    // Generators render a single channel
+    oscillator.render(block.getChannelPointer(0), static_cast<int>(block.getNumSamples()));
+}
 
-        for (int chanIdx = 0; chanIdx < config::numChannels; chanIdx++)
-            for(int sampleIdx = 0; sampleIdx < block.getNumSamples(); sampleIdx++)
-                block.setSample(chanIdx, sampleIdx, static_cast<float>(std::sin(frequency * sourcePosition++ / sampleRate)));
-    }
+bool SfzVoice::isUnityRatio() const noexcept
+{
+    // Common for drums and one-shots played at their root key and the file sample rate
+    return speedRatio * pitchRatio == 1.0f;
+}
+
+template<class T>
+SfzVoice::Renderer SfzVoice::getFileRenderer(bool stereo, bool canWrap, bool unityRatio) noexcept
+{
+    // Indexed by [stereo][canWrap][unityRatio]
+    static constexpr Renderer renderers[2][2][2] {
+        { { &SfzVoice::fillWithFileData<T, 1, false, false>, &SfzVoice::fillWithFileData<T, 1, false, true> },
+          { &SfzVoice::fillWithFileData<T, 1, true, false>, &SfzVoice::fillWithFileData<T, 1, true, true> } },
+        { { &SfzVoice::fillWithFileData<T, 2, false, false>, &SfzVoice::fillWithFileData<T, 2, false, true> },
+          { &SfzVoice::fillWithFileData<T, 2, true, false>, &SfzVoice::fillWithFileData<T, 2, true, true> } }
+    };
+    return renderers[stereo][canWrap][unityRatio];
+}
+
+SfzVoice::Renderer SfzVoice::selectFileRenderer(const SfzSampleBuffer& data) const noexcept
+{
+    const bool stereo { numRenderedChannels > 1 };
+    const bool canWrap { region->shouldLoop() || region->sampleCount };
+    return SfzSampleBuffer::withSampleType(data.getFormat(), [&](auto sampleType) {
+        return getFileRenderer<decltype(sampleType)>(stereo, canWrap, isUnityRatio());
+    });
+}
+
+SfzVoice::Renderer SfzVoice::selectStreamRenderer() const noexcept
+{
+    // Indexed by [stereo][unityRatio]; the loops are already unrolled in the ring
+    static constexpr Renderer renderers[2][2] {
+        { &SfzVoice::fillWithStreamedData<1, false>, &SfzVoice::fillWithStreamedData<1, true> },
+        { &SfzVoice::fillWithStreamedData<2, false>, &SfzVoice::fillWithStreamedData<2, true> }
+    };
+    return renderers[numRenderedChannels > 1][isUnityRatio()];
 }
 
 void SfzVoice::fillBlock(dsp::AudioBlock<float> block) noexcept
@@ -276,130 +431,209 @@ void SfzVoice::fillBlock(dsp::AudioBlock<float> block) noexcept
     }
 
     if (region->isGenerator())
+    {
         fillGenerator(block);
+    }
     else if (dataReady)
-        fillWithFileData(block, samplesToClear);
+    {
+        (this->*fileRenderer)(block, samplesToClear);
+    }
+    else if (streaming)
+    {
+        (this->*streamRenderer)(block, samplesToClear);
+    }
     else
-        fillWithPreloadedData(block, samplesToClear);
+    {
+        // The sample could not be preloaded
+        block.clear();
+        releaseAtRenderedFrame(samplesToClear);
+    }
 }
 
+template<class T, int NumChannels, bool CanWrap, bool UnityRatio>
 void SfzVoice::fillWithFileData(dsp::AudioBlock<float> block, int releaseOffset) noexcept
 {
-    auto nextPositionBlock = tempBlock1.getSubBlock(0, block.getNumSamples());
-    auto interpolationBlock = tempBlock2.getSubBlock(0, block.getNumSamples());
-    int nextPosition { 0 };
-    const int lastSample { fileData->getNumSamples() - 1 };
- 
-    for (auto sampleIdx = 0; sampleIdx < block.getNumSamples(); ++sampleIdx)
+    // The file data may start after the beginning of the file: positions here are relative to its first frame.
+    // They always wrap within the file data, so they fit in an int.
+    const int numFrames { static_cast<int>(block.getNumSamples()) };
+    const int lastSample { static_cast<int>(jmin<int64>(fileDataStart + fileData->getNumSamples(), jmin(region->sampleEnd, region->loopRange.getEnd()))) - fileDataStart - 1 };
+    const int loopStart { static_cast<int>(region->loopRange.getStart()) - fileDataStart };
+    int position { static_cast<int>(sourcePosition - fileDataStart) };
+    const float step { speedRatio * pitchRatio };
+    auto shouldWrap = [this]() {
+        if constexpr (CanWrap)
+            return region->shouldLoop() || (region->sampleCount && loopCount < *region->sampleCount);
+        else
+            return false;
+    };
+
+    const T* source[NumChannels];
+    float* output[NumChannels];
+    for (auto chanIdx = 0; chanIdx < NumChannels; ++chanIdx)
+        source[chanIdx] = fileData->getReadPointer<T>(chanIdx);
+
+    int frameIdx { 0 };
+    while (frameIdx < numFrames)
     {
-        if (sourcePosition > lastSample)
+        if (position > lastSample)
         {
-            const int overflow { sourcePosition - lastSample - 1};
-            if (region->shouldLoop())
+            const int loopLength { lastSample + 1 - loopStart };
+            if (!shouldWrap() || loopLength <= 0)
             {
-                sourcePosition = region->loopRange.getStart() + overflow;
-                nextPosition = sourcePosition + 1;
+                block.getSubBlock(frameIdx).clear();
+                releaseAtRenderedFrame(frameIdx + releaseOffset);
+                sourcePosition = fileDataStart + position;
+                return;
             }
-            else if (region->sampleCount && loopCount < *region->sampleCount)
-            {
-                // We're looping and counting, restart the source position
+
+            // We're looping and possibly counting, restart the source position
+            if (!region->shouldLoop())
                 loopCount += 1;
-                sourcePosition = region->loopRange.getStart() + overflow;
-                nextPosition = sourcePosition + 1;
-            }
-            else
-            {
-                block.getSubBlock(sampleIdx).clear();
-                nextPositionBlock.getSubBlock(sampleIdx).clear();
-                interpolationBlock.getSubBlock(sampleIdx).clear();
-                release(sampleIdx + releaseOffset);
-                break;
-            }
+            position = loopStart + (position - lastSample - 1) % loopLength;
         }
-        else if (sourcePosition == lastSample)
+
+        for (auto chanIdx = 0; chanIdx < NumChannels; ++chanIdx)
+            output[chanIdx] = block.getChannelPointer(chanIdx) + frameIdx;
+
+        if constexpr (UnityRatio)
         {
-            if (region->shouldLoop())
-            {
-                nextPosition = region->loopRange.getStart();
-            }
-            else if (region->sampleCount && loopCount < *region->sampleCount)
-            {
-                loopCount += 1;
-                nextPosition = region->loopRange.getStart();
-            }
-            else
-            {
-                block.getSubBlock(sampleIdx).clear();
-                nextPositionBlock.getSubBlock(sampleIdx).clear();
-                interpolationBlock.getSubBlock(sampleIdx).clear();
-                release(sampleIdx + releaseOffset);
-                return;
-            }
+            // At unit speed every frame up to the last sample is played as it is
+            const int runLength = jmin(lastSample + 1 - position, numFrames - frameIdx);
+            SfzInterpolation::copy(source, output, NumChannels, position, runLength);
+            position += runLength;
+            frameIdx += runLength;
+            continue;
         }
-        else
+
+        // Interpolate the contiguous part in one go
+        const int runLength = SfzInterpolation::framesInRun(position, decimalPosition, step, lastSample, numFrames - frameIdx);
+        if (runLength > 0)
         {
-            nextPosition = sourcePosition + 1;
+            SfzInterpolation::linear(source, output, NumChannels, position, decimalPosition, step, runLength);
+            SfzInterpolation::advance(position, decimalPosition, step, runLength);
+            frameIdx += runLength;
+            continue;
         }
 
-        for (auto chanIdx = 0; chanIdx < config::numChannels; ++chanIdx)
+        // Boundary frames: the next source frame may be the loop start
+        int nextPosition { position + 1 };
+        if (nextPosition > lastSample)
         {
-            block.setSample(chanIdx, sampleIdx, fileData->getSample(chanIdx, sourcePosition));
-            nextPositionBlock.setSample(chanIdx, sampleIdx, fileData->getSample(chanIdx, nextPosition));
-            interpolationBlock.setSample(chanIdx, sampleIdx, decimalPosition);
+            if (!shouldWrap())
+            {
+                block.getSubBlock(frameIdx).clear();
+                releaseAtRenderedFrame(frameIdx + releaseOffset);
+                sourcePosition = fileDataStart + position;
+                return;
+            }
+            nextPosition = loopStart;
         }
 
-        decimalPosition += speedRatio * pitchRatio;
-        const auto sampleStep = static_cast<int>(decimalPosition);
-        sourcePosition += sampleStep;
-        decimalPosition -= sampleStep;
+        for (auto chanIdx = 0; chanIdx < NumChannels; ++chanIdx)
+        {
+            const auto current = SfzSampleTraits<T>::toFloat(source[chanIdx][position]);
+            const auto next = SfzSampleTraits<T>::toFloat(source[chanIdx][nextPosition]);
+            block.setSample(chanIdx, frameIdx, current + decimalPosition * (next - current));
+        }
+        SfzInterpolation::advance(position, decimalPosition, step, 1);
+        frameIdx++;
     }
 
-    nextPositionBlock.multiplyBy(interpolationBlock);
-    interpolationBlock.negate().add(1.0f);
-    block.multiplyBy(interpolationBlock).add(nextPositionBlock);
+    sourcePosition = fileDataStart + position;
 }
 
-void SfzVoice::fillWithPreloadedData(dsp::AudioBlock<float> block, int releaseOffset) noexcept
+template<int NumChannels, bool UnityRatio>
+void SfzVoice::fillWithStreamedData(dsp::AudioBlock<float> block, int releaseOffset) noexcept
 {
-    auto nextPositionBlock = tempBlock1.getSubBlock(0, block.getNumSamples());
-    auto interpolationBlock = tempBlock2.getSubBlock(0, block.getNumSamples());
-    int nextPosition { 0 };
+    const int numFrames { static_cast<int>(block.getNumSamples()) };
+    const float step { speedRatio * pitchRatio };
+    const auto availablePosition = streamWritePosition.load();
+    const auto lastValidPosition = (streamLength ? jmin(availablePosition, *streamLength) : availablePosition) - 1;
+
+    auto getFrame = [this](int channel, int64 position) {
+        if (position < streamStart)
+            return preloadedData->getSample(channel, static_cast<int>(position - preloadStart));
+        return streamBuffer.getSample(channel, static_cast<int>(position & (config::streamBufferSize - 1)));
+    };
+
+    const float* source[NumChannels];
+    float* output[NumChannels];
 
-    const auto endOrLoopEnd = static_cast<int>(jmin(region->sampleEnd, region->loopRange.getEnd()));
-    const auto lastValidSample = jmin(preloadedData->getNumSamples(), endOrLoopEnd) - 1;
-    for (auto sampleIdx = 0; sampleIdx < block.getNumSamples(); ++sampleIdx)
+    int frameIdx { 0 };
+    while (frameIdx < numFrames)
     {
-        // We need these because the preloaded data may be reused for multiple samples...
-        if ( sourcePosition >= lastValidSample)
+        const int64 nextPosition { sourcePosition + 1 };
+        // At unit speed the frames are copied, otherwise they are interpolated with the next one
+        const int64 lastNeededPosition { UnityRatio ? sourcePosition : nextPosition };
+        if (lastNeededPosition > lastValidPosition)
         {
-            block.getSubBlock(sampleIdx).clear();
-            nextPositionBlock.getSubBlock(sampleIdx).clear();
-            interpolationBlock.getSubBlock(sampleIdx).clear();
-            // TODO: do we release here?
-            release(sampleIdx + releaseOffset);
+            block.getSubBlock(frameIdx).clear();
+            // Either the sample ended, or the disk did not keep up and we output silence while waiting for the data
+            if (streamLength && lastNeededPosition >= *streamLength)
+                releaseAtRenderedFrame(frameIdx + releaseOffset);
             break;
         }
 
-        nextPosition = sourcePosition + 1;
-        for (auto chanIdx = 0; chanIdx < config::numChannels; ++chanIdx)
+        // Contiguous frames are either in the preloaded data or in the ring up to its wrap point
+        int localIndex { 0 };
+        int localLastIndex { 0 };
+        const bool fromPreloadedData { sourcePosition < streamStart };
+        if (fromPreloadedData)
+        {
+            localIndex = static_cast<int>(sourcePosition - preloadStart);
+            localLastIndex = static_cast<int>(jmin(streamStart - 1, lastValidPosition) - preloadStart);
+        }
+        else
         {
-            block.setSample(chanIdx, sampleIdx, preloadedData->getSample(chanIdx, sourcePosition));
-            nextPositionBlock.setSample(chanIdx, sampleIdx, preloadedData->getSample(chanIdx, nextPosition));
-            interpolationBlock.setSample(chanIdx, sampleIdx, decimalPosition);
+            for (auto chanIdx = 0; chanIdx < NumChannels; ++chanIdx)
+                source[chanIdx] = streamBuffer.getReadPointer(chanIdx);
+            localIndex = static_cast<int>(sourcePosition & (config::streamBufferSize - 1));
+            localLastIndex = static_cast<int>(jmin<int64>(config::streamBufferSize - 1, localIndex + lastValidPosition - sourcePosition));
         }
-        
-        decimalPosition += speedRatio * pitchRatio;
-        const auto sampleStep = static_cast<int>(decimalPosition);
-        sourcePosition += sampleStep;
-        decimalPosition -= sampleStep;
+
+        const int runLength = UnityRatio ? jmin(localLastIndex + 1 - localIndex, numFrames - frameIdx)
+                                         : SfzInterpolation::framesInRun(localIndex, decimalPosition, step, localLastIndex, numFrames - frameIdx);
+        if (runLength > 0)
+        {
+            for (auto chanIdx = 0; chanIdx < NumChannels; ++chanIdx)
+                output[chanIdx] = block.getChannelPointer(chanIdx) + frameIdx;
+            // The preloaded data is kept in the sample format, the ring in floats
+            if constexpr (UnityRatio)
+            {
+                if (fromPreloadedData)
+                    SfzInterpolation::copy(*preloadedData, output, NumChannels, localIndex, runLength);
+                else
+                    SfzInterpolation::copy(source, output, NumChannels, localIndex, runLength);
+            }
+            else
+            {
+                if (fromPreloadedData)
+                    SfzInterpolation::linear(*preloadedData, output, NumChannels, localIndex, decimalPosition, step, runLength);
+                else
+                    SfzInterpolation::linear(source, output, NumChannels, localIndex, decimalPosition, step, runLength);
+            }
+            SfzInterpolation::advance(sourcePosition, decimalPosition, step, runLength);
+            frameIdx += runLength;
+            continue;
+        }
+
+        // Boundary frames between the preloaded data and the ring, or at the ring wrap
+        for (auto chanIdx = 0; chanIdx < NumChannels; ++chanIdx)
+        {
+            const auto current = getFrame(chanIdx, sourcePosition);
+            const auto next = getFrame(chanIdx, nextPosition);
+            block.setSample(chanIdx, frameIdx, current + decimalPosition * (next - current));
+        }
+        SfzInterpolation::advance(sourcePosition, decimalPosition, step, 1);
+        frameIdx++;
     }
 
-    nextPositionBlock.multiplyBy(interpolationBlock);
-    interpolationBlock.negate().add(1.0f);
-    block.multiplyBy(interpolationBlock).add(nextPositionBlock);
+    // Hand the played frames back to the background job and ask for more when half the ring is free
+    streamReadPosition.store(jmax<int64>(sourcePosition, streamStart));
+    if (!streamFullyRead() && availablePosition - sourcePosition < config::streamBufferSize / 2)
+        scheduleJob();
 }
 
-
 void SfzVoice::renderNextBlock(AudioBuffer<float>& outputBuffer, int startSample, int numSamples) noexcept
 {
     auto outputBlock = dsp::AudioBlock<float>(outputBuffer).getSubBlock(startSample, numSamples);
@@ -409,39 +643,93 @@ void SfzVoice::renderNextBlock(AudioBuffer<float>& outputBuffer, int startSample
         return;
     }
     
-    fillBlock(outputBlock);
-    // Amplitude EG envelopes
-    for (int sampleIdx = startSample; sampleIdx < numSamples; sampleIdx++)
-        outputBuffer.applyGain(sampleIdx, 1, amplitudeEGEnvelope.getNextValue());
-    
-    auto localEnvelopeBuffer = tempBlock1.getSubBlock(startSample, numSamples);
+    // The decimation is left to SfzVoiceBatch
+    if (oversamplingFactor > 1)
+    {
+        jassertfalse;
+        outputBlock.clear();
+        return;
+    }
+
+    // Everything up to the stereo spread only processes the rendered channels
+    fillBlock(outputBlock.getSubsetChannelBlock(0, static_cast<size_t>(numRenderedChannels)));
+    applyEnvelopes(outputBuffer, startSample, numSamples);
+}
+
+dsp::AudioBlock<float> SfzVoice::renderOversampledBlock(int numSamples) noexcept
+{
+    jassert(isPlaying() && region != nullptr);
+    auto highRateBlock = oversampledBlock.getSubBlock(0, static_cast<size_t>(numSamples * oversamplingFactor))
+                                         .getSubsetChannelBlock(0, static_cast<size_t>(numRenderedChannels));
+    fillBlock(highRateBlock);
+    return highRateBlock;
+}
+
+void SfzVoice::applyEnvelopes(AudioBuffer<float>& outputBuffer, int startSample, int numSamples) noexcept
+{
+    // Render the amplitude EG for the whole block, fold the CC or base gain into it,
+    // and apply the result to the rendered channels in a single pass
+    const auto& kernels = SfzSimd::getKernels();
+    auto egGains = tempBlock2.getChannelPointer(0) + startSample;
+    amplitudeEGEnvelope.getBlock(egGains, numSamples);
+    currentLevel = amplitudeEGEnvelope.getCurrentValue();
+
     if (region->amplitudeCC)
     {
-        amplitudeEnvelope.getEnvelope(localEnvelopeBuffer);
-        outputBlock.multiplyBy(localEnvelopeBuffer);
+        auto ccGains = tempBlock1.getChannelPointer(0) + startSample;
+        amplitudeEnvelope.getEnvelope(ccGains, numSamples);
+        kernels.multiply(egGains, ccGains, numSamples);
     }
     else
     {
-        outputBlock.multiplyBy(baseGain);
+        FloatVectorOperations::multiply(egGains, baseGain, numSamples);
     }
 
-    if (state == SfzVoiceState::release && !amplitudeEGEnvelope.isSmoothing() && !fileLoadingPool.contains(this))
-        fileLoadingPool.addJob(this, false);
+    for (int chanIdx = 0; chanIdx < numRenderedChannels; ++chanIdx)
+        kernels.multiply(outputBuffer.getWritePointer(chanIdx, startSample), egGains, numSamples);
+
+    if (numRenderedChannels == 1)
+    {
+        for (int chanIdx = 1; chanIdx < config::numChannels; ++chanIdx)
+            outputBuffer.copyFrom(chanIdx, startSample, outputBuffer.getReadPointer(0, startSample), numSamples, rightPanGain);
+        if (leftPanGain != 1.0f)
+            outputBuffer.applyGain(0, startSample, numSamples, leftPanGain);
+    }
+
+    if (state == SfzVoiceState::release && !amplitudeEGEnvelope.isSmoothing())
+    {
+        releaseFinished = true;
+        scheduleJob();
+    }
 }
 
 void SfzVoice::reset() noexcept
 {
-    state = SfzVoiceState::idle;
     region = nullptr;
     triggeringNoteNumber.reset();
     triggeringCCNumber.reset();
     triggeringChannel.reset();
     dataReady = false;
-    fileData.reset();
-    preloadedData.reset();
+    releaseFinished = false;
+    stolen = false;
+    currentLevel = 0.0f;
+    // Let the collector thread free the buffers if we held the last reference
+    auto& garbageCollector = filePool.getGarbageCollector();
+    garbageCollector.collect(fileData);
+    garbageCollector.collect(preloadedData);
+    preloadStart = 0;
+    fileDataStart = 0;
+    streaming = false;
+    streamStart = 0;
+    streamLength.reset();
+    streamReadPosition = 0;
+    streamWritePosition = 0;
     initialDelay = 0;
     sourcePosition = 0;
     decimalPosition = 0;
+    loopCount = 1;
+    // Published last: as soon as the audio thread sees the voice as free, it may start it again
+    state.store(SfzVoiceState::idle, std::memory_order_release);
 }
 
 std::optional<int> SfzVoice::getTriggeringNoteNumber() const noexcept
@@ -25,9 +25,13 @@
 #include "SfzRegion.h"
 #include "SfzGlobals.h"
 #include "SfzEnvelope.h"
+#include "SfzOscillator.h"
+#include "SfzOversampling.h"
 #include "Buffer.h"
 #include "SfzBlockEnvelope.h"
+#include "SfzBackgroundLoader.h"
 #include <future>
+#include <utility>
 
 enum class SfzVoiceState
 {
@@ -36,11 +40,11 @@ enum class SfzVoiceState
     release
 };
 
-class SfzVoice: public ThreadPoolJob 
+class SfzVoice: public SfzBackgroundJob
 {
 public:
     SfzVoice() = delete;
-    SfzVoice(ThreadPool& fileLoadingPool, SfzFilePool& filePool, const CCValueArray& ccState);
+    SfzVoice(SfzBackgroundLoader& backgroundLoader, SfzFilePool& filePool, const CCValueArray& ccState);
     ~SfzVoice() noexcept;
     
     void startVoiceWithNote(SfzRegion& newRegion, int channel, int noteNumber, uint8_t velocity, int sampleDelay) noexcept;
@@ -53,16 +57,45 @@ public:
     void registerNoteOff(int channel, int noteNumber, uint8_t velocity, int timestamp) noexcept;
     void registerCC(int channel, int ccNumber, uint8_t ccValue, int timestamp) noexcept;
     bool checkOffGroup(uint32_t group, int timestamp) noexcept;
+    void release(int timestamp, bool useFastRelease = false) noexcept;
+    // Quickly fades out the voice to make room for a new one
+    void steal(int timestamp) noexcept;
 
     void reset() noexcept;
-    bool isFree() const { return state == SfzVoiceState::idle; }
-    bool isPlaying() const { return state != SfzVoiceState::idle; }
+    // The loader thread resets the voice and then publishes it as idle; see reset()
+    bool isFree() const { return state.load(std::memory_order_acquire) == SfzVoiceState::idle; }
+    bool isPlaying() const { return state.load(std::memory_order_acquire) != SfzVoiceState::idle; }
+    bool isReleasing() const { return state.load(std::memory_order_acquire) == SfzVoiceState::release; }
+    bool isStolen() const { return stolen; }
+    // Playing and neither stolen nor waiting for its background reset; only these count towards polyphony
+    bool isSounding() const { return isPlaying() && !stolen && !releaseFinished; }
+    // The amplitude envelope level at the end of the last rendered block
+    float getCurrentLevel() const { return currentLevel; }
+    void setTriggerOrder(uint64_t order) { triggerOrder = order; }
+    uint64_t getTriggerOrder() const { return triggerOrder; }
+    const SfzRegion* getRegion() const { return region; }
+    // Run the background jobs inline on the rendering thread, for deterministic offline renders
+    void setSynchronousLoading(bool synchronous) { synchronousLoading = synchronous; }
+    // Render the samples and generators at 2 or 4 times the output rate; 1 disables oversampling.
+    // Do not call this while rendering.
+    void setOversamplingFactor(int factor);
+    int getOversamplingFactor() const { return oversamplingFactor; }
+    // Oversampled voices are rendered by an SfzVoiceBatch instead of renderNextBlock(): the batch
+    // renders the rendered channels of a playing voice at the higher rate, decimates them into
+    // the output buffer along with the other voices of the batch, and then applies the envelopes.
+    dsp::AudioBlock<float> renderOversampledBlock(int numSamples) noexcept;
+    void applyEnvelopes(AudioBuffer<float>& outputBuffer, int startSample, int numSamples) noexcept;
+    int getNumRenderedChannels() const { return numRenderedChannels; }
+    // True once after each start: the decimator memories still hold the previous voice
+    bool takeDecimatorReset() noexcept { return std::exchange(decimatorResetPending, false); }
 
     std::optional<int> getTriggeringChannel() const noexcept;
     std::optional<int> getTriggeringNoteNumber() const noexcept;
     std::optional<int> getTriggeringCCNumber() const noexcept;
 private:
-    ThreadPool& fileLoadingPool;
+    using Renderer = void (SfzVoice::*)(dsp::AudioBlock<float> block, int releaseOffset) noexcept;
+
+    SfzBackgroundLoader& backgroundLoader;
     SfzFilePool& filePool;
     const CCValueArray& ccState;
 
@@ -71,9 +104,30 @@ private:
     std::optional<int> triggeringNoteNumber;
     std::optional<int> triggeringCCNumber;
     SfzRegion* region { nullptr };
-    std::shared_ptr<AudioBuffer<float>> preloadedData { nullptr };
-    std::shared_ptr<AudioBuffer<float>> fileData { nullptr };
+    std::shared_ptr<const SfzSampleBuffer> preloadedData { nullptr };
+    int64 preloadStart { 0 }; // File position of the first preloaded frame
+    std::shared_ptr<const SfzSampleBuffer> fileData { nullptr }; // Either the preloaded data or a shared decoded sample
+    int fileDataStart { 0 };
     std::atomic<bool> dataReady;
+    // Set before dataReady, possibly from the background job when a decoded sample replaces the stream
+    Renderer fileRenderer { nullptr };
+    Renderer streamRenderer { nullptr };
+    std::atomic<bool> releaseFinished { false };
+
+    // Streaming: the background job fills the ring buffer in playback order (loops unrolled)
+    // starting where the preloaded data ends. Positions are absolute playback positions and
+    // the ring holds the frames between the read and the write positions.
+    static_assert((config::streamBufferSize & (config::streamBufferSize - 1)) == 0, "The stream buffer size must be a power of 2");
+    AudioBuffer<float> streamBuffer { config::numChannels, config::streamBufferSize };
+    bool streaming { false };
+    bool synchronousLoading { false };
+    int64 streamStart { 0 };
+    std::optional<int64> streamLength {}; // Unset for endless loops
+    std::atomic<int64> streamReadPosition { 0 };
+    std::atomic<int64> streamWritePosition { 0 };
+    // Only touched from the background job
+    std::unique_ptr<AudioFormatReader> streamReader;
+    File streamReaderFile;
 
     // Sustain logic
     bool noteIsOff { true };
@@ -85,11 +139,20 @@ private:
     // Basic ratios for resampling
     float speedRatio { 1.0 };
     float pitchRatio { 1.0 };
+    // Mono samples and generators only render the first channel, and the pan spreads it when mixing
+    int numRenderedChannels { config::numChannels };
+    float leftPanGain { 1.0f };
+    float rightPanGain { 1.0f };
     // Envelopes and states for the voice
-    SfzVoiceState state { SfzVoiceState::idle };
+    // Written by the background job when the voice is reset
+    std::atomic<SfzVoiceState> state { SfzVoiceState::idle };
     float baseGain { 1.0f };
+    float currentLevel { 0.0f };
+    bool stolen { false };
+    uint64_t triggerOrder { 0 };
 
     SfzEnvelopeGeneratorValue amplitudeEGEnvelope;
+    SfzOscillator oscillator;
     SfzBlockEnvelope<float> amplitudeEnvelope;
     SfzBlockEnvelope<float> panEnvelope;
     SfzBlockEnvelope<float> positionEnvelope;
@@ -98,22 +161,39 @@ private:
     HeapBlock<char> tempHeapBlock2;
     dsp::AudioBlock<float> tempBlock1;
     dsp::AudioBlock<float> tempBlock2;
+    int oversamplingFactor { 1 };
+    bool decimatorResetPending { false };
+    HeapBlock<char> oversampledHeapBlock;
+    dsp::AudioBlock<float> oversampledBlock;
     // Buffer<float> envelopeBuffer { config::defaultSamplesPerBlock };
 
     // Internal position and counters
     int initialDelay { 0 };
-    int sourcePosition { 0 };
+    int64 sourcePosition { 0 }; // Endless loops stream for hours, past the int range
     uint32_t loopCount { 1 };
 
     float decimalPosition { 0.0f };
 
-    JobStatus runJob() override;
+    void runBackgroundJob() override;
+    void scheduleJob() noexcept;
+    void fillStreamBuffer();
+    bool streamFullyRead() const noexcept;
     void clearEnvelopes() noexcept;
-    void release(int timestamp, bool useFastRelease = false) noexcept;
     void fillBlock(dsp::AudioBlock<float> block) noexcept;
+    // Releases the voice from a frame of the rendered block, which may be oversampled
+    void releaseAtRenderedFrame(int frame) noexcept;
     void fillGenerator(dsp::AudioBlock<float> block) noexcept;
-    void fillWithPreloadedData(dsp::AudioBlock<float> block, int releaseOffset) noexcept;
+    // Render kernels, instantiated for each sample storage type, number of rendered channels,
+    // looping and unit playback speed; the voice picks one when the playback data is known
+    template<class T, int NumChannels, bool CanWrap, bool UnityRatio>
     void fillWithFileData(dsp::AudioBlock<float> block, int releaseOffset) noexcept;
-    void commonStartVoice(SfzRegion& newRegion, int sampleDelay) noexcept;
+    template<int NumChannels, bool UnityRatio>
+    void fillWithStreamedData(dsp::AudioBlock<float> block, int releaseOffset) noexcept;
+    template<class T>
+    static Renderer getFileRenderer(bool stereo, bool canWrap, bool unityRatio) noexcept;
+    Renderer selectFileRenderer(const SfzSampleBuffer& data) const noexcept;
+    Renderer selectStreamRenderer() const noexcept;
+    bool isUnityRatio() const noexcept;
+    void commonStartVoice(SfzRegion& newRegion, int sampleDelay, float newPitchRatio) noexcept;
     JUCE_LEAK_DETECTOR(SfzVoice)
 };
\ No newline at end of file
@@ -0,0 +1,246 @@
+/*
+    ==============================================================================
+
+    Copyright 2019 - Paul Ferrand (paulfd@outlook.fr)
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <https://www.gnu.org/licenses/>.
+
+    ==============================================================================
+*/
+
+
+
+#pragma once
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "SfzGlobals.h"
+#include "SfzOversampling.h"
+#include "SfzSimdDispatch.h"
+#include "SfzVoice.h"
+#include <algorithm>
+#include <memory>
+#include <vector>
+
+/**
+ * Renders a fixed group of voices and decimates the oversampled ones together, through the
+ * multi-lane hiir decimators of SfzSimdDispatch, instead of one channel at a time.
+ *
+ * Each voice of the batch owns one lane per output channel for its whole life, so that the
+ * filter memories follow it, and clears its lanes when it starts. Within the decimator
+ * buffers the lanes are interleaved frame by frame. As described in SfzOversampling, a factor of 4 goes
+ * through a first stage with fewer coefficients before the last one; both work in place.
+ * A lane that stops receiving a voice, like the second lane of a mono voice, is cleared and
+ * silenced once and then left alone; the decimators whose lanes are all silent are skipped.
+ * Without oversampling the voices are simply rendered one after the other.
+ * A batch is only rendered by one thread at a time.
+ */
+class SfzVoiceBatch
+{
+public:
+    // Enough voices to fill the lanes of a decimator with the kernels in use, and at least voicesPerBatch
+    static int getPreferredSize() noexcept
+    {
+        return std::max(config::voicesPerBatch, SfzSimd::getKernels().numDecimatorLanes / config::numChannels);
+    }
+
+    explicit SfzVoiceBatch(std::vector<SfzVoice*> batchVoices)
+    : voices(std::move(batchVoices)),
+      rendered(voices.size(), false),
+      activeLanes(voices.size() * config::numChannels, false)
+    { }
+
+    // Creates the decimators with the kernels in use; do not call this while rendering
+    void prepare(int oversamplingFactor, int samplesPerBlock)
+    {
+        factor = SfzOversampling::isValidFactor(oversamplingFactor) ? oversamplingFactor : 1;
+        decimators.clear();
+        std::fill(activeLanes.begin(), activeLanes.end(), false);
+        if (factor == 1)
+            return;
+
+        const auto& kernels = SfzSimd::getKernels();
+        lanesPerDecimator = kernels.numDecimatorLanes;
+        const auto numLanes = static_cast<int>(voices.size()) * config::numChannels;
+        for (int firstLane = 0; firstLane < numLanes; firstLane += lanesPerDecimator)
+        {
+            auto& decimator = decimators.emplace_back();
+            decimator.lastStage = kernels.createDecimator(SfzOversampling::lastStageOrder);
+            decimator.lastStage->setCoefs(SfzOversampling::lastStageCoefs);
+            if (factor == 4)
+            {
+                decimator.firstStage = kernels.createDecimator(SfzOversampling::firstStageOrder);
+                decimator.firstStage->setCoefs(SfzOversampling::firstStageCoefs);
+            }
+            // The lanes past the last voice keep the silence they start with
+            decimator.buffer.resize(static_cast<size_t>(samplesPerBlock * factor * lanesPerDecimator), 0.0f);
+        }
+    }
+
+    bool isPlaying() const noexcept
+    {
+        return std::any_of(voices.begin(), voices.end(), [](const auto* voice) { return voice->isPlaying(); });
+    }
+
+    /**
+     * Adds the playing voices of the batch to the output buffer. The voice buffer holds
+     * the rendering of one voice at a time, at the same positions as the output.
+     */
+    void renderNextBlock(AudioBuffer<float>& outputAudio, AudioBuffer<float>& voiceBuffer, int startSample, int numSamples) noexcept
+    {
+        const auto& kernels = SfzSimd::getKernels();
+        auto addVoice = [&]() {
+            for (int channelIdx = 0; channelIdx < config::numChannels; ++channelIdx)
+                kernels.add(outputAudio.getWritePointer(channelIdx, startSample), voiceBuffer.getReadPointer(channelIdx, startSample), numSamples);
+        };
+
+        if (factor == 1)
+        {
+            for (auto* voice: voices)
+            {
+                if (!voice->isPlaying())
+                    continue;
+                voice->renderNextBlock(voiceBuffer, startSample, numSamples);
+                addVoice();
+            }
+            return;
+        }
+
+        interleaveVoices(numSamples);
+        for (auto& decimator: decimators)
+        {
+            // Silent lanes with cleared filter memories would only decimate to silence
+            if (decimator.numActiveLanes == 0)
+                continue;
+
+            auto* buffer = decimator.buffer.data();
+            if (decimator.firstStage != nullptr)
+                decimator.firstStage->process(buffer, buffer, numSamples * 2);
+            decimator.lastStage->process(buffer, buffer, numSamples);
+        }
+
+        for (size_t voiceIdx = 0; voiceIdx < voices.size(); ++voiceIdx)
+        {
+            auto* voice = voices[voiceIdx];
+            if (!rendered[voiceIdx])
+                continue;
+
+            for (int channelIdx = 0; channelIdx < voice->getNumRenderedChannels(); ++channelIdx)
+            {
+                const auto* decimated = getLane(voiceIdx, channelIdx).buffer;
+                auto* output = voiceBuffer.getWritePointer(channelIdx, startSample);
+                for (int sampleIdx = 0; sampleIdx < numSamples; ++sampleIdx)
+                    output[sampleIdx] = decimated[sampleIdx * lanesPerDecimator];
+            }
+            voice->applyEnvelopes(voiceBuffer, startSample, numSamples);
+            addVoice();
+        }
+    }
+
+private:
+    struct Decimator
+    {
+        std::unique_ptr<SfzLaneDecimator> firstStage;
+        std::unique_ptr<SfzLaneDecimator> lastStage;
+        std::vector<float> buffer;
+        int numActiveLanes { 0 };
+    };
+
+    // The decimator of a lane, its index there and the position of its first sample in the decimator buffer
+    struct LaneLocation
+    {
+        size_t lane;
+        Decimator& decimator;
+        int index;
+        float* buffer;
+    };
+
+    LaneLocation getLane(size_t voiceIdx, int channelIdx) noexcept
+    {
+        const auto lane = static_cast<int>(voiceIdx) * config::numChannels + channelIdx;
+        auto& decimator = decimators[static_cast<size_t>(lane / lanesPerDecimator)];
+        const auto index = lane % lanesPerDecimator;
+        return { static_cast<size_t>(lane), decimator, index, decimator.buffer.data() + index };
+    }
+
+    // Renders the playing voices at the higher rate into their lanes, and silences the lanes they stopped using
+    void interleaveVoices(int numSamples) noexcept
+    {
+        const auto numFrames = numSamples * factor;
+        for (size_t voiceIdx = 0; voiceIdx < voices.size(); ++voiceIdx)
+        {
+            auto* voice = voices[voiceIdx];
+            const bool playing = voice->isPlaying() && voice->getRegion() != nullptr;
+            rendered[voiceIdx] = playing;
+            dsp::AudioBlock<float> highRateBlock;
+            if (playing)
+            {
+                if (voice->takeDecimatorReset())
+                    clearLanes(voiceIdx);
+                highRateBlock = voice->renderOversampledBlock(numSamples);
+            }
+
+            for (int channelIdx = 0; channelIdx < config::numChannels; ++channelIdx)
+            {
+                const auto lane = getLane(voiceIdx, channelIdx);
+                if (playing && channelIdx < static_cast<int>(highRateBlock.getNumChannels()))
+                {
+                    const auto* input = highRateBlock.getChannelPointer(static_cast<size_t>(channelIdx));
+                    for (int frameIdx = 0; frameIdx < numFrames; ++frameIdx)
+                        lane.buffer[frameIdx * lanesPerDecimator] = input[frameIdx];
+                    if (!activeLanes[lane.lane])
+                    {
+                        activeLanes[lane.lane] = true;
+                        lane.decimator.numActiveLanes++;
+                    }
+                }
+                else if (activeLanes[lane.lane])
+                {
+                    silenceLane(lane);
+                }
+            }
+        }
+    }
+
+    void clearLane(const LaneLocation& lane) noexcept
+    {
+        if (lane.decimator.firstStage != nullptr)
+            lane.decimator.firstStage->clearLane(lane.index);
+        lane.decimator.lastStage->clearLane(lane.index);
+    }
+
+    void clearLanes(size_t voiceIdx) noexcept
+    {
+        for (int channelIdx = 0; channelIdx < config::numChannels; ++channelIdx)
+            clearLane(getLane(voiceIdx, channelIdx));
+    }
+
+    // Silence in a cleared lane stays silence, so the lane does not need to be written again until a voice uses it
+    void silenceLane(const LaneLocation& lane) noexcept
+    {
+        clearLane(lane);
+        const auto numFrames = static_cast<int>(lane.decimator.buffer.size()) / lanesPerDecimator;
+        for (int frameIdx = 0; frameIdx < numFrames; ++frameIdx)
+            lane.buffer[frameIdx * lanesPerDecimator] = 0.0f;
+        activeLanes[lane.lane] = false;
+        lane.decimator.numActiveLanes--;
+    }
+
+    std::vector<SfzVoice*> voices;
+    // Voices rendered at the higher rate in the current block; a background job may reset one meanwhile
+    std::vector<bool> rendered;
+    // Lanes written by a voice since they were last silenced
+    std::vector<bool> activeLanes;
+    std::vector<Decimator> decimators;
+    int factor { 1 };
+    int lanesPerDecimator { 1 };
+};
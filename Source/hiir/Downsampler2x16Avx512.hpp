@@ -0,0 +1,370 @@
+/*****************************************************************************
+
+        Downsampler2x16Avx512.hpp
+        Adapted from Downsampler2x4Sse.hpp by Laurent de Soras, 2015
+
+--- Legal stuff ---
+
+This program is free software. It comes without any warranty, to
+the extent permitted by applicable law. You can redistribute it
+and/or modify it under the terms of the Do What The Fuck You Want
+To Public License, Version 2, as published by Sam Hocevar. See
+http://sam.zoy.org/wtfpl/COPYING for more details.
+
+*Tab=3***********************************************************************/
+
+
+
+#if ! defined (hiir_Downsampler2x16Avx512_CODEHEADER_INCLUDED)
+#define hiir_Downsampler2x16Avx512_CODEHEADER_INCLUDED
+
+
+
+/*\\\ INCLUDE FILES \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+#include "hiir/StageProc16Avx512.h"
+
+#include <cassert>
+
+
+
+namespace hiir
+{
+
+
+
+/*\\\ PUBLIC \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+/*
+==============================================================================
+Name: ctor
+Throws: Nothing
+==============================================================================
+*/
+
+template <int NC>
+Downsampler2x16Avx512 <NC>::Downsampler2x16Avx512 ()
+:	_filter ()
+{
+	for (int i = 0; i < NBR_COEFS + 2; ++i)
+	{
+		_mm512_store_ps (_filter [i]._coef, _mm512_setzero_ps ());
+	}
+
+	clear_buffers ();
+}
+
+
+
+/*
+==============================================================================
+Name: set_coefs
+Description:
+   Sets filter coefficients. Generate them with the PolyphaseIir2Designer
+   class.
+   Call this function before doing any processing.
+Input parameters:
+	- coef_arr: Array of coefficients. There should be as many coefficients as
+      mentioned in the class template parameter.
+Throws: Nothing
+==============================================================================
+*/
+
+template <int NC>
+void	Downsampler2x16Avx512 <NC>::set_coefs (const double coef_arr [])
+{
+	assert (coef_arr != 0);
+
+	for (int i = 0; i < NBR_COEFS; ++i)
+	{
+		_mm512_store_ps (_filter [i + 2]._coef, _mm512_set1_ps (float (coef_arr [i])));
+	}
+}
+
+
+
+/*
+==============================================================================
+Name: process_sample
+Description:
+   Downsamples (x2) one pair of vector of 16 samples, to generate one output
+	vector.
+Input parameters:
+	- in_ptr: pointer on the two vectors to decimate. No alignment constraint.
+Returns: Samplerate-reduced vector.
+Throws: Nothing
+==============================================================================
+*/
+
+template <int NC>
+__m512	Downsampler2x16Avx512 <NC>::process_sample (const float in_ptr [32])
+{
+	assert (in_ptr != 0);
+
+	const __m512   in_0 = _mm512_loadu_ps (in_ptr    );
+	const __m512   in_1 = _mm512_loadu_ps (in_ptr + 16);
+
+	return process_sample (in_0, in_1);
+}
+
+
+
+/*
+==============================================================================
+Name: process_sample
+Description:
+   Downsamples (x2) one pair of vector of 16 samples, to generate one output
+	vector.
+Input parameters:
+	- in_0: vector at t
+	- in_1: vector at t + 1
+Returns: Samplerate-reduced vector.
+Throws: Nothing
+==============================================================================
+*/
+
+template <int NC>
+__m512	Downsampler2x16Avx512 <NC>::process_sample (__m512 in_0, __m512 in_1)
+{
+	__m512         spl_0 = in_1;
+	__m512         spl_1 = in_0;
+
+	StageProc16Avx512 <NBR_COEFS>::process_sample_pos (
+		NBR_COEFS, spl_0, spl_1, &_filter [0]
+	);
+
+	const __m512   sum = _mm512_add_ps (spl_0, spl_1);
+	const __m512   out = _mm512_mul_ps (sum, _mm512_set1_ps (0.5f));
+
+	return out;
+}
+
+
+
+/*
+==============================================================================
+Name: process_block
+Description:
+   Downsamples (x2) a block of vectors of 16 samples.
+	Input and output blocks may overlap, see assert() for details.
+Input parameters:
+	- in_ptr: Input array, containing nbr_spl * 2 vectors.
+		No alignment constraint.
+	- nbr_spl: Number of vectors to output, > 0
+Output parameters:
+	- out_ptr: Array for the output vectors, capacity: nbr_spl vectors.
+		No alignment constraint.
+Throws: Nothing
+==============================================================================
+*/
+
+template <int NC>
+void	Downsampler2x16Avx512 <NC>::process_block (float out_ptr [], const float in_ptr [], long nbr_spl)
+{
+	assert (in_ptr != 0);
+	assert (out_ptr != 0);
+	assert (out_ptr <= in_ptr || out_ptr >= in_ptr + nbr_spl * 32);
+	assert (nbr_spl > 0);
+
+	long           pos = 0;
+	do
+	{
+		const __m512   val = process_sample (in_ptr + pos * 32);
+		_mm512_storeu_ps (out_ptr + pos * 16, val);
+		++ pos;
+	}
+	while (pos < nbr_spl);
+}
+
+
+
+/*
+==============================================================================
+Name: process_sample_split
+Description:
+   Split (spectrum-wise) in half a pair of vector of 16 samples. The lower part
+	of the spectrum is a classic downsampling, equivalent to the output of
+   process_sample().
+   The higher part is the complementary signal: original filter response
+   is flipped from left to right, becoming a high-pass filter with the same
+   cutoff frequency. This signal is then critically sampled (decimation by 2),
+   flipping the spectrum: Fs/4...Fs/2 becomes Fs/4...0.
+Input parameters:
+	- in_ptr: pointer on the pair of input vectors. No alignment constraint.
+Output parameters:
+	- low: output vector, lower part of the spectrum (downsampling)
+	- high: output vector, higher part of the spectrum.
+Throws: Nothing
+==============================================================================
+*/
+
+template <int NC>
+void	Downsampler2x16Avx512 <NC>::process_sample_split (__m512 &low, __m512 &high, const float in_ptr [32])
+{
+	assert (in_ptr != 0);
+
+	const __m512   in_0 = _mm512_loadu_ps (in_ptr    );
+	const __m512   in_1 = _mm512_loadu_ps (in_ptr + 16);
+
+	process_sample_split (low, high, in_0, in_1);
+}
+
+
+
+/*
+==============================================================================
+Name: process_sample_split
+Description:
+   Split (spectrum-wise) in half a pair of vector of 16 samples. The lower part
+	of the spectrum is a classic downsampling, equivalent to the output of
+   process_sample().
+   The higher part is the complementary signal: original filter response
+   is flipped from left to right, becoming a high-pass filter with the same
+   cutoff frequency. This signal is then critically sampled (decimation by 2),
+   flipping the spectrum: Fs/4...Fs/2 becomes Fs/4...0.
+Input parameters:
+	- in_0: vector at t
+	- in_1: vector at t + 1
+Output parameters:
+	- low: output vector, lower part of the spectrum (downsampling)
+	- high: output vector, higher part of the spectrum.
+Throws: Nothing
+==============================================================================
+*/
+
+template <int NC>
+void	Downsampler2x16Avx512 <NC>::process_sample_split (__m512 &low, __m512 &high, __m512 in_0, __m512 in_1)
+{
+	__m512         spl_0 = in_1;
+	__m512         spl_1 = in_0;
+
+	StageProc16Avx512 <NBR_COEFS>::process_sample_pos (
+		NBR_COEFS, spl_0, spl_1, &_filter [0]
+	);
+
+	const __m512   sum = _mm512_add_ps (spl_0, spl_1);
+	low  = _mm512_mul_ps (sum, _mm512_set1_ps (0.5f));
+	high = _mm512_sub_ps (spl_0, low);
+}
+
+
+
+/*
+==============================================================================
+Name: process_block_split
+Description:
+   Split (spectrum-wise) in half a pair of vector of 16 samples. The lower part
+	of the spectrum is a classic downsampling, equivalent to the output of
+   process_block().
+   The higher part is the complementary signal: original filter response
+   is flipped from left to right, becoming a high-pass filter with the same
+   cutoff frequency. This signal is then critically sampled (decimation by 2),
+   flipping the spectrum: Fs/4...Fs/2 becomes Fs/4...0.
+	Input and output blocks may overlap, see assert() for details.
+Input parameters:
+	- in_ptr: Input array, containing nbr_spl * 2 vectors.
+		No alignment constraint.
+	- nbr_spl: Number of vectors for each output, > 0
+Output parameters:
+	- out_l_ptr: Array for the output vectors, lower part of the spectrum
+      (downsampling). Capacity: nbr_spl vectors.
+		No alignment constraint.
+	- out_h_ptr: Array for the output vectors, higher part of the spectrum.
+      Capacity: nbr_spl vectors.
+		No alignment constraint.
+Throws: Nothing
+==============================================================================
+*/
+
+template <int NC>
+void	Downsampler2x16Avx512 <NC>::process_block_split (float out_l_ptr [], float out_h_ptr [], const float in_ptr [], long nbr_spl)
+{
+	assert (in_ptr != 0);
+	assert (out_l_ptr != 0);
+	assert (out_l_ptr <= in_ptr || out_l_ptr >= in_ptr + nbr_spl * 32);
+	assert (out_h_ptr != 0);
+	assert (out_h_ptr <= in_ptr || out_h_ptr >= in_ptr + nbr_spl * 32);
+	assert (out_h_ptr != out_l_ptr);
+	assert (nbr_spl > 0);
+
+	long           pos = 0;
+	do
+	{
+		__m512         low;
+		__m512         high;
+		process_sample_split (low, high, in_ptr + pos * 32);
+		_mm512_storeu_ps (out_l_ptr + pos * 16, low);
+		_mm512_storeu_ps (out_h_ptr + pos * 16, high);
+		++ pos;
+	}
+	while (pos < nbr_spl);
+}
+
+
+
+/*
+==============================================================================
+Name: clear_buffers
+Description:
+	Clears filter memory, as if it processed silence since an infinite amount
+	of time.
+Throws: Nothing
+==============================================================================
+*/
+
+template <int NC>
+void	Downsampler2x16Avx512 <NC>::clear_buffers ()
+{
+	for (int i = 0; i < NBR_COEFS + 2; ++i)
+	{
+		_mm512_store_ps (_filter [i]._mem, _mm512_setzero_ps ());
+	}
+}
+
+
+
+/*
+==============================================================================
+Name: clear_buffers_lane
+Description:
+	Clears the filter memory of a single lane, as clear_buffers() does for
+	all of them. The other lanes are left untouched.
+Input parameters:
+	- lane: index of the lane, in [0 ; 16[
+Throws: Nothing
+==============================================================================
+*/
+
+template <int NC>
+void	Downsampler2x16Avx512 <NC>::clear_buffers_lane (int lane)
+{
+	assert (lane >= 0);
+	assert (lane < 16);
+
+	for (int i = 0; i < NBR_COEFS + 2; ++i)
+	{
+		_filter [i]._mem [lane] = 0;
+	}
+}
+
+
+
+/*\\\ PROTECTED \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+/*\\\ PRIVATE \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
+
+
+
+}  // namespace hiir
+
+
+
+#endif   // hiir_Downsampler2x16Avx512_CODEHEADER_INCLUDED
+
+
+
+/*\\\ EOF \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
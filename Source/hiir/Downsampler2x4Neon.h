@@ -78,6 +78,7 @@ public:
 	void           process_block_split (float out_l_ptr [], float out_h_ptr [], const float in_ptr [], long nbr_spl);
 
 	void           clear_buffers ();
+	void           clear_buffers_lane (int lane);
 
 
 
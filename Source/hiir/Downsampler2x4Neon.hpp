@@ -336,6 +336,32 @@ void	Downsampler2x4Neon <NC>::clear_buffers ()
 
 
 
+/*
+==============================================================================
+Name: clear_buffers_lane
+Description:
+	Clears the filter memory of a single lane, as clear_buffers() does for
+	all of them. The other lanes are left untouched.
+Input parameters:
+	- lane: index of the lane, in [0 ; 4[
+Throws: Nothing
+==============================================================================
+*/
+
+template <int NC>
+void	Downsampler2x4Neon <NC>::clear_buffers_lane (int lane)
+{
+	assert (lane >= 0);
+	assert (lane < 4);
+
+	for (int i = 0; i < NBR_COEFS + 2; ++i)
+	{
+		_filter [i]._mem [lane] = 0;
+	}
+}
+
+
+
 /*\\\ PROTECTED \\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\\*/
 
 
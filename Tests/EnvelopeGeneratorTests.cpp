@@ -0,0 +1,128 @@
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "catch2/catch.hpp"
+#include "../Source/SfzEnvelope.h"
+#include <array>
+#include <vector>
+
+namespace
+{
+// At 100 Hz, every 0.01 seconds is one sample
+constexpr double testSampleRate { 100.0 };
+
+SfzEnvelopeGeneratorDescription makeDescription()
+{
+    SfzEnvelopeGeneratorDescription description;
+    description.delay = 0.02f;
+    description.attack = 0.04f;
+    description.hold = 0.02f;
+    description.decay = 0.04f;
+    description.sustain = 50.0f;
+    description.release = 0.04f;
+    return description;
+}
+}
+
+TEST_CASE("Envelope generator", "[envelope]")
+{
+    CCValueArray ccValues;
+    ccValues.fill(0);
+    SfzEnvelopeGeneratorValue envelope;
+    envelope.setSampleRate(testSampleRate);
+    envelope.prepare(makeDescription(), ccValues, 0);
+
+    SECTION("Delay, attack and hold")
+    {
+        std::array<float, 8> output;
+        envelope.getBlock(output.data(), static_cast<int>(output.size()));
+        std::array<float, 8> expected { 0.0f, 0.0f, 0.25f, 0.5f, 0.75f, 1.0f, 1.0f, 1.0f };
+        REQUIRE( output == expected );
+        REQUIRE( envelope.getState() == SfzEnvelopeGeneratorValue::EGState::decay );
+    }
+
+    SECTION("Decay towards the sustain level")
+    {
+        std::array<float, 16> output;
+        envelope.getBlock(output.data(), static_cast<int>(output.size()));
+        for (int index = 8; index < 12; ++index)
+        {
+            REQUIRE( output[index] < output[index - 1] );
+            REQUIRE( output[index] > 0.5f );
+        }
+        REQUIRE( output[11] == Approx(0.5f).margin(0.001f) );
+        for (int index = 12; index < 16; ++index)
+            REQUIRE( output[index] == Approx(output[11]) );
+        REQUIRE( envelope.getState() == SfzEnvelopeGeneratorValue::EGState::sustain );
+    }
+
+    SECTION("Blocks and single values agree")
+    {
+        SfzEnvelopeGeneratorValue otherEnvelope;
+        otherEnvelope.setSampleRate(testSampleRate);
+        otherEnvelope.prepare(makeDescription(), ccValues, 0);
+
+        std::vector<float> output (40);
+        envelope.getBlock(output.data(), 5);
+        envelope.getBlock(output.data() + 5, 15);
+        envelope.release(3);
+        envelope.getBlock(output.data() + 20, 20);
+
+        for (int index = 0; index < 20; ++index)
+            REQUIRE( otherEnvelope.getNextValue() == Approx(output[index]).margin(1e-6f) );
+        otherEnvelope.release(3);
+        for (int index = 20; index < 40; ++index)
+            REQUIRE( otherEnvelope.getNextValue() == Approx(output[index]).margin(1e-6f) );
+    }
+
+    SECTION("Delayed release")
+    {
+        std::array<float, 12> output;
+        envelope.getBlock(output.data(), 6);
+        envelope.release(2);
+        envelope.getBlock(output.data(), static_cast<int>(output.size()));
+        // Still holding until the release starts
+        REQUIRE( output[0] == 1.0f );
+        REQUIRE( output[1] == 1.0f );
+        REQUIRE( output[2] < 1.0f );
+        REQUIRE( output[5] == Approx(config::virtuallyZero).margin(1e-6f) );
+        REQUIRE( output[6] == 0.0f );
+        REQUIRE( !envelope.isSmoothing() );
+    }
+
+    SECTION("Release during the attack starts from the current level")
+    {
+        std::array<float, 4> output;
+        envelope.getBlock(output.data(), 3);
+        REQUIRE( output[2] == 0.25f );
+        envelope.release();
+        envelope.getBlock(output.data(), 1);
+        REQUIRE( output[0] < 0.25f );
+        REQUIRE( output[0] > 0.0f );
+        REQUIRE( envelope.getState() == SfzEnvelopeGeneratorValue::EGState::release );
+    }
+
+    SECTION("Fast release shortens the release")
+    {
+        auto description = makeDescription();
+        description.release = 1.0f;
+        envelope.prepare(description, ccValues, 0);
+        std::array<float, 8> output;
+        envelope.getBlock(output.data(), static_cast<int>(output.size()));
+        envelope.release(0, true);
+        envelope.getBlock(output.data(), 1);
+        REQUIRE( output[0] == Approx(config::virtuallyZero).margin(1e-6f) );
+        REQUIRE( !envelope.isSmoothing() );
+    }
+
+    SECTION("Zero-length segments")
+    {
+        envelope.prepare(SfzEnvelopeGeneratorDescription(), ccValues, 0);
+        std::array<float, 4> output;
+        envelope.getBlock(output.data(), static_cast<int>(output.size()));
+        std::array<float, 4> expected { 1.0f, 1.0f, 1.0f, 1.0f };
+        REQUIRE( output == expected );
+        envelope.release();
+        envelope.getBlock(output.data(), 1);
+        REQUIRE( output[0] == 0.0f );
+        REQUIRE( !envelope.isSmoothing() );
+    }
+}
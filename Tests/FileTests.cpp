@@ -2,7 +2,11 @@
 #include "catch2/catch.hpp"
 #include "../Source/SfzRegion.h"
 #include "../Source/SfzSynth.h"
+#include <cmath>
 #include <filesystem>
+#include <fstream>
+#include <memory>
+#include <vector>
 using namespace Catch::literals;
 
 TEST_CASE("Basic regions", "File tests")
@@ -244,6 +248,190 @@ TEST_CASE("MeatBass", "File tests")
         REQUIRE( synth.getRegionView(2)->sample == R"(../Samples/pizz/a0_vl4_rr3.wav)" );
         REQUIRE( synth.getRegionView(3)->sample == R"(../Samples/pizz/a0_vl4_rr4.wav)" );
     }
+
+    SECTION("Samples are loaded before the regions are prepared")
+    {
+        SfzSynth synth;
+        synth.loadSfzFile(std::filesystem::current_path() / "Tests/TestFiles/SpecificBugs/MeatBassPizz/Programs/pizz.sfz");
+        for (int i = 0; i < synth.getNumRegions(); ++i)
+        {
+            REQUIRE( synth.getRegionView(i)->sampleMetadata );
+            REQUIRE( synth.getRegionView(i)->sampleMetadata->lengthInSamples > 0 );
+            REQUIRE( synth.getRegionView(i)->sampleEnd == synth.getRegionView(i)->sampleMetadata->lengthInSamples );
+        }
+    }
+}
+
+TEST_CASE("32 bit integer files", "File tests")
+{
+    // JUCE only writes 32 bit WAV files as floats, so the PCM one is written by hand
+    const auto directory = std::filesystem::temp_directory_path() / "sfizz_int32_tests";
+    std::filesystem::create_directories(directory);
+    const auto wavFile = directory / "int32.wav";
+    constexpr int numFrames { 1000 };
+    std::vector<int32_t> frames;
+    for (int frameIdx = 0; frameIdx < numFrames; ++frameIdx)
+        frames.push_back(static_cast<int32_t>(std::sin(0.05 * frameIdx) * 0.5 * 2147483648.0) + (frameIdx % 7));
+    {
+        std::ofstream stream { wavFile, std::ios::binary };
+        auto write32 = [&](uint32_t value) { for (int shift = 0; shift < 32; shift += 8) stream.put(static_cast<char>((value >> shift) & 0xff)); };
+        auto write16 = [&](uint16_t value) { stream.put(static_cast<char>(value & 0xff)); stream.put(static_cast<char>(value >> 8)); };
+        const uint32_t dataSize { numFrames * 4 };
+        stream.write("RIFF", 4);
+        write32(36 + dataSize);
+        stream.write("WAVEfmt ", 8);
+        write32(16);
+        write16(1); // PCM
+        write16(1);
+        write32(48000);
+        write32(48000 * 4);
+        write16(4);
+        write16(32);
+        stream.write("data", 4);
+        write32(dataSize);
+        for (auto frame: frames)
+            write32(static_cast<uint32_t>(frame));
+    }
+
+    AudioFormatManager formatManager;
+    formatManager.registerBasicFormats();
+    std::unique_ptr<AudioFormatReader> reader { formatManager.createReaderFor(File(wavFile.string())) };
+    REQUIRE( reader != nullptr );
+    REQUIRE( !reader->usesFloatingPointData );
+    REQUIRE( reader->bitsPerSample == 32 );
+
+    // The lowest 8 bits are dropped
+    REQUIRE( SfzFilePool::getStorageFormat(*reader) == SfzSampleFormat::int24 );
+    const auto data = SfzFilePool::readPreloadedData(*reader, { 0, numFrames });
+    REQUIRE( data->getFormat() == SfzSampleFormat::int24 );
+    for (int frameIdx = 0; frameIdx < numFrames; ++frameIdx)
+        REQUIRE( data->getSample(0, frameIdx) == Approx(frames[static_cast<size_t>(frameIdx)] / 2147483648.0).margin(1e-6) );
+
+    std::filesystem::remove_all(directory);
+}
+
+namespace
+{
+// Longer than the preloaded data and the stream ring together
+constexpr int streamedSampleLength { config::preloadSize + config::streamBufferSize + 20000 };
+
+// Noise, so that a frame read from the wrong position does not go unnoticed
+bool writeNoise(const std::filesystem::path& path, int numFrames)
+{
+    const File file { path.string() };
+    file.deleteFile();
+    auto stream = std::make_unique<FileOutputStream>(file);
+    WavAudioFormat format;
+    std::unique_ptr<AudioFormatWriter> writer { format.createWriterFor(stream.get(), 48000, 1, 16, {}, 0) };
+    if (writer == nullptr)
+        return false;
+    stream.release();
+
+    AudioBuffer<float> buffer { 1, numFrames };
+    Random random { 42 };
+    for (int frameIdx = 0; frameIdx < numFrames; ++frameIdx)
+        buffer.setSample(0, frameIdx, random.nextFloat() - 0.5f);
+    return writer->writeFromAudioSampleBuffer(buffer, 0, numFrames);
+}
+
+AudioBuffer<float> decodeWholeFile(const std::filesystem::path& path)
+{
+    AudioFormatManager formatManager;
+    formatManager.registerBasicFormats();
+    std::unique_ptr<AudioFormatReader> reader { formatManager.createReaderFor(File(path.string())) };
+    if (reader == nullptr)
+        return {};
+    AudioBuffer<float> buffer { static_cast<int>(reader->numChannels), static_cast<int>(reader->lengthInSamples) };
+    reader->read(&buffer, 0, buffer.getNumSamples(), 0, true, true);
+    return buffer;
+}
+}
+
+TEST_CASE("Streamed samples", "File tests")
+{
+    const auto directory = std::filesystem::temp_directory_path() / "sfizz_stream_tests";
+    std::filesystem::create_directories(directory);
+    constexpr int blockSize { 256 };
+    SfzSynth synth;
+    // The ring is refilled as soon as the voice asks for it, so that the output does not depend on the disk
+    synth.setSynchronousLoading(true);
+
+    // Plays a noise sample at its pitch, which misses the sample cache since the file was just written; returns the left channel
+    auto playNoise = [&](const std::string& name, const std::string& opcodes, int numFrames) {
+        REQUIRE( writeNoise(directory / (name + ".wav"), streamedSampleLength) );
+        std::ofstream { directory / (name + ".sfz") } << "<region> key=60 pitch_keycenter=60 sample=" << name << ".wav " << opcodes;
+        synth.loadSfzFile(directory / (name + ".sfz"));
+        REQUIRE( synth.getNumRegions() == 1 );
+        synth.prepareToPlay(48000, blockSize);
+        synth.registerNoteOn(1, 60, 127, 0);
+
+        AudioBuffer<float> buffer { 2, blockSize };
+        std::vector<float> left;
+        for (int frameIdx = 0; frameIdx < numFrames; frameIdx += blockSize)
+        {
+            buffer.clear();
+            synth.renderNextBlock(buffer, 0, blockSize);
+            left.insert(left.end(), buffer.getReadPointer(0), buffer.getReadPointer(0) + blockSize);
+        }
+        return left;
+    };
+
+    // The gain of the note, from the loudest of the first frames
+    auto getGain = [](const std::vector<float>& output, const float* expected) {
+        int loudestIdx { 0 };
+        for (int frameIdx = 1; frameIdx < blockSize; ++frameIdx)
+        {
+            if (std::abs(expected[frameIdx]) > std::abs(expected[loudestIdx]))
+                loudestIdx = frameIdx;
+        }
+        return output[static_cast<size_t>(loudestIdx)] / expected[loudestIdx];
+    };
+
+    SECTION("One-shot samples play to their last frame")
+    {
+        const auto output = playNoise("one_shot", "loop_mode=one_shot", streamedSampleLength + 8 * blockSize);
+        const auto expected = decodeWholeFile(directory / "one_shot.wav");
+        REQUIRE( expected.getNumSamples() == streamedSampleLength );
+        const auto gain = getGain(output, expected.getReadPointer(0));
+        REQUIRE( gain > 0.0f );
+        for (int frameIdx = 0; frameIdx < streamedSampleLength; ++frameIdx)
+        {
+            INFO( "Frame " << frameIdx );
+            REQUIRE( output[static_cast<size_t>(frameIdx)] == Approx(gain * expected.getSample(0, frameIdx)).margin(1e-6) );
+        }
+        for (size_t frameIdx = streamedSampleLength; frameIdx < output.size(); ++frameIdx)
+            REQUIRE( output[frameIdx] == 0.0f );
+        REQUIRE( synth.getNumActiveVoices() == 0 );
+    }
+
+    SECTION("Loops are unrolled in the ring")
+    {
+        // The loop jumps back into the preloaded data, and its end is past the first ring wrap
+        const int loopStart { 1000 };
+        const int loopEnd { streamedSampleLength - 5000 };
+        const auto output = playNoise("looped", "loop_mode=loop_continuous loop_start=" + std::to_string(loopStart) + " loop_end=" + std::to_string(loopEnd), 3 * streamedSampleLength);
+        const auto expected = decodeWholeFile(directory / "looped.wav");
+        REQUIRE( expected.getNumSamples() == streamedSampleLength );
+        const auto loopRange = synth.getRegionView(0)->loopRange;
+        REQUIRE( static_cast<int>(loopRange.getStart()) == loopStart );
+        REQUIRE( static_cast<int>(loopRange.getEnd()) == loopEnd );
+
+        // The loop end is excluded, as when playing the file data
+        const auto lastLoopEnd = static_cast<int64>(loopRange.getEnd());
+        const auto loopLength = lastLoopEnd - loopStart;
+        const auto gain = getGain(output, expected.getReadPointer(0));
+        REQUIRE( gain > 0.0f );
+        for (size_t frameIdx = 0; frameIdx < output.size(); ++frameIdx)
+        {
+            const auto position = static_cast<int64>(frameIdx);
+            const auto filePosition = position < lastLoopEnd ? position : loopStart + (position - lastLoopEnd) % loopLength;
+            INFO( "Frame " << frameIdx );
+            REQUIRE( output[frameIdx] == Approx(gain * expected.getSample(0, static_cast<int>(filePosition))).margin(1e-6) );
+        }
+        REQUIRE( synth.getNumActiveVoices() == 1 );
+    }
+
+    std::filesystem::remove_all(directory);
 }
 
 TEST_CASE("Switches with files", "File tests")
@@ -293,4 +481,249 @@ TEST_CASE("Switches with files", "File tests")
         REQUIRE( !synth.getRegionView(2)->isSwitchedOn() );
         REQUIRE( synth.getRegionView(3)->isSwitchedOn() );
     }
-}
\ No newline at end of file
+}
+TEST_CASE("Mono regions", "File tests")
+{
+    const int blockSize { 256 };
+    SfzSynth synth;
+    synth.loadSfzFile(std::filesystem::current_path() / "Tests/TestFiles/mono_pan.sfz");
+    REQUIRE( synth.getNumRegions() == 3 );
+    REQUIRE( synth.getRegionView(0)->numChannels == 1 );
+    synth.prepareToPlay(48000, blockSize);
+    AudioBuffer<float> buffer { 2, blockSize };
+
+    SECTION("Centered mono regions play the same on both sides")
+    {
+        synth.registerNoteOn(1, 60, 100, 0);
+        synth.renderNextBlock(buffer, 0, blockSize);
+        REQUIRE( buffer.getMagnitude(0, 0, blockSize) > 0.0f );
+        for (int sampleIdx = 0; sampleIdx < blockSize; ++sampleIdx)
+            REQUIRE( buffer.getSample(1, sampleIdx) == buffer.getSample(0, sampleIdx) );
+    }
+
+    SECTION("Panning left is applied when spreading the channel")
+    {
+        synth.registerNoteOn(1, 62, 100, 0);
+        synth.renderNextBlock(buffer, 0, blockSize);
+        REQUIRE( buffer.getMagnitude(0, 0, blockSize) > 0.0f );
+        REQUIRE( buffer.getMagnitude(1, 0, blockSize) == Approx(0.0f).margin(1e-3) );
+    }
+
+    SECTION("Panning right is applied when spreading the channel")
+    {
+        synth.registerNoteOn(1, 64, 100, 0);
+        synth.renderNextBlock(buffer, 0, blockSize);
+        REQUIRE( buffer.getMagnitude(0, 0, blockSize) == Approx(0.0f).margin(1e-3) );
+        REQUIRE( buffer.getMagnitude(1, 0, blockSize) > 0.0f );
+    }
+}
+
+TEST_CASE("Oversampled rendering", "File tests")
+{
+    const int blockSize { 256 };
+    auto renderFirstBlocks = [&](int factor) {
+        SfzSynth synth;
+        synth.setOversamplingFactor(factor);
+        synth.loadSfzFile(std::filesystem::current_path() / "Tests/TestFiles/mono_pan.sfz");
+        synth.prepareToPlay(48000, blockSize);
+        REQUIRE( synth.getOversamplingFactor() == factor );
+        AudioBuffer<float> buffer { 2, blockSize };
+        synth.registerNoteOn(1, 60, 100, 0);
+        float magnitude { 0.0f };
+        for (int blockIdx = 0; blockIdx < 8; ++blockIdx)
+        {
+            synth.renderNextBlock(buffer, 0, blockSize);
+            magnitude = jmax(magnitude, buffer.getMagnitude(0, 0, blockSize));
+        }
+        REQUIRE( synth.getNumActiveVoices() == 1 );
+        return magnitude;
+    };
+
+    const auto reference = renderFirstBlocks(1);
+    REQUIRE( reference > 0.0f );
+    REQUIRE( renderFirstBlocks(2) == Approx(reference).epsilon(0.1) );
+    REQUIRE( renderFirstBlocks(4) == Approx(reference).epsilon(0.1) );
+}
+
+TEST_CASE("Note index", "File tests")
+{
+    SfzSynth synth;
+    synth.loadSfzFile(std::filesystem::current_path() / "Tests/TestFiles/note_index.sfz");
+    REQUIRE( synth.getNumRegions() == 3 );
+    synth.prepareToPlay(48000, 256);
+
+    SECTION("Only notes within a key range start voices")
+    {
+        synth.registerNoteOn(1, 61, 100, 0);
+        REQUIRE( synth.getNumActiveVoices() == 0 );
+        synth.registerNoteOn(1, 60, 100, 0);
+        REQUIRE( synth.getNumActiveVoices() == 1 );
+        synth.registerNoteOn(1, 63, 10, 0);
+        REQUIRE( synth.getNumActiveVoices() == 1 );
+        synth.registerNoteOn(1, 63, 100, 0);
+        REQUIRE( synth.getNumActiveVoices() == 2 );
+    }
+
+    SECTION("Keyswitches outside of the key range still reach the region")
+    {
+        REQUIRE( !synth.getRegionView(2)->isSwitchedOn() );
+        synth.registerNoteOn(1, 71, 100, 0);
+        REQUIRE( synth.getRegionView(2)->isSwitchedOn() );
+        REQUIRE( synth.getNumActiveVoices() == 0 );
+        synth.registerNoteOn(1, 70, 100, 0);
+        REQUIRE( !synth.getRegionView(2)->isSwitchedOn() );
+    }
+}
+
+TEST_CASE("Voice allocation", "File tests")
+{
+    SfzSynth synth;
+    synth.initalizeVoices(2);
+    synth.loadSfzFile(std::filesystem::current_path() / "Tests/TestFiles/note_index.sfz");
+    synth.prepareToPlay(48000, 256);
+
+    SECTION("New notes steal voices when the polyphony is reached")
+    {
+        REQUIRE( synth.getMaxPolyphony() == 2 );
+        synth.registerNoteOn(1, 60, 100, 0);
+        synth.registerNoteOn(1, 62, 100, 0);
+        REQUIRE( synth.getNumActiveVoices() == 2 );
+        REQUIRE( synth.getNumStolenVoices() == 0 );
+        synth.registerNoteOn(1, 63, 100, 0);
+        REQUIRE( synth.getNumActiveVoices() == 3 );
+        REQUIRE( synth.getNumStolenVoices() == 1 );
+
+        synth.clear();
+        REQUIRE( synth.getNumActiveVoices() == 0 );
+    }
+
+    SECTION("Group and note polyphony")
+    {
+        SfzSynth polyphonySynth;
+        polyphonySynth.loadSfzFile(std::filesystem::current_path() / "Tests/TestFiles/polyphony.sfz");
+        polyphonySynth.prepareToPlay(48000, 256);
+        polyphonySynth.registerNoteOn(1, 60, 100, 0);
+        polyphonySynth.registerNoteOn(1, 60, 100, 0);
+        REQUIRE( polyphonySynth.getNumStolenVoices() == 1 );
+        polyphonySynth.registerNoteOn(1, 62, 100, 0);
+        REQUIRE( polyphonySynth.getNumStolenVoices() == 1 );
+        polyphonySynth.registerNoteOn(1, 62, 100, 0);
+        REQUIRE( polyphonySynth.getNumStolenVoices() == 2 );
+        REQUIRE( polyphonySynth.getNumActiveVoices() == 4 );
+    }
+
+    SECTION("Off groups release every voice when no voice is left")
+    {
+        SfzSynth offBySynth;
+        offBySynth.setSynchronousLoading(true);
+        offBySynth.initalizeVoices(2);
+        offBySynth.loadSfzFile(std::filesystem::current_path() / "Tests/TestFiles/off_by.sfz");
+        offBySynth.prepareToPlay(48000, 256);
+        // The stolen voices fade out on their own voices, which uses up the headroom
+        const int numPhysicalVoices { 2 + config::voiceHeadroom };
+        for (int noteNumber = 30; noteNumber < 30 + numPhysicalVoices; ++noteNumber)
+            offBySynth.registerNoteOn(1, noteNumber, 100, 0);
+        REQUIRE( offBySynth.getNumActiveVoices() == numPhysicalVoices );
+        REQUIRE( offBySynth.getNumStolenVoices() == config::voiceHeadroom );
+
+        // The note-offs look for voices for the release region while the group is turned off
+        offBySynth.registerNoteOn(1, 60, 100, 0);
+        AudioBuffer<float> buffer { 2, 256 };
+        for (int blockIdx = 0; blockIdx < 16; ++blockIdx)
+            offBySynth.renderNextBlock(buffer, 0, 256);
+        REQUIRE( offBySynth.getNumActiveVoices() == 0 );
+    }
+}
+
+TEST_CASE("Instrument cache", "File tests")
+{
+    const auto cacheDirectory = std::filesystem::temp_directory_path() / "sfizz_cache_tests";
+    std::filesystem::remove_all(cacheDirectory);
+
+    SECTION("Reload from the cache")
+    {
+        const auto sfzFile = std::filesystem::current_path() / "Tests/TestFiles/Includes/multiple_includes.sfz";
+        SfzSynth synth;
+        synth.setInstrumentCacheDirectory(File(cacheDirectory.string()));
+        synth.loadSfzFile(sfzFile);
+        REQUIRE( !synth.wasLoadedFromCache() );
+
+        SfzSynth cachedSynth;
+        cachedSynth.setInstrumentCacheDirectory(File(cacheDirectory.string()));
+        cachedSynth.loadSfzFile(sfzFile);
+        REQUIRE( cachedSynth.wasLoadedFromCache() );
+        REQUIRE( cachedSynth.getNumRegions() == 2 );
+        REQUIRE( cachedSynth.getRegionView(0)->sample == "dummy.wav" );
+        REQUIRE( cachedSynth.getRegionView(1)->sample == "dummy2.wav" );
+        REQUIRE( cachedSynth.getIncludedFiles() == synth.getIncludedFiles() );
+    }
+
+    SECTION("Switches and defines survive the cache")
+    {
+        SfzSynth synth;
+        synth.setInstrumentCacheDirectory(File(cacheDirectory.string()));
+        synth.loadSfzFile(std::filesystem::current_path() / "Tests/TestFiles/sw_default.sfz");
+        synth.loadSfzFile(std::filesystem::current_path() / "Tests/TestFiles/sw_default.sfz");
+        REQUIRE( synth.wasLoadedFromCache() );
+        REQUIRE( synth.getNumRegions() == 4 );
+        REQUIRE( !synth.getRegionView(0)->isSwitchedOn() );
+        REQUIRE( synth.getRegionView(1)->isSwitchedOn() );
+
+        synth.loadSfzFile(std::filesystem::current_path() / "Tests/TestFiles/defines.sfz");
+        synth.loadSfzFile(std::filesystem::current_path() / "Tests/TestFiles/defines.sfz");
+        REQUIRE( synth.wasLoadedFromCache() );
+        REQUIRE( synth.getDefines().size() == 3 );
+        REQUIRE( synth.getRegionView(1)->keyRange == Range<uint8_t>(38, 38) );
+    }
+
+    SECTION("Modified files invalidate the cache")
+    {
+        const auto sfzFile = cacheDirectory / "modified.sfz";
+        std::filesystem::create_directories(cacheDirectory);
+        std::ofstream { sfzFile } << "<region> key=60 sample=*sine";
+
+        SfzSynth synth;
+        synth.setInstrumentCacheDirectory(File(cacheDirectory.string()));
+        synth.loadSfzFile(sfzFile);
+        synth.loadSfzFile(sfzFile);
+        REQUIRE( synth.wasLoadedFromCache() );
+
+        std::ofstream { sfzFile } << "<region> key=60 sample=*sine <region> key=62 sample=*sine";
+        synth.loadSfzFile(sfzFile);
+        REQUIRE( !synth.wasLoadedFromCache() );
+        REQUIRE( synth.getNumRegions() == 2 );
+    }
+
+    SECTION("The sample index avoids reading the sample headers again")
+    {
+        const auto sfzFile = std::filesystem::current_path() / "Tests/TestFiles/SpecificBugs/MeatBassPizz/Programs/pizz.sfz";
+        SfzSynth synth;
+        synth.setInstrumentCacheDirectory(File(cacheDirectory.string()));
+        synth.loadSfzFile(sfzFile);
+        REQUIRE( synth.getNumMetadataReads() == 4 );
+
+        // Without the instrument cache the file is parsed again, but the samples are indexed
+        for (auto& entry: std::filesystem::directory_iterator(cacheDirectory))
+        {
+            if (entry.path().extension() == SfzInstrumentCache::extension)
+                std::filesystem::remove(entry.path());
+        }
+
+        SfzSynth indexedSynth;
+        indexedSynth.setInstrumentCacheDirectory(File(cacheDirectory.string()));
+        indexedSynth.loadSfzFile(sfzFile);
+        REQUIRE( !indexedSynth.wasLoadedFromCache() );
+        REQUIRE( indexedSynth.getNumMetadataReads() == 0 );
+        REQUIRE( indexedSynth.getNumRegions() == synth.getNumRegions() );
+        for (int i = 0; i < synth.getNumRegions(); ++i)
+        {
+            REQUIRE( indexedSynth.getRegionView(i)->sampleEnd == synth.getRegionView(i)->sampleEnd );
+            REQUIRE( indexedSynth.getRegionView(i)->numChannels == synth.getRegionView(i)->numChannels );
+            // 24 bit files, kept as such
+            REQUIRE( synth.getRegionView(i)->sampleMetadata->format == SfzSampleFormat::int24 );
+            REQUIRE( indexedSynth.getRegionView(i)->sampleMetadata->format == SfzSampleFormat::int24 );
+        }
+    }
+
+    std::filesystem::remove_all(cacheDirectory);
+}
@@ -0,0 +1,49 @@
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "catch2/catch.hpp"
+#include "../Source/SfzGarbageCollector.h"
+#include <memory>
+
+namespace
+{
+void waitForCollection(SfzGarbageCollector& collector)
+{
+    collector.collectGarbage();
+    while (collector.getNumPending() > 0)
+        Thread::sleep(1);
+}
+}
+
+TEST_CASE("Garbage collector", "Garbage collector tests")
+{
+    SfzGarbageCollector collector;
+    const size_t bufferSize { 2 * 1000 * sizeof(float) };
+
+    SECTION("Buffers are freed on collection")
+    {
+        SfzGarbageCollector::Buffer buffer = std::make_shared<const SfzSampleBuffer>(SfzSampleFormat::float32, 2, 1000);
+        collector.collect(buffer);
+        REQUIRE( buffer == nullptr );
+        waitForCollection(collector);
+        REQUIRE( collector.getReclaimedBytes() == bufferSize );
+        REQUIRE( collector.getNumReclaimedBuffers() == 1 );
+        REQUIRE( collector.getNumDroppedInPlace() == 0 );
+    }
+
+    SECTION("Buffers still in use are not counted")
+    {
+        SfzGarbageCollector::Buffer buffer = std::make_shared<const SfzSampleBuffer>(SfzSampleFormat::float32, 2, 1000);
+        auto otherOwner = buffer;
+        collector.collect(buffer);
+        waitForCollection(collector);
+        REQUIRE( otherOwner.use_count() == 1 );
+        REQUIRE( collector.getReclaimedBytes() == 0 );
+        REQUIRE( collector.getNumReclaimedBuffers() == 0 );
+    }
+
+    SECTION("Empty buffers are ignored")
+    {
+        SfzGarbageCollector::Buffer buffer;
+        collector.collect(buffer);
+        REQUIRE( collector.getNumPending() == 0 );
+    }
+}
@@ -0,0 +1,67 @@
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "catch2/catch.hpp"
+#include "../Source/SfzInstrumentLoader.h"
+#include <filesystem>
+
+namespace
+{
+constexpr int blockSize { 256 };
+
+File testFile(const char* name)
+{
+    return File((std::filesystem::current_path() / "Tests/TestFiles" / name).string());
+}
+
+template<class Predicate>
+bool waitFor(Predicate&& predicate)
+{
+    for (int attempt = 0; attempt < 500; ++attempt)
+    {
+        if (predicate())
+            return true;
+        Thread::sleep(10);
+    }
+    return false;
+}
+
+void renderBlock(SfzInstrumentLoader& loader, AudioBuffer<float>& buffer)
+{
+    buffer.clear();
+    loader.beginBlock();
+    loader.getActiveSynth().renderNextBlock(buffer, 0, blockSize);
+    if (auto* fadingSynth = loader.getFadingSynth())
+        fadingSynth->renderNextBlock(buffer, 0, blockSize);
+    loader.endBlock();
+}
+}
+
+TEST_CASE("Instrument hot-swap", "Instrument loader tests")
+{
+    SfzInstrumentLoader loader;
+    loader.prepareToPlay(48000, blockSize);
+    AudioBuffer<float> buffer { config::numChannels, blockSize };
+    REQUIRE( loader.getActiveSynth().getNumRegions() == 0 );
+
+    loader.load(testFile("note_index.sfz"));
+    REQUIRE( waitFor([&]() { return loader.withLatestSynth([](const SfzSynth& synth) { return synth.getNumRegions(); }) == 3; }) );
+    renderBlock(loader, buffer);
+    REQUIRE( loader.getActiveSynth().getNumRegions() == 3 );
+    // Nothing was playing on the empty synth
+    REQUIRE( loader.getFadingSynth() == nullptr );
+
+    loader.getActiveSynth().registerNoteOn(1, 60, 100, 0);
+    renderBlock(loader, buffer);
+    REQUIRE( loader.getActiveSynth().getNumActiveVoices() == 1 );
+
+    // The previous instrument keeps playing its release until its voices are done
+    loader.load(testFile("full_keyboard.sfz"));
+    REQUIRE( waitFor([&]() { return loader.withLatestSynth([](const SfzSynth& synth) { return synth.getNumRegions(); }) == 1; }) );
+    renderBlock(loader, buffer);
+    REQUIRE( loader.getActiveSynth().getNumRegions() == 1 );
+    REQUIRE( loader.getFadingSynth() != nullptr );
+    REQUIRE( loader.getFadingSynth()->getNumRegions() == 3 );
+    REQUIRE( waitFor([&]() {
+        renderBlock(loader, buffer);
+        return loader.getFadingSynth() == nullptr;
+    }) );
+}
@@ -0,0 +1,207 @@
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "catch2/catch.hpp"
+#include "../Source/SfzInterpolation.h"
+#include <vector>
+using namespace Catch::literals;
+
+namespace
+{
+// Reference: the per-sample accumulation the voices used before the kernels
+std::vector<float> referenceInterpolation(const std::vector<float>& source, int index, float fraction, float step, int numFrames)
+{
+    std::vector<float> output;
+    for (int frame = 0; frame < numFrames; ++frame)
+    {
+        const float position = fraction + static_cast<float>(frame) * step;
+        const int offset = static_cast<int>(position);
+        const float weight = position - static_cast<float>(offset);
+        const auto current = source[index + offset];
+        const auto next = source[index + offset + 1];
+        output.push_back(current + weight * (next - current));
+    }
+    return output;
+}
+
+std::vector<float> ramp(int size)
+{
+    std::vector<float> values;
+    for (int i = 0; i < size; ++i)
+        values.push_back(static_cast<float>(i * i % 97) / 97.0f);
+    return values;
+}
+}
+
+TEST_CASE("Linear interpolation kernel", "Interpolation tests")
+{
+    const auto source = ramp(4096);
+    for (const float step: { 1.0f, 0.5f, 0.37f, 1.41f, 2.0f, 3.9f })
+    {
+        for (const int numFrames: { 1, 3, 4, 17, 256 })
+        {
+            std::vector<float> left(numFrames);
+            std::vector<float> right(numFrames);
+            const float* sources[2] { source.data(), source.data() };
+            float* outputs[2] { left.data(), right.data() };
+            SfzInterpolation::linear(sources, outputs, 2, 10, 0.25f, step, numFrames);
+
+            const auto expected = referenceInterpolation(source, 10, 0.25f, step, numFrames);
+            for (int frame = 0; frame < numFrames; ++frame)
+            {
+                REQUIRE( left[frame] == Approx(expected[frame]).margin(1e-6) );
+                REQUIRE( right[frame] == Approx(expected[frame]).margin(1e-6) );
+            }
+        }
+    }
+}
+
+TEST_CASE("Contiguous runs", "Interpolation tests")
+{
+    SECTION("Runs never read past the last index")
+    {
+        for (const float step: { 0.3f, 1.0f, 1.7f, 4.0f })
+        {
+            for (const float fraction: { 0.0f, 0.5f, 0.99f })
+            {
+                const int runLength = SfzInterpolation::framesInRun(100, fraction, step, 200, 1000);
+                REQUIRE( runLength > 0 );
+                REQUIRE( 100 + SfzInterpolation::offsetAt(fraction, step, runLength - 1) + 1 <= 200 );
+            }
+        }
+    }
+
+    SECTION("Runs are bounded by the requested frames")
+    {
+        REQUIRE( SfzInterpolation::framesInRun(0, 0.0f, 1.0f, 10000, 64) == 64 );
+    }
+
+    SECTION("No run at the boundary")
+    {
+        REQUIRE( SfzInterpolation::framesInRun(199, 0.0f, 1.0f, 200, 64) == 0 );
+        REQUIRE( SfzInterpolation::framesInRun(200, 0.0f, 1.0f, 200, 64) == 0 );
+    }
+
+    SECTION("Advancing matches the per-frame position")
+    {
+        int index { 10 };
+        float fraction { 0.25f };
+        SfzInterpolation::advance(index, fraction, 1.5f, 3);
+        REQUIRE( index == 14 );
+        REQUIRE( fraction == 0.75_a );
+    }
+}
+
+TEST_CASE("Integer sample kernels", "Interpolation tests")
+{
+    const auto source = ramp(4096);
+    std::vector<int16_t> source16;
+    std::vector<SfzInt24> source24;
+    std::vector<float> converted16;
+    std::vector<float> converted24;
+    for (auto value: source)
+    {
+        source16.push_back(static_cast<int16_t>(value * 32767.0f));
+        source24.push_back(SfzInt24::fromInt(static_cast<int32_t>(value * -8388607.0f)));
+        converted16.push_back(SfzSampleTraits<int16_t>::toFloat(source16.back()));
+        converted24.push_back(SfzSampleTraits<SfzInt24>::toFloat(source24.back()));
+    }
+
+    REQUIRE( SfzInt24::fromInt(-8388608).toInt() == -8388608 );
+    REQUIRE( SfzInt24::fromInt(8388607).toInt() == 8388607 );
+    REQUIRE( SfzInt24::fromInt(-1).toInt() == -1 );
+
+    for (const float step: { 1.0f, 0.37f, 2.0f })
+    {
+        const int numFrames { 67 };
+        std::vector<float> output16(numFrames);
+        std::vector<float> output24(numFrames);
+        const int16_t* sources16[1] { source16.data() };
+        const SfzInt24* sources24[1] { source24.data() };
+        float* outputs16[1] { output16.data() };
+        float* outputs24[1] { output24.data() };
+        SfzInterpolation::linear(sources16, outputs16, 1, 10, 0.25f, step, numFrames);
+        SfzInterpolation::linear(sources24, outputs24, 1, 10, 0.25f, step, numFrames);
+
+        const auto expected16 = referenceInterpolation(converted16, 10, 0.25f, step, numFrames);
+        const auto expected24 = referenceInterpolation(converted24, 10, 0.25f, step, numFrames);
+        for (int frame = 0; frame < numFrames; ++frame)
+        {
+            REQUIRE( output16[frame] == Approx(expected16[frame]).margin(1e-6) );
+            REQUIRE( output24[frame] == Approx(expected24[frame]).margin(1e-6) );
+        }
+    }
+}
+
+TEST_CASE("Unity ratio copies", "Interpolation tests")
+{
+    const auto source = ramp(512);
+    std::vector<int16_t> source16;
+    for (auto value: source)
+        source16.push_back(static_cast<int16_t>(value * 32767.0f));
+
+    // The copy matches interpolating at unit speed with a zero fraction, and reads no further than the run
+    for (const int numFrames: { 1, 5, 64 })
+    {
+        const int lastIndex { 10 + numFrames - 1 };
+        std::vector<float> copied(numFrames);
+        std::vector<float> interpolated(numFrames);
+        const float* sources[1] { source.data() };
+        float* copyOutputs[1] { copied.data() };
+        float* interpolatedOutputs[1] { interpolated.data() };
+        SfzInterpolation::copy(sources, copyOutputs, 1, 10, numFrames);
+        SfzInterpolation::linear(sources, interpolatedOutputs, 1, 10, 0.0f, 1.0f, numFrames);
+        REQUIRE( copied == interpolated );
+        REQUIRE( copied.back() == source[static_cast<size_t>(lastIndex)] );
+
+        const int16_t* sources16[1] { source16.data() };
+        SfzInterpolation::copy(sources16, copyOutputs, 1, 10, numFrames);
+        for (int frame = 0; frame < numFrames; ++frame)
+            REQUIRE( copied[frame] == SfzSampleTraits<int16_t>::toFloat(source16[static_cast<size_t>(10 + frame)]) );
+    }
+}
+
+TEST_CASE("Sample buffers", "Interpolation tests")
+{
+    SECTION("Storage size follows the format and channel count")
+    {
+        REQUIRE( SfzSampleBuffer(SfzSampleFormat::int16, 1, 1000).getSizeInBytes() == 2000 );
+        REQUIRE( SfzSampleBuffer(SfzSampleFormat::int24, 2, 1000).getSizeInBytes() == 6000 );
+        REQUIRE( SfzSampleBuffer(SfzSampleFormat::float32, 2, 1000).getSizeInBytes() == 8000 );
+        REQUIRE( SfzSampleBuffer(SfzSampleFormat::float32, 6, 1000).getNumChannels() == SfzSampleBuffer::maxChannels );
+        REQUIRE( SfzSampleBuffer::getSizeInBytes(SfzSampleFormat::int24, 1, 1000) == 3000 );
+        REQUIRE( SfzSampleBuffer::getSizeInBytes(SfzSampleFormat::int16, 6, 1000) == 4000 );
+    }
+
+    SECTION("Mono buffers play on both channels")
+    {
+        SfzSampleBuffer buffer { SfzSampleFormat::int16, 1, 64 };
+        for (int i = 0; i < 64; ++i)
+            buffer.getWritePointer<int16_t>(0)[i] = static_cast<int16_t>(i * 256);
+
+        std::vector<float> left(16);
+        std::vector<float> right(16);
+        float* outputs[2] { left.data(), right.data() };
+        SfzInterpolation::linear(buffer, outputs, 2, 4, 0.5f, 1.0f, 16);
+        for (int frame = 0; frame < 16; ++frame)
+        {
+            REQUIRE( left[frame] == Approx((4.5f + frame) * 256.0f / 32768.0f) );
+            REQUIRE( right[frame] == left[frame] );
+        }
+        REQUIRE( buffer.getSample(1, 10) == buffer.getSample(0, 10) );
+    }
+
+    SECTION("Copies keep the format")
+    {
+        SfzSampleBuffer source { SfzSampleFormat::int24, 2, 10 };
+        for (int i = 0; i < 10; ++i)
+        {
+            source.getWritePointer<SfzInt24>(0)[i] = SfzInt24::fromInt(i * 1000);
+            source.getWritePointer<SfzInt24>(1)[i] = SfzInt24::fromInt(-i * 1000);
+        }
+
+        SfzSampleBuffer destination { SfzSampleFormat::int24, 2, 20 };
+        destination.copyFrom(5, source);
+        REQUIRE( destination.getSample(0, 4) == 0.0f );
+        REQUIRE( destination.getSample(0, 8) == source.getSample(0, 3) );
+        REQUIRE( destination.getSample(1, 14) == source.getSample(1, 9) );
+    }
+}
@@ -0,0 +1,98 @@
+#include "catch2/catch.hpp"
+#include "../Source/SfzLockFreeQueue.h"
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+TEST_CASE("Single thread", "Lock-free queue tests")
+{
+    SfzLockFreeQueue<int> queue { 3 };
+    REQUIRE( queue.getCapacity() == 4 );
+
+    int value { 0 };
+    REQUIRE( !queue.tryPop(value) );
+
+    SECTION("First in, first out")
+    {
+        for (int i = 0; i < 4; ++i)
+            REQUIRE( queue.tryPush(i) );
+        for (int i = 0; i < 4; ++i)
+        {
+            REQUIRE( queue.tryPop(value) );
+            REQUIRE( value == i );
+        }
+        REQUIRE( !queue.tryPop(value) );
+    }
+
+    SECTION("Pushing to a full queue fails")
+    {
+        for (int i = 0; i < 4; ++i)
+            REQUIRE( queue.tryPush(i) );
+        REQUIRE( !queue.tryPush(4) );
+        REQUIRE( queue.tryPop(value) );
+        REQUIRE( queue.tryPush(4) );
+    }
+
+    SECTION("Wrapping around")
+    {
+        for (int i = 0; i < 100; ++i)
+        {
+            REQUIRE( queue.tryPush(i) );
+            REQUIRE( queue.tryPop(value) );
+            REQUIRE( value == i );
+        }
+    }
+}
+
+TEST_CASE("Multiple producers and consumers", "Lock-free queue tests")
+{
+    constexpr int numThreads { 4 };
+    constexpr int valuesPerProducer { 20000 };
+    SfzLockFreeQueue<int> queue { 64 };
+    std::vector<std::vector<int>> popped (numThreads);
+    std::atomic<int> numPopped { 0 };
+
+    std::vector<std::thread> threads;
+    for (int threadIdx = 0; threadIdx < numThreads; ++threadIdx)
+    {
+        threads.emplace_back([&, threadIdx]() {
+            for (int i = 0; i < valuesPerProducer; ++i)
+                while (!queue.tryPush(threadIdx * valuesPerProducer + i))
+                    std::this_thread::yield();
+        });
+        threads.emplace_back([&, threadIdx]() {
+            int value { 0 };
+            while (numPopped.load() < numThreads * valuesPerProducer)
+            {
+                if (queue.tryPop(value))
+                {
+                    popped[threadIdx].push_back(value);
+                    numPopped++;
+                }
+                else
+                {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (auto& thread: threads)
+        thread.join();
+
+    // Every value came out exactly once, and in order for a given producer and consumer
+    std::vector<int> allValues;
+    for (const auto& values: popped)
+    {
+        for (size_t i = 1; i < values.size(); ++i)
+        {
+            if (values[i] / valuesPerProducer == values[i - 1] / valuesPerProducer)
+                REQUIRE( values[i] > values[i - 1] );
+        }
+        allValues.insert(allValues.end(), values.begin(), values.end());
+    }
+    std::sort(allValues.begin(), allValues.end());
+    REQUIRE( allValues.size() == numThreads * valuesPerProducer );
+    for (int i = 0; i < numThreads * valuesPerProducer; ++i)
+        REQUIRE( allValues[i] == i );
+}
@@ -0,0 +1,108 @@
+#include "catch2/catch.hpp"
+#include "../Source/SfzOscillator.h"
+#include <algorithm>
+#include <cmath>
+#include <numeric>
+#include <vector>
+
+namespace
+{
+constexpr double sampleRate { 48000.0 };
+
+std::vector<float> render(SfzWaveform waveform, double frequency, int numSamples, int blockSize = 64)
+{
+    SfzOscillator oscillator;
+    oscillator.prepare(waveform, frequency, sampleRate);
+    std::vector<float> output (static_cast<size_t>(numSamples));
+    for (int offset = 0; offset < numSamples; offset += blockSize)
+        oscillator.render(output.data() + offset, std::min(blockSize, numSamples - offset));
+    return output;
+}
+
+int countRisingZeroCrossings(const std::vector<float>& signal)
+{
+    int crossings { 0 };
+    for (size_t index = 1; index < signal.size(); ++index)
+        if (signal[index - 1] < 0.0f && signal[index] >= 0.0f)
+            crossings++;
+    return crossings;
+}
+}
+
+TEST_CASE("Generator names", "[oscillator]")
+{
+    REQUIRE( SfzOscillator::waveformFromName("*sine") == SfzWaveform::sine );
+    REQUIRE( SfzOscillator::waveformFromName("*saw") == SfzWaveform::saw );
+    REQUIRE( SfzOscillator::waveformFromName("*square") == SfzWaveform::square );
+    REQUIRE( SfzOscillator::waveformFromName("*triangle") == SfzWaveform::triangle );
+    REQUIRE( SfzOscillator::waveformFromName("*tri") == SfzWaveform::triangle );
+    REQUIRE( SfzOscillator::waveformFromName("*noise") == SfzWaveform::noise );
+    REQUIRE( SfzOscillator::waveformFromName("*silence") == SfzWaveform::silence );
+    REQUIRE( SfzOscillator::waveformFromName("*unknown") == SfzWaveform::silence );
+}
+
+TEST_CASE("Sine oscillator", "[oscillator]")
+{
+    SECTION("Matches std::sin")
+    {
+        const auto output = render(SfzWaveform::sine, 440.0, 4800);
+        for (size_t index = 0; index < output.size(); ++index)
+            REQUIRE( output[index] == Approx(std::sin(2.0 * M_PI * 440.0 * static_cast<double>(index) / sampleRate)).margin(1e-5) );
+    }
+
+    SECTION("The phase does not drift on long notes")
+    {
+        // About 100 seconds at 48 kHz
+        const int numSamples { 4800000 };
+        const auto output = render(SfzWaveform::sine, 1000.0, numSamples, 512);
+        for (int index = numSamples - 48; index < numSamples; ++index)
+            REQUIRE( output[static_cast<size_t>(index)] == Approx(std::sin(2.0 * M_PI * 1000.0 * index / sampleRate)).margin(1e-4) );
+    }
+}
+
+TEST_CASE("Band-limited oscillators", "[oscillator]")
+{
+    for (auto waveform: { SfzWaveform::saw, SfzWaveform::square, SfzWaveform::triangle })
+    {
+        const auto output = render(waveform, 100.0, 48000);
+        // One period per 480 samples: a full second holds 100 periods
+        REQUIRE( countRisingZeroCrossings(output) == Approx(100).margin(1) );
+        REQUIRE( *std::max_element(output.begin(), output.end()) < 1.1f );
+        REQUIRE( *std::min_element(output.begin(), output.end()) > -1.1f );
+        const auto mean = std::accumulate(output.begin(), output.end(), 0.0) / output.size();
+        REQUIRE( mean == Approx(0.0).margin(0.01) );
+    }
+
+    SECTION("The saw step is spread over the neighbouring samples")
+    {
+        const auto output = render(SfzWaveform::saw, 1100.0, 96);
+        // A period lasts 43.6 samples: the wrap is between samples 43 and 44, where the naive saw is at 0.97 and -0.98
+        REQUIRE( output[43] < 0.9f );
+        REQUIRE( output[44] > -0.9f );
+        REQUIRE( output[42] > output[41] );
+    }
+
+    SECTION("The triangle is continuous")
+    {
+        const auto output = render(SfzWaveform::triangle, 1000.0, 960);
+        const auto slope = 4.0f * 1000.0f / static_cast<float>(sampleRate);
+        for (size_t index = 1; index < output.size(); ++index)
+            REQUIRE( std::abs(output[index] - output[index - 1]) <= slope + 1e-5f );
+    }
+}
+
+TEST_CASE("Noise oscillator", "[oscillator]")
+{
+    const auto output = render(SfzWaveform::noise, 0.0, 48000);
+    REQUIRE( *std::max_element(output.begin(), output.end()) <= 1.0f );
+    REQUIRE( *std::min_element(output.begin(), output.end()) >= -1.0f );
+    const auto mean = std::accumulate(output.begin(), output.end(), 0.0) / output.size();
+    REQUIRE( mean == Approx(0.0).margin(0.02) );
+    REQUIRE( std::adjacent_find(output.begin(), output.end()) == output.end() );
+}
+
+TEST_CASE("Silence", "[oscillator]")
+{
+    const auto output = render(SfzWaveform::silence, 440.0, 256);
+    REQUIRE( std::all_of(output.begin(), output.end(), [](float value) { return value == 0.0f; }) );
+}
@@ -0,0 +1,252 @@
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "catch2/catch.hpp"
+#include "../Source/SfzOversampling.h"
+#include "../Source/SfzSimdDispatch.h"
+#include "../Source/SfzSynth.h"
+#include <algorithm>
+#include <cmath>
+#include <filesystem>
+#include <functional>
+#include <memory>
+#include <vector>
+
+namespace
+{
+constexpr double outputRate { 48000.0 };
+const SfzSimdLevel allLevels[] { SfzSimdLevel::scalar, SfzSimdLevel::sse2, SfzSimdLevel::avx2, SfzSimdLevel::avx512, SfzSimdLevel::neon };
+
+// Puts back the detected level when a test case ends
+struct LevelGuard
+{
+    ~LevelGuard() { SfzSimd::setLevel(SfzSimd::detectLevel()); }
+};
+
+// The stages of SfzVoiceBatch, with the kernels in use: a factor of 4 goes through the first stage, in place, before the last one
+struct DecimationChain
+{
+    explicit DecimationChain(int chainFactor)
+    : factor(chainFactor)
+    {
+        const auto& kernels = SfzSimd::getKernels();
+        lastStage = kernels.createDecimator(SfzOversampling::lastStageOrder);
+        lastStage->setCoefs(SfzOversampling::lastStageCoefs);
+        if (factor == 4)
+        {
+            firstStage = kernels.createDecimator(SfzOversampling::firstStageOrder);
+            firstStage->setCoefs(SfzOversampling::firstStageCoefs);
+        }
+    }
+
+    int getNumLanes() const noexcept { return lastStage->getNumLanes(); }
+
+    void clearLane(int lane) noexcept
+    {
+        if (firstStage != nullptr)
+            firstStage->clearLane(lane);
+        lastStage->clearLane(lane);
+    }
+
+    // Decimates numSamples * factor interleaved frames in place
+    void process(float* buffer, int numSamples) noexcept
+    {
+        if (firstStage != nullptr)
+            firstStage->process(buffer, buffer, numSamples * 2);
+        lastStage->process(buffer, buffer, numSamples);
+    }
+
+    int factor;
+    std::unique_ptr<SfzLaneDecimator> firstStage;
+    std::unique_ptr<SfzLaneDecimator> lastStage;
+};
+
+using LaneSignal = std::function<float(int64_t frame, double rate)>;
+
+LaneSignal sine(double frequency)
+{
+    return [frequency](int64_t frame, double rate) { return static_cast<float>(std::sin(2.0 * M_PI * frequency * static_cast<double>(frame) / rate)); };
+}
+
+// Decimates the signal rendered at factor times the output rate on one lane, and silence on the others; returns every lane
+std::vector<std::vector<float>> decimate(DecimationChain& chain, int lane, const LaneSignal& signal, int numSamples, int blockSize = 64)
+{
+    const auto numLanes = chain.getNumLanes();
+    const auto rate = outputRate * chain.factor;
+    std::vector<float> buffer (static_cast<size_t>(blockSize * chain.factor * numLanes));
+    std::vector<std::vector<float>> lanes (static_cast<size_t>(numLanes), std::vector<float>(static_cast<size_t>(numSamples)));
+    int64_t frame { 0 };
+    for (int offset = 0; offset < numSamples; offset += blockSize)
+    {
+        const auto blockSamples = std::min(blockSize, numSamples - offset);
+        std::fill(buffer.begin(), buffer.end(), 0.0f);
+        for (int index = 0; index < blockSamples * chain.factor; ++index, ++frame)
+            buffer[static_cast<size_t>(index * numLanes + lane)] = signal(frame, rate);
+        chain.process(buffer.data(), blockSamples);
+        for (int laneIdx = 0; laneIdx < numLanes; ++laneIdx)
+            for (int index = 0; index < blockSamples; ++index)
+                lanes[static_cast<size_t>(laneIdx)][static_cast<size_t>(offset + index)] = buffer[static_cast<size_t>(index * numLanes + laneIdx)];
+    }
+    return lanes;
+}
+
+float peak(const std::vector<float>& signal, size_t start)
+{
+    float maximum { 0.0f };
+    for (size_t index = start; index < signal.size(); ++index)
+        maximum = std::max(maximum, std::abs(signal[index]));
+    return maximum;
+}
+
+std::unique_ptr<SfzSynth> makeSineSynth(int oversamplingFactor, int blockSize)
+{
+    auto synth = std::make_unique<SfzSynth>();
+    synth->setOversamplingFactor(oversamplingFactor);
+    synth->loadSfzFile(std::filesystem::current_path() / "Tests/TestFiles/full_keyboard.sfz");
+    synth->prepareToPlay(outputRate, blockSize);
+    return synth;
+}
+
+std::vector<float> renderBlocks(SfzSynth& synth, int numBlocks, int blockSize)
+{
+    AudioBuffer<float> output { config::numChannels, blockSize };
+    std::vector<float> left;
+    for (int blockIdx = 0; blockIdx < numBlocks; ++blockIdx)
+    {
+        output.clear();
+        synth.renderNextBlock(output, 0, blockSize);
+        left.insert(left.end(), output.getReadPointer(0), output.getReadPointer(0) + blockSize);
+    }
+    return left;
+}
+}
+
+TEST_CASE("Oversampling factors", "[oversampling]")
+{
+    REQUIRE( SfzOversampling::isValidFactor(1) );
+    REQUIRE( SfzOversampling::isValidFactor(2) );
+    REQUIRE( SfzOversampling::isValidFactor(SfzOversampling::maxFactor) );
+    REQUIRE( !SfzOversampling::isValidFactor(0) );
+    REQUIRE( !SfzOversampling::isValidFactor(3) );
+    REQUIRE( !SfzOversampling::isValidFactor(8) );
+}
+
+TEST_CASE("Lane decimation", "[oversampling]")
+{
+    LevelGuard guard;
+    for (auto level: allLevels)
+    {
+        if (!SfzSimd::setLevel(level))
+            continue;
+
+        for (auto factor: { 2, 4 })
+        {
+            INFO( SfzSimd::getLevelName(level) << ", " << factor << "x oversampling" );
+            const auto lastLane = DecimationChain(factor).getNumLanes() - 1;
+
+            // The first milliseconds hold the filter transient
+            for (auto lane: { 0, lastLane })
+            {
+                DecimationChain chain { factor };
+                REQUIRE( peak(decimate(chain, lane, sine(1000.0), 4800)[static_cast<size_t>(lane)], 480) == Approx(1.0f).margin(1e-3f) );
+            }
+
+            // 30 kHz would fold back to 18 kHz
+            for (auto lane: { 0, lastLane })
+            {
+                DecimationChain chain { factor };
+                REQUIRE( peak(decimate(chain, lane, sine(30000.0), 4800)[static_cast<size_t>(lane)], 480) < 1e-4f );
+            }
+
+            // Lanes are filtered independently
+            {
+                DecimationChain chain { factor };
+                const auto lanes = decimate(chain, 1, [](int64_t, double) { return 1.0f; }, 256);
+                for (int lane = 0; lane < chain.getNumLanes(); ++lane)
+                {
+                    if (lane != 1)
+                        REQUIRE( peak(lanes[static_cast<size_t>(lane)], 0) == 0.0f );
+                }
+            }
+
+            // Clearing a lane restarts both stages
+            {
+                DecimationChain chain { factor };
+                Random random { 1 };
+                decimate(chain, 0, [&](int64_t, double) { return random.nextFloat() * 2.0f - 1.0f; }, 256);
+                chain.clearLane(0);
+                DecimationChain freshChain { factor };
+                REQUIRE( decimate(chain, 0, sine(1000.0), 256)[0] == decimate(freshChain, 0, sine(1000.0), 256)[0] );
+            }
+        }
+    }
+}
+
+TEST_CASE("Oversampled voice batches", "[oversampling]")
+{
+    constexpr int blockSize { 256 };
+    LevelGuard guard;
+    for (auto level: allLevels)
+    {
+        // The batches take the decimators of the kernels in use when they are prepared
+        if (!SfzSimd::setLevel(level))
+            continue;
+
+        for (auto factor: { 2, 4 })
+        {
+            INFO( SfzSimd::getLevelName(level) << ", " << factor << "x oversampling" );
+
+            // The audio band goes through
+            {
+                auto synth = makeSineSynth(1, blockSize);
+                auto oversampledSynth = makeSineSynth(factor, blockSize);
+                synth->registerNoteOn(1, 69, 100, 0);
+                oversampledSynth->registerNoteOn(1, 69, 100, 0);
+                const auto reference = peak(renderBlocks(*synth, 16, blockSize), blockSize);
+                REQUIRE( reference > 0.1f );
+                REQUIRE( peak(renderBlocks(*oversampledSynth, 16, blockSize), blockSize) == Approx(reference).epsilon(1e-3) );
+            }
+
+            // A voice does not hear the filter memories of its previous note
+            {
+                auto synth = makeSineSynth(factor, blockSize);
+                synth->registerNoteOn(1, 69, 100, 0);
+                renderBlocks(*synth, 4, blockSize);
+                synth->registerNoteOff(1, 69, 0, 0);
+                for (int blockIdx = 0; blockIdx < 64 && synth->getNumActiveVoices() > 0; ++blockIdx)
+                    renderBlocks(*synth, 1, blockSize);
+                REQUIRE( synth->getNumActiveVoices() == 0 );
+
+                auto freshSynth = makeSineSynth(factor, blockSize);
+                synth->registerNoteOn(1, 69, 100, 0);
+                freshSynth->registerNoteOn(1, 69, 100, 0);
+                const auto restarted = renderBlocks(*synth, 4, blockSize);
+                const auto expected = renderBlocks(*freshSynth, 4, blockSize);
+                for (size_t index = 0; index < expected.size(); ++index)
+                    REQUIRE( restarted[index] == Approx(expected[index]).margin(1e-6) );
+            }
+
+            // The lanes of a voice that stopped stay silent next to the voices still playing
+            {
+                auto synth = makeSineSynth(factor, blockSize);
+                auto singleNoteSynth = makeSineSynth(factor, blockSize);
+                synth->registerNoteOn(1, 69, 100, 0);
+                synth->registerNoteOn(1, 60, 100, 0);
+                singleNoteSynth->registerNoteOn(1, 69, 100, 0);
+                renderBlocks(*synth, 2, blockSize);
+                renderBlocks(*singleNoteSynth, 2, blockSize);
+                synth->registerNoteOff(1, 60, 0, 0);
+                // Both synths render the same blocks so that their remaining notes stay in phase
+                for (int blockIdx = 0; blockIdx < 64 && synth->getNumActiveVoices() > 1; ++blockIdx)
+                {
+                    renderBlocks(*synth, 1, blockSize);
+                    renderBlocks(*singleNoteSynth, 1, blockSize);
+                }
+                REQUIRE( synth->getNumActiveVoices() == 1 );
+
+                const auto output = renderBlocks(*synth, 4, blockSize);
+                const auto expected = renderBlocks(*singleNoteSynth, 4, blockSize);
+                for (size_t index = 0; index < expected.size(); ++index)
+                    REQUIRE( output[index] == Approx(expected[index]).margin(1e-6) );
+            }
+        }
+    }
+}
@@ -0,0 +1,95 @@
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "catch2/catch.hpp"
+#include "../Source/SfzFilePool.h"
+#include <memory>
+#include <vector>
+using namespace Catch::literals;
+
+// Frames hold their own file position so that merged windows can be checked
+std::shared_ptr<SfzSampleBuffer> makeFrames(int64 start, int numSamples)
+{
+    auto data = std::make_shared<SfzSampleBuffer>(SfzSampleFormat::float32, config::numChannels, numSamples);
+    for (int chanIdx = 0; chanIdx < config::numChannels; ++chanIdx)
+        for (int sampleIdx = 0; sampleIdx < numSamples; ++sampleIdx)
+            data->getWritePointer<float>(chanIdx)[sampleIdx] = static_cast<float>(start + sampleIdx);
+    return data;
+}
+
+bool holdsFilePositions(const SfzPreloadWindow& window)
+{
+    for (int chanIdx = 0; chanIdx < config::numChannels; ++chanIdx)
+        for (int sampleIdx = 0; sampleIdx < window.data->getNumSamples(); ++sampleIdx)
+            if (window.data->getSample(chanIdx, sampleIdx) != static_cast<float>(window.start + sampleIdx))
+                return false;
+    return true;
+}
+
+TEST_CASE("Preload ranges", "Preload window tests")
+{
+    REQUIRE( SfzFilePool::getPreloadRange(0, 0, 100, 1000) == Range<int64>(0, 100) );
+    REQUIRE( SfzFilePool::getPreloadRange(500, 600, 100, 1000) == Range<int64>(500, 700) );
+    REQUIRE( SfzFilePool::getPreloadRange(950, 950, 100, 1000) == Range<int64>(950, 1000) );
+    REQUIRE( SfzFilePool::getPreloadRange(2000, 2000, 100, 1000) == Range<int64>(1000, 1000) );
+    REQUIRE( SfzFilePool::getPreloadRange(200, 200, 0, 1000) == Range<int64>(200, 1000) );
+}
+
+TEST_CASE("Preload windows", "Preload window tests")
+{
+    SfzFilePool filePool { File::getCurrentWorkingDirectory() };
+    const String sample { "slices.wav" };
+
+    SECTION("Separate windows")
+    {
+        filePool.addPreloadedData(sample, 1000, makeFrames(1000, 100));
+        filePool.addPreloadedData(sample, 0, makeFrames(0, 100));
+        const std::vector<Range<int64>> expected { { 0, 100 }, { 1000, 1100 } };
+        REQUIRE( filePool.getResidentRanges(sample) == expected );
+        REQUIRE( filePool.getPreloadedMemory() == 200 * config::numChannels * sizeof(float) );
+
+        REQUIRE( filePool.getPreloadedData(sample, 1050).start == 1000 );
+        REQUIRE( filePool.getPreloadedData(sample, 50).start == 0 );
+        REQUIRE( filePool.getPreloadedData(sample, 500).data == nullptr );
+        REQUIRE( filePool.getPreloadedData("other.wav", 0).data == nullptr );
+    }
+
+    SECTION("Missing ranges")
+    {
+        filePool.addPreloadedData(sample, 100, makeFrames(100, 100));
+        filePool.addPreloadedData(sample, 300, makeFrames(300, 100));
+        const std::vector<Range<int64>> expected { { 0, 100 }, { 200, 300 }, { 400, 500 } };
+        REQUIRE( filePool.getMissingRanges(sample, { 0, 500 }) == expected );
+        REQUIRE( filePool.getMissingRanges(sample, { 120, 180 }).empty() );
+        REQUIRE( filePool.getMissingRanges("other.wav", { 0, 10 }) == std::vector<Range<int64>> { { 0, 10 } } );
+    }
+
+    SECTION("Overlapping and contiguous windows are merged")
+    {
+        filePool.addPreloadedData(sample, 0, makeFrames(0, 100));
+        filePool.addPreloadedData(sample, 200, makeFrames(200, 100));
+        filePool.addPreloadedData(sample, 100, makeFrames(100, 100));
+        REQUIRE( filePool.getResidentRanges(sample) == std::vector<Range<int64>> { { 0, 300 } } );
+        REQUIRE( holdsFilePositions(filePool.getPreloadedData(sample, 0)) );
+
+        filePool.addPreloadedData(sample, 250, makeFrames(250, 100));
+        REQUIRE( filePool.getResidentRanges(sample) == std::vector<Range<int64>> { { 0, 350 } } );
+        REQUIRE( holdsFilePositions(filePool.getPreloadedData(sample, 0)) );
+        REQUIRE( filePool.getPreloadedMemory() == 350 * config::numChannels * sizeof(float) );
+    }
+
+    SECTION("Data already resident is not added again")
+    {
+        filePool.addPreloadedData(sample, 0, makeFrames(0, 300));
+        const auto window = filePool.getPreloadedData(sample, 0);
+        filePool.addPreloadedData(sample, 100, makeFrames(100, 100));
+        REQUIRE( filePool.getPreloadedData(sample, 0).data == window.data );
+        REQUIRE( filePool.getResidentRanges(sample) == std::vector<Range<int64>> { { 0, 300 } } );
+    }
+
+    SECTION("Clearing the pool")
+    {
+        filePool.addPreloadedData(sample, 0, makeFrames(0, 100));
+        filePool.clear();
+        REQUIRE( filePool.getResidentRanges(sample).empty() );
+        REQUIRE( filePool.getPreloadedMemory() == 0 );
+    }
+}
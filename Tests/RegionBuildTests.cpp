@@ -153,6 +153,24 @@ TEST_CASE("Parsing opcodes", "Region tests")
         REQUIRE( region.offBy == 0 );
     }
 
+    SECTION("polyphony")
+    {
+        REQUIRE( !region.polyphony );
+        region.parseOpcode({ "polyphony", "4" });
+        REQUIRE( region.polyphony );
+        REQUIRE( region.polyphony == 4 );
+        region.parseOpcode({ "polyphony", "0" });
+        REQUIRE( region.polyphony == 1 );
+    }
+
+    SECTION("note_polyphony")
+    {
+        REQUIRE( !region.notePolyphony );
+        region.parseOpcode({ "note_polyphony", "2" });
+        REQUIRE( region.notePolyphony );
+        REQUIRE( region.notePolyphony == 2 );
+    }
+
     SECTION("off_mode")
     {
         REQUIRE( region.offMode == SfzOffMode::fast );
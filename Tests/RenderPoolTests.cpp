@@ -0,0 +1,57 @@
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "catch2/catch.hpp"
+#include "../Source/SfzSynth.h"
+#include <filesystem>
+using namespace Catch::literals;
+
+namespace
+{
+void checkParallelRendering(int oversamplingFactor)
+{
+    constexpr int blockSize { 256 };
+    constexpr int numNotes { 48 };
+    SfzSynth serialSynth;
+    SfzSynth parallelSynth;
+    serialSynth.setOversamplingFactor(oversamplingFactor);
+    parallelSynth.setOversamplingFactor(oversamplingFactor);
+    parallelSynth.setNumRenderThreads(3);
+    REQUIRE( parallelSynth.getNumRenderThreads() == 3 );
+
+    for (auto* synth: { &serialSynth, &parallelSynth })
+    {
+        synth->loadSfzFile(std::filesystem::current_path() / "Tests/TestFiles/full_keyboard.sfz");
+        synth->prepareToPlay(48000, blockSize);
+        for (int noteNumber = 30; noteNumber < 30 + numNotes; ++noteNumber)
+            synth->registerNoteOn(1, noteNumber, 100, 0);
+    }
+    REQUIRE( parallelSynth.getNumActiveVoices() == numNotes );
+
+    AudioBuffer<float> serialOutput { config::numChannels, blockSize };
+    AudioBuffer<float> parallelOutput { config::numChannels, blockSize };
+    for (int blockIdx = 0; blockIdx < 8; ++blockIdx)
+    {
+        serialOutput.clear();
+        parallelOutput.clear();
+        serialSynth.renderNextBlock(serialOutput, 0, blockSize);
+        parallelSynth.renderNextBlock(parallelOutput, 0, blockSize);
+        // The voices are summed in another order
+        for (int channelIdx = 0; channelIdx < config::numChannels; ++channelIdx)
+            for (int sampleIdx = 0; sampleIdx < blockSize; ++sampleIdx)
+                REQUIRE( parallelOutput.getSample(channelIdx, sampleIdx) == Approx(serialOutput.getSample(channelIdx, sampleIdx)).margin(1e-4) );
+    }
+}
+}
+
+TEST_CASE("Parallel rendering", "Render pool tests")
+{
+    checkParallelRendering(1);
+}
+
+TEST_CASE("Parallel rendering of oversampled voice batches", "Render pool tests")
+{
+    for (auto factor: { 2, 4 })
+    {
+        INFO( "Oversampling factor " << factor );
+        checkParallelRendering(factor);
+    }
+}
@@ -0,0 +1,116 @@
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "catch2/catch.hpp"
+#include "../Source/SfzSampleCache.h"
+#include <atomic>
+#include <memory>
+
+SfzSampleCache::DecodedSample makeSample(int numSamples)
+{
+    return std::make_shared<const SfzSampleBuffer>(SfzSampleFormat::float32, 1, numSamples);
+}
+
+TEST_CASE("Sample cache", "Sample cache tests")
+{
+    const size_t sampleSize { 1000 * sizeof(float) };
+
+    SECTION("Cached buffers are shared")
+    {
+        SfzSampleCache cache;
+        REQUIRE( cache.get("a.wav", 0) == nullptr );
+        const auto inserted = cache.insert("a.wav", 0, makeSample(1000));
+        REQUIRE( cache.get("a.wav", 0) == inserted );
+        REQUIRE( cache.getMemoryUsage() == sampleSize );
+    }
+
+    SECTION("Concurrent inserts keep the first buffer")
+    {
+        SfzSampleCache cache;
+        const auto first = cache.insert("a.wav", 0, makeSample(1000));
+        const auto second = cache.insert("a.wav", 0, makeSample(1000));
+        REQUIRE( first == second );
+        REQUIRE( cache.getNumEntries() == 1 );
+    }
+
+    SECTION("Modified files are decoded again")
+    {
+        SfzSampleCache cache;
+        cache.insert("a.wav", 0, makeSample(1000));
+        REQUIRE( cache.get("a.wav", 1) == nullptr );
+        REQUIRE( cache.getNumEntries() == 0 );
+        REQUIRE( cache.getMemoryUsage() == 0 );
+    }
+
+    SECTION("Least recently used buffers are evicted first")
+    {
+        SfzSampleCache cache;
+        cache.setMemoryBudget(2 * sampleSize);
+        cache.insert("a.wav", 0, makeSample(1000));
+        cache.insert("b.wav", 0, makeSample(1000));
+        cache.get("a.wav", 0);
+        cache.insert("c.wav", 0, makeSample(1000));
+        REQUIRE( cache.getNumEntries() == 2 );
+        REQUIRE( cache.get("a.wav", 0) != nullptr );
+        REQUIRE( cache.get("b.wav", 0) == nullptr );
+        REQUIRE( cache.get("c.wav", 0) != nullptr );
+    }
+
+    SECTION("Buffers in use are never evicted")
+    {
+        SfzSampleCache cache;
+        cache.setMemoryBudget(sampleSize);
+        const auto playing = cache.insert("a.wav", 0, makeSample(1000));
+        cache.insert("b.wav", 0, makeSample(1000));
+        REQUIRE( cache.get("a.wav", 0) == playing );
+        REQUIRE( cache.getMemoryUsage() == 2 * sampleSize );
+
+        cache.setMemoryBudget(0);
+        REQUIRE( cache.getNumEntries() == 1 );
+        REQUIRE( cache.get("a.wav", 0) == playing );
+    }
+
+    auto waitForDecodes = [](const SfzSampleCache& cache) {
+        for (int attempt = 0; attempt < 5000 && cache.getNumPendingDecodes() > 0; ++attempt)
+            Thread::sleep(1);
+        return cache.getNumPendingDecodes() == 0;
+    };
+
+    SECTION("Samples are decoded once in the background")
+    {
+        SfzSampleCache cache;
+        std::atomic<bool> decodeMayFinish { false };
+        std::atomic<int> numDecodes { 0 };
+        auto decode = [&]() {
+            numDecodes++;
+            while (!decodeMayFinish)
+                Thread::sleep(1);
+            return makeSample(1000);
+        };
+
+        cache.requestDecode("a.wav", 0, decode);
+        cache.requestDecode("a.wav", 0, decode);
+        REQUIRE( cache.getNumPendingDecodes() == 1 );
+        REQUIRE( cache.get("a.wav", 0) == nullptr );
+
+        decodeMayFinish = true;
+        REQUIRE( waitForDecodes(cache) );
+        REQUIRE( numDecodes == 1 );
+        REQUIRE( cache.get("a.wav", 0) != nullptr );
+
+        // Cached already
+        cache.requestDecode("a.wav", 0, decode);
+        REQUIRE( cache.getNumPendingDecodes() == 0 );
+        REQUIRE( numDecodes == 1 );
+    }
+
+    SECTION("Failed decodes can be requested again")
+    {
+        SfzSampleCache cache;
+        cache.requestDecode("a.wav", 0, []() { return SfzSampleCache::DecodedSample {}; });
+        REQUIRE( waitForDecodes(cache) );
+        REQUIRE( cache.getNumEntries() == 0 );
+
+        cache.requestDecode("a.wav", 0, []() { return makeSample(1000); });
+        REQUIRE( waitForDecodes(cache) );
+        REQUIRE( cache.get("a.wav", 0) != nullptr );
+    }
+}
@@ -0,0 +1,162 @@
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "catch2/catch.hpp"
+#include "../Source/SfzSimdDispatch.h"
+#include "../Source/SfzInterpolation.h"
+#include "../Source/hiir/Downsampler2xFpu.h"
+#include <cmath>
+#include <vector>
+
+namespace
+{
+const SfzSimdLevel allLevels[] { SfzSimdLevel::scalar, SfzSimdLevel::sse2, SfzSimdLevel::avx2, SfzSimdLevel::avx512, SfzSimdLevel::neon };
+
+// Puts back the detected level when a test case ends
+struct LevelGuard
+{
+    ~LevelGuard() { SfzSimd::setLevel(SfzSimd::detectLevel()); }
+};
+
+std::vector<float> noise(int size, int seed)
+{
+    Random random { seed };
+    std::vector<float> values;
+    for (int i = 0; i < size; ++i)
+        values.push_back(random.nextFloat() * 2.0f - 1.0f);
+    return values;
+}
+
+// Runs the kernel of the level in use and the baseline one on the same source, and compares them
+template<class T>
+void checkLinear(const std::vector<T>& source)
+{
+    for (const float step: { 1.0f, 0.37f, 1.41f, 3.9f })
+    {
+        for (const int numFrames: { 1, 7, 8, 15, 16, 33, 256 })
+        {
+            std::vector<float> output (numFrames);
+            std::vector<float> expected (numFrames);
+            const T* sources[1] { source.data() };
+            float* outputs[1] { output.data() };
+            float* expectedOutputs[1] { expected.data() };
+            SfzInterpolation::linear(sources, outputs, 1, 3, 0.25f, step, numFrames);
+            SfzInterpolation::linearKernel(sources, expectedOutputs, 1, 3, 0.25f, step, numFrames);
+            REQUIRE( output == expected );
+        }
+    }
+}
+}
+
+TEST_CASE("Level detection", "[simd]")
+{
+    LevelGuard guard;
+    const auto detected = SfzSimd::detectLevel();
+    REQUIRE( SfzSimd::isSupported(detected) );
+    REQUIRE( SfzSimd::getLevel() == detected );
+#if SFZ_HAVE_SSE
+    REQUIRE( SfzSimd::isSupported(SfzSimdLevel::sse2) );
+    REQUIRE( !SfzSimd::setLevel(SfzSimdLevel::neon) );
+    REQUIRE( SfzSimd::getLevel() == detected );
+#endif
+    REQUIRE( SfzSimd::setLevel(detected) );
+}
+
+TEST_CASE("Dispatched kernels match the baseline", "[simd]")
+{
+    LevelGuard guard;
+    const auto floatSource = noise(2048, 1);
+    std::vector<int16_t> int16Source;
+    std::vector<SfzInt24> int24Source;
+    for (auto value: floatSource)
+    {
+        int16Source.push_back(static_cast<int16_t>(value * 32767.0f));
+        int24Source.push_back(SfzInt24::fromInt(static_cast<int32_t>(value * 8388607.0f)));
+    }
+
+    for (auto level: allLevels)
+    {
+        if (!SfzSimd::setLevel(level))
+            continue;
+
+        INFO( SfzSimd::getLevelName(level) );
+        checkLinear(floatSource);
+        checkLinear(int16Source);
+        checkLinear(int24Source);
+
+        for (const int numSamples: { 1, 15, 16, 17, 100 })
+        {
+            auto sum = noise(numSamples, 2);
+            auto product = sum;
+            const auto other = noise(numSamples, 3);
+            auto expectedSum = sum;
+            auto expectedProduct = sum;
+            for (int i = 0; i < numSamples; ++i)
+            {
+                expectedSum[i] += other[i];
+                expectedProduct[i] *= other[i];
+            }
+            SfzSimd::getKernels().add(sum.data(), other.data(), numSamples);
+            SfzSimd::getKernels().multiply(product.data(), other.data(), numSamples);
+            REQUIRE( sum == expectedSum );
+            REQUIRE( product == expectedProduct );
+        }
+    }
+}
+
+TEST_CASE("Lane decimators", "[simd]")
+{
+    LevelGuard guard;
+    constexpr double coefs[4] { 0.041893991997656171, 0.16890348243995201, 0.39056077292116592, 0.74389574826847815 };
+    constexpr int numSamples { 64 };
+
+    for (auto level: allLevels)
+    {
+        if (!SfzSimd::setLevel(level))
+            continue;
+
+        INFO( SfzSimd::getLevelName(level) );
+        REQUIRE( SfzSimd::getKernels().createDecimator(5) == nullptr );
+        auto decimator = SfzSimd::getKernels().createDecimator(4);
+        REQUIRE( decimator != nullptr );
+        decimator->setCoefs(coefs);
+        const auto numLanes = decimator->getNumLanes();
+        REQUIRE( numLanes >= 4 );
+
+        // Each lane is its own signal and has to match a single channel decimator
+        const auto input = noise(2 * numSamples * numLanes, 4);
+        std::vector<float> output (numSamples * numLanes);
+        decimator->process(output.data(), input.data(), numSamples / 2);
+        decimator->process(output.data() + numSamples / 2 * numLanes, input.data() + numSamples * numLanes, numSamples / 2);
+
+        for (int lane = 0; lane < numLanes; ++lane)
+        {
+            hiir::Downsampler2xFpu<4> reference;
+            reference.set_coefs(coefs);
+            for (int sample = 0; sample < numSamples; ++sample)
+            {
+                const float pair[2] { input[(2 * sample) * numLanes + lane], input[(2 * sample + 1) * numLanes + lane] };
+                REQUIRE( output[sample * numLanes + lane] == Approx(reference.process_sample(pair)).margin(1e-6) );
+            }
+        }
+
+        // Clearing a lane restarts its signal and leaves the others alone
+        const auto before = output;
+        decimator->clearLane(1);
+        decimator->process(output.data(), input.data(), numSamples / 2);
+        decimator->clear();
+        std::vector<float> restarted (numSamples * numLanes);
+        decimator->process(restarted.data(), input.data(), numSamples / 2);
+        bool otherLaneKeptItsMemory { false };
+        for (int sample = 0; sample < numSamples / 2; ++sample)
+        {
+            REQUIRE( output[sample * numLanes + 1] == restarted[sample * numLanes + 1] );
+            otherLaneKeptItsMemory |= output[sample * numLanes] != restarted[sample * numLanes];
+        }
+        REQUIRE( otherLaneKeptItsMemory );
+
+        decimator->clear();
+        const std::vector<float> silence (2 * numLanes, 0.0f);
+        decimator->process(output.data(), silence.data(), 1);
+        for (int lane = 0; lane < numLanes; ++lane)
+            REQUIRE( output[lane] == 0.0f );
+    }
+}
@@ -0,0 +1,183 @@
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "catch2/catch.hpp"
+#include "../Source/SfzTokenizer.h"
+#include "../Source/SfzGlobals.h"
+#include <random>
+#include <regex>
+#include <string>
+#include <vector>
+using namespace Catch::literals;
+
+using TokenList = std::vector<std::pair<std::string, std::string>>;
+
+TokenList tokenize(std::string_view source)
+{
+    TokenList tokens;
+    SfzTokenizer tokenizer { source };
+    for (auto token = tokenizer.next(); token.type != SfzTokenType::end; token = tokenizer.next())
+    {
+        if (token.type == SfzTokenType::header)
+            tokens.emplace_back("<" + std::string(token.header) + ">", "");
+        else
+            tokens.emplace_back(std::string(token.opcode), std::string(token.value));
+    }
+    return tokens;
+}
+
+// Reference implementation using the regexes the tokenizer replaced
+TokenList tokenizeWithRegexes(const std::string& source)
+{
+    TokenList tokens;
+    const auto regexEnd = std::sregex_iterator();
+    for (auto headerIterator = std::sregex_iterator(source.begin(), source.end(), SfzRegexes::headers); headerIterator != regexEnd; ++headerIterator)
+    {
+        const auto headerMatch = *headerIterator;
+        tokens.emplace_back("<" + headerMatch.str(1) + ">", "");
+        const auto members = headerMatch.str(2);
+        for (auto memberIterator = std::sregex_iterator(members.begin(), members.end(), SfzRegexes::members); memberIterator != regexEnd; ++memberIterator)
+        {
+            std::string_view value { (*memberIterator)[2].first.base(), static_cast<size_t>((*memberIterator)[2].length()) };
+            trimView(value);
+            // The tokenizer skips blank values, see its class comment
+            if (value.empty())
+                continue;
+            tokens.emplace_back((*memberIterator).str(1), std::string(value));
+        }
+    }
+    return tokens;
+}
+
+TEST_CASE("Basic tokens", "Tokenizer Tests")
+{
+    SECTION("Header and members")
+    {
+        const TokenList expected { {"<header>", ""}, {"param1", "value1"}, {"param2", "value2"}, {"<next>", ""} };
+        REQUIRE( tokenize("<header>param1=value1 param2=value2<next>") == expected );
+    }
+
+    SECTION("EOL header")
+    {
+        const TokenList expected { {"<header>", ""}, {"param1", "value1"}, {"param2", "value2"} };
+        REQUIRE( tokenize("<header>param1=value1 param2=value2") == expected );
+    }
+
+    SECTION("Members before the first header are ignored")
+    {
+        const TokenList expected { {"<region>", ""}, {"sample", "dummy.wav"} };
+        REQUIRE( tokenize("key=12 <region>sample=dummy.wav") == expected );
+    }
+
+    SECTION("Empty values are skipped")
+    {
+        const TokenList expected { {"<region>", ""}, {"key", "12"} };
+        REQUIRE( tokenize("<region>sample= key=12") == expected );
+    }
+
+    SECTION("Unterminated header")
+    {
+        const TokenList expected { {"<region>", ""}, {"key", "12"} };
+        REQUIRE( tokenize("<region>key=12 <group") == expected );
+    }
+
+    SECTION("Empty source")
+    {
+        REQUIRE( tokenize("").empty() );
+        REQUIRE( tokenize("   ").empty() );
+    }
+}
+
+TEST_CASE("Values with spaces and paths", "Tokenizer Tests")
+{
+    const TokenList expected { {"<region>", ""}, {"sample", "subdir space\\sample.wav"}, {"next_member", "value"} };
+    REQUIRE( tokenize("<region> sample=subdir space\\sample.wav next_member=value ") == expected );
+    const TokenList expected2 { {"<region>", ""}, {"sample", "../Samples/pizz/a0_vl3_rr3.wav"}, {"lokey", "c#4"} };
+    REQUIRE( tokenize("<region>sample=../Samples/pizz/a0_vl3_rr3.wav lokey=c#4") == expected2 );
+}
+
+TEST_CASE("Same output as the regexes", "Tokenizer Tests")
+{
+    const std::vector<std::string> sources {
+        "<header>param1=value1 param2=value2<next>",
+        "<global>sw_default=36 <group> lokey=36 hikey=48 <region>sample=dummy.wav <region> sample=dummy.1.wav key=40 ",
+        "<control> set_cc1=64 label_cc1=Mod wheel default_path=Samples\\ <region>sample=value-()* ampeg_sustain_oncc74=-100",
+        "<region>sample=..\\Samples\\SMD Cymbals Stereo (Samples)\\Hi-Hat (Samples)\\01 Hat Tight 1\\RR1\\09_Hat_Tight_Cnt_RR1.wav lorand=0.750 hirand=1",
+        "<master><group>group=1 off_by=2<region>sample=*sine<region>sample=*silence trigger=release",
+    };
+
+    for (const auto& source: sources)
+        REQUIRE( tokenize(source) == tokenizeWithRegexes(source) );
+}
+
+TEST_CASE("Same output as the regexes on random sources", "Tokenizer Tests")
+{
+    // Only the characters of the member regex value class, with whitespace between the members;
+    // the lines of a file are joined before tokenizing, so there are no line breaks
+    const std::vector<std::string> headers { "<region>", "<group>", "<global>", "<control>", "<>", "<curve" };
+    const std::vector<std::string> opcodes { "sample", "key", "lokey", "amp_velcurve_1", "_", "x", "9" };
+    const std::string valueCharacters { "abcXYZ019-_#./\\(),* " };
+    const std::vector<std::string> separators { " ", "  ", "\t", " \t " };
+    std::mt19937 randomGenerator { 42 };
+    auto pick = [&](const auto& choices) { return choices[std::uniform_int_distribution<size_t>(0, choices.size() - 1)(randomGenerator)]; };
+    auto chance = [&](int percent) { return std::uniform_int_distribution<int>(0, 99)(randomGenerator) < percent; };
+
+    for (int sourceIdx = 0; sourceIdx < 2000; ++sourceIdx)
+    {
+        std::string source;
+        const auto numItems = std::uniform_int_distribution<int>(0, 12)(randomGenerator);
+        for (int itemIdx = 0; itemIdx < numItems; ++itemIdx)
+        {
+            if (chance(25))
+            {
+                source += pick(headers);
+            }
+            else
+            {
+                if (chance(90))
+                    source += pick(opcodes);
+                source += '=';
+                if (chance(10))
+                    source += '=';
+                const auto valueLength = std::uniform_int_distribution<int>(0, 8)(randomGenerator);
+                for (int charIdx = 0; charIdx < valueLength; ++charIdx)
+                    source += pick(valueCharacters);
+            }
+            source += pick(separators);
+        }
+
+        INFO( source );
+        REQUIRE( tokenize(source) == tokenizeWithRegexes(source) );
+    }
+}
+
+TEST_CASE("Values are more lenient than the regexes", "Tokenizer Tests")
+{
+    SECTION("Characters outside of the regex value class")
+    {
+        const TokenList expected { {"<region>", ""}, {"sample", "Drums & Bass/kick+snare.wav"}, {"key", "36"} };
+        REQUIRE( tokenize("<region>sample=Drums & Bass/kick+snare.wav key=36") == expected );
+        const TokenList regexExpected { {"<region>", ""}, {"sample", "Drums"}, {"key", "36"} };
+        REQUIRE( tokenizeWithRegexes("<region>sample=Drums & Bass/kick+snare.wav key=36") == regexExpected );
+    }
+
+    SECTION("Non-ASCII characters")
+    {
+        const TokenList expected { {"<region>", ""}, {"sample", "Cl\xc3\xa9 de sol.wav"} };
+        REQUIRE( tokenize("<region>sample=Cl\xc3\xa9 de sol.wav") == expected );
+    }
+
+    SECTION("Values starting outside of the regex value class")
+    {
+        const TokenList expected { {"<region>", ""}, {"volume", "+3"} };
+        REQUIRE( tokenize("<region>volume=+3") == expected );
+        const TokenList regexExpected { {"<region>", ""} };
+        REQUIRE( tokenizeWithRegexes("<region>volume=+3") == regexExpected );
+    }
+
+    SECTION("No whitespace before the next opcode")
+    {
+        const TokenList expected { {"<region>", ""}, {"a", "1."}, {"b", "2"} };
+        REQUIRE( tokenize("<region>a=1.b=2") == expected );
+        const TokenList regexExpected { {"<region>", ""}, {"a", "1"}, {"b", "2"} };
+        REQUIRE( tokenizeWithRegexes("<region>a=1.b=2") == regexExpected );
+    }
+}